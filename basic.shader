@@ -5,14 +5,14 @@ layout (location = 1) in vec2 aUV;
 
 out vec2 fUV;
 
-uniform mat4 u_Projection;
-uniform mat4 u_View;
+#include "camera.glsl"
+
 uniform mat4 u_Transform;
 
 void main()
 {
    fUV = aUV;
-   gl_Position = u_Projection * u_View * u_Transform * vec4(aPos.x, aPos.y, aPos.z, 1.0);
+   gl_Position = u_ViewProjection * u_Transform * vec4(aPos.x, aPos.y, aPos.z, 1.0);
 }
 
 #shader fragment
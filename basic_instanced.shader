@@ -0,0 +1,67 @@
+#shader vertex
+#version 450 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aUV;
+/* Tangent frame for lighting; w is the bitangent handedness */
+layout (location = 2) in vec3 aNormal;
+layout (location = 3) in vec4 aTangent;
+
+layout (std430, row_major, binding = 0) readonly buffer Instances
+{
+   mat4 u_Transforms[];
+};
+
+/* Per instance (first page, level); see tile_pages.h */
+layout (std430, binding = 3) readonly buffer TilePages
+{
+   uvec4 u_TilePages[];
+};
+
+out vec2 fUV;
+flat out uvec2 fTilePages;
+
+#include "camera.glsl"
+
+/* gl_InstanceID does not include the base instance, so draws pass their offset */
+uniform int u_BaseInstance;
+uniform bool u_Tiled;
+
+void main()
+{
+   mat4 model = u_Transforms[u_BaseInstance + gl_InstanceID];
+   fUV = aUV;
+   fTilePages = u_Tiled ? u_TilePages[u_BaseInstance + gl_InstanceID].xy : uvec2(0);
+   gl_Position = u_ViewProjection * model * vec4(aPos, 1.0);
+}
+
+#shader fragment
+#version 450 core
+out vec4 FragColor;
+
+in vec2 fUV;
+flat in uvec2 fTilePages;
+
+layout (std430, binding = 3) readonly buffer TilePages
+{
+   uvec4 u_TilePages[];
+};
+
+uniform sampler2D u_Texture;
+uniform sampler2DArray u_TileAtlas;
+uniform bool u_Tiled;
+
+vec4 sample_tiles(vec2 uv)
+{
+   /* Seam vertices carry u past 1 */
+   uint n = 1u << fTilePages.y;
+   vec2 position = vec2(fract(uv.x), clamp(uv.y, 0.0, 1.0)) * float(n);
+   uvec2 tile = min(uvec2(position), uvec2(n - 1u));
+   uvec4 page = u_TilePages[fTilePages.x + tile.y * n + tile.x];
+   vec2 local = (position - vec2(tile)) * uintBitsToFloat(page.y) + uintBitsToFloat(page.zw);
+   return texture(u_TileAtlas, vec3(local, float(page.x)));
+}
+
+void main()
+{
+   FragColor = u_Tiled ? sample_tiles(fUV) : texture(u_Texture, fUV);
+}
@@ -0,0 +1,630 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "../src/math/mat4.h"
+#include "../src/math/quat.h"
+
+#include "../src/physics/options.h"
+#include "../src/physics/simulation.h"
+
+#include "../src/graphics/shader_parser.h"
+#include "../src/graphics/texture.h"
+#include "../src/graphics/culling.h"
+#include "../src/graphics/sphere_mesh.h"
+
+#include "../src/util/cpu.h"
+#include "../src/util/thread_pool.h"
+#include "../src/util/timer.h"
+#include "../src/util/util.h"
+
+#ifndef BENCH_PROFILE
+#define BENCH_PROFILE "unknown"
+#endif
+
+#define BENCH_SAMPLES 5
+#define BENCH_MAX_RESULTS 64
+#define BENCH_NAME_MAX 64
+#define BENCH_MATRICES 1024
+
+/* Runs the operation `iterations` times and returns how many operations that was */
+typedef uint64_t (*bench_fn)(void* context, uint64_t iterations);
+
+struct bench_result
+{
+    char name[BENCH_NAME_MAX];
+    double ns_per_op;
+    uint64_t ops;
+};
+
+struct bench_settings
+{
+    double sample_time;
+    const char* filter;
+    uint32_t threads;
+};
+
+static struct bench_result results[BENCH_MAX_RESULTS];
+static uint32_t result_count = 0;
+
+/* Keeps results observable so the optimizer cannot drop the work */
+static volatile float sink;
+
+static int compare_doubles(const void* a, const void* b)
+{
+    const double x = *(const double*)a;
+    const double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static void run(const struct bench_settings* settings, const char* name, bench_fn fn, void* context)
+{
+    if (settings->filter && !strstr(name, settings->filter)) {
+        return;
+    }
+    if (result_count == BENCH_MAX_RESULTS) {
+        fputs("Too many benchmarks!\n", stderr);
+        abort();
+    }
+
+    /* Grow the batch until one sample takes long enough to time reliably */
+    uint64_t iterations = 1;
+    while (true)
+    {
+        const double start = timer_now();
+        fn(context, iterations);
+        const double elapsed = timer_now() - start;
+        if (elapsed >= settings->sample_time || iterations >= (1ull << 40)) {
+            break;
+        }
+        const double scale = elapsed > 0.0 ? 1.5 * settings->sample_time / elapsed : 16.0;
+        iterations = (uint64_t)ceil((double)iterations * (scale < 16.0 ? scale : 16.0));
+    }
+
+    double samples[BENCH_SAMPLES];
+    uint64_t ops = 0;
+    for (uint32_t i = 0; i < BENCH_SAMPLES; ++i) {
+        const double start = timer_now();
+        const uint64_t done = fn(context, iterations);
+        samples[i] = (timer_now() - start) * 1e9 / (double)done;
+        ops += done;
+    }
+    qsort(samples, BENCH_SAMPLES, sizeof(double), compare_doubles);
+
+    struct bench_result* result = &results[result_count++];
+    snprintf(result->name, sizeof(result->name), "%s", name);
+    result->ns_per_op = samples[BENCH_SAMPLES / 2];
+    result->ops = ops;
+    fprintf(stderr, "%-44s %14.1f ns/op\n", name, result->ns_per_op);
+}
+
+/* math */
+
+struct math_context
+{
+    struct mat4* matrices;
+    struct mat4* products;
+    struct vec4* vectors;
+    struct vec4* transformed;
+
+    double x[BENCH_MATRICES];
+    double y[BENCH_MATRICES];
+    double z[BENCH_MATRICES];
+    float scales[BENCH_MATRICES];
+    struct quat rotations[BENCH_MATRICES];
+};
+
+static uint64_t bench_mat4_mul(void* context, uint64_t iterations)
+{
+    struct math_context* math = context;
+    struct mat4 m = math->matrices[0];
+    for (uint64_t i = 0; i < iterations; ++i) {
+        mat4_mul(&m, &math->matrices[i % BENCH_MATRICES]);
+    }
+    sink = m.elements[0];
+    return iterations;
+}
+
+static uint64_t bench_mat4_mul_batch(void* context, uint64_t iterations)
+{
+    struct math_context* math = context;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        mat4_mul_batch(&math->matrices[i % BENCH_MATRICES], math->matrices, math->products, BENCH_MATRICES);
+    }
+    sink = math->products[0].elements[0];
+    return iterations * BENCH_MATRICES;
+}
+
+static uint64_t bench_mat4_transform_batch(void* context, uint64_t iterations)
+{
+    struct math_context* math = context;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        mat4_transform_batch(&math->matrices[i % BENCH_MATRICES], math->vectors, math->transformed, BENCH_MATRICES);
+    }
+    sink = math->transformed[0].x;
+    return iterations * BENCH_MATRICES;
+}
+
+static uint64_t bench_mat4_rotation(void* context, uint64_t iterations)
+{
+    struct math_context* math = context;
+    struct mat4 m;
+    mat4_identity(&m);
+    for (uint64_t i = 0; i < iterations; ++i) {
+        struct vec3 angles;
+        vec3_init(&angles, 10.0f, 20.0f, (float)(i & 255));
+        mat4_rotation(&m, &angles);
+    }
+    sink = m.elements[0] + math->matrices[0].elements[0];
+    return iterations;
+}
+
+static uint64_t bench_mat4_look_at(void* context, uint64_t iterations)
+{
+    (void) context;
+    struct vec3 object;
+    struct vec3 up;
+    vec3_init(&object, 0.0f, 0.0f, 0.0f);
+    vec3_init(&up, 0.0f, 0.0f, 1.0f);
+    float sum = 0.0f;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        struct vec3 camera;
+        vec3_init(&camera, (float)(i & 63), -40.0f, 25.0f);
+        struct mat4 view = mat4_look_at(camera, object, up);
+        sum += view.elements[3];
+    }
+    sink = sum;
+    return iterations;
+}
+
+static uint64_t bench_mat4_trs_chain(void* context, uint64_t iterations)
+{
+    struct math_context* math = context;
+    for (uint64_t i = 0; i < iterations; ++i)
+    {
+        const struct vec4* v = &math->vectors[i % BENCH_MATRICES];
+        struct vec3 translation;
+        struct vec3 angles;
+        struct vec3 scale;
+        vec3_init(&translation, v->x, v->y, v->z);
+        vec3_init(&angles, 0.0f, 0.0f, v->x);
+        vec3_init(&scale, 2.0f, 2.0f, 2.0f);
+
+        struct mat4* m = &math->products[i % BENCH_MATRICES];
+        mat4_identity(m);
+        mat4_translation(m, &translation);
+        mat4_rotation(m, &angles);
+        mat4_scale(m, &scale);
+    }
+    sink = math->products[0].elements[0];
+    return iterations;
+}
+
+static uint64_t bench_mat4_from_trs(void* context, uint64_t iterations)
+{
+    struct math_context* math = context;
+    for (uint64_t i = 0; i < iterations; ++i)
+    {
+        const struct vec4* v = &math->vectors[i % BENCH_MATRICES];
+        struct vec3 translation;
+        struct vec3 scale;
+        vec3_init(&translation, v->x, v->y, v->z);
+        vec3_init(&scale, 2.0f, 2.0f, 2.0f);
+
+        mat4_from_trs(&math->products[i % BENCH_MATRICES], &translation, &math->rotations[i % BENCH_MATRICES], &scale);
+    }
+    sink = math->products[0].elements[0];
+    return iterations;
+}
+
+static uint64_t bench_mat4_from_trs_batch(void* context, uint64_t iterations)
+{
+    struct math_context* math = context;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        mat4_from_trs_batch(math->products, math->x, math->y, math->z, NULL, math->rotations, math->scales, BENCH_MATRICES);
+    }
+    sink = math->products[0].elements[0];
+    return iterations * BENCH_MATRICES;
+}
+
+static void bench_math(const struct bench_settings* settings)
+{
+    static struct math_context math;
+    math.matrices = util_allocate_aligned(BODIES_ALIGNMENT, BENCH_MATRICES * sizeof(struct mat4), "benchmark data");
+    math.products = util_allocate_aligned(BODIES_ALIGNMENT, BENCH_MATRICES * sizeof(struct mat4), "benchmark data");
+    math.vectors = util_allocate_aligned(BODIES_ALIGNMENT, BENCH_MATRICES * sizeof(struct vec4), "benchmark data");
+    math.transformed = util_allocate_aligned(BODIES_ALIGNMENT, BENCH_MATRICES * sizeof(struct vec4), "benchmark data");
+
+    /* Near-orthonormal matrices so repeated products stay finite */
+    uint32_t state = 12345;
+    for (uint32_t i = 0; i < BENCH_MATRICES; ++i) {
+        struct vec3 angles;
+        state = state * 1664525u + 1013904223u;
+        vec3_init(&angles, (float)(state >> 8) / 16777216.0f * 90.0f, 1.0f, 2.0f);
+        mat4_identity(&math.matrices[i]);
+        mat4_rotation(&math.matrices[i], &angles);
+        vec4_init(&math.vectors[i], (float)i, 1.0f, -2.0f, 1.0f);
+
+        quat_from_angles(&math.rotations[i], &angles);
+        math.x[i] = i;
+        math.y[i] = 1.0;
+        math.z[i] = -2.0;
+        math.scales[i] = 2.0f;
+    }
+
+    run(settings, "math/mat4_mul", bench_mat4_mul, &math);
+    run(settings, "math/mat4_mul_batch", bench_mat4_mul_batch, &math);
+    run(settings, "math/mat4_transform_batch", bench_mat4_transform_batch, &math);
+    run(settings, "math/mat4_rotation", bench_mat4_rotation, &math);
+    run(settings, "math/mat4_look_at", bench_mat4_look_at, &math);
+    run(settings, "math/mat4_trs_chain", bench_mat4_trs_chain, &math);
+    run(settings, "math/mat4_from_trs", bench_mat4_from_trs, &math);
+    run(settings, "math/mat4_from_trs_batch", bench_mat4_from_trs_batch, &math);
+
+    free(math.matrices);
+    free(math.products);
+    free(math.vectors);
+    free(math.transformed);
+}
+
+/* physics */
+
+static bool make_simulation(struct simulation* sim, struct thread_pool* pool, uint32_t asteroids, enum gravity_solver solver,
+                            enum integrator_type integrator, double dt)
+{
+    struct simulation_options options;
+    simulation_options_default(&options);
+    options.asteroids = asteroids;
+    options.solver = solver;
+    options.theta = 0.6;
+    options.integrator = integrator;
+    options.dt = dt;
+
+    simulation_init(sim, asteroids + 16, dt);
+    simulation_set_thread_pool(sim, pool);
+    if (!simulation_options_apply(&options, sim, NULL)) {
+        simulation_free(sim);
+        return false;
+    }
+    return true;
+}
+
+static uint64_t bench_gravity(void* context, uint64_t iterations)
+{
+    struct simulation* sim = context;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        gravity_accelerations(&sim->gravity, &sim->bodies);
+    }
+    sink = (float)sim->bodies.ax[1];
+    return iterations;
+}
+
+static uint64_t bench_step(void* context, uint64_t iterations)
+{
+    struct simulation* sim = context;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        simulation_step(sim);
+    }
+    sink = (float)sim->bodies.x[1];
+    return iterations;
+}
+
+static void bench_physics(const struct bench_settings* settings, struct thread_pool* pool)
+{
+    char name[BENCH_NAME_MAX];
+    struct simulation sim;
+
+    const enum gravity_kernel kernels[] = {GRAVITY_KERNEL_SCALAR, GRAVITY_KERNEL_SSE2, GRAVITY_KERNEL_AVX2};
+    if (make_simulation(&sim, pool, 2000, GRAVITY_SOLVER_DIRECT, INTEGRATOR_LEAPFROG, 1.0)) {
+        for (uint32_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); ++i) {
+            gravity_set_kernel(&sim.gravity, kernels[i]);
+            /* Kernels this CPU lacks fall back; do not time the fallback twice */
+            if (sim.gravity.kernel != kernels[i]) {
+                continue;
+            }
+            snprintf(name, sizeof(name), "gravity/direct_%s_n%" PRIu32, gravity_kernel_name(kernels[i]), sim.bodies.count);
+            run(settings, name, bench_gravity, &sim);
+        }
+        simulation_free(&sim);
+    }
+
+    if (make_simulation(&sim, pool, 20000, GRAVITY_SOLVER_BARNES_HUT, INTEGRATOR_LEAPFROG, 1.0)) {
+        snprintf(name, sizeof(name), "gravity/barnes_hut_n%" PRIu32, sim.bodies.count);
+        run(settings, name, bench_gravity, &sim);
+        simulation_free(&sim);
+    }
+
+    const enum integrator_type integrators[] = {
+        INTEGRATOR_LEAPFROG, INTEGRATOR_YOSHIDA4, INTEGRATOR_WISDOM_HOLMAN, INTEGRATOR_BLOCK_LEAPFROG
+    };
+    for (uint32_t i = 0; i < sizeof(integrators) / sizeof(integrators[0]); ++i) {
+        if (make_simulation(&sim, pool, 1000, GRAVITY_SOLVER_DIRECT, integrators[i], 2.0)) {
+            snprintf(name, sizeof(name), "integrator/%s_n%" PRIu32, integrator_name(integrators[i]), sim.bodies.count);
+            run(settings, name, bench_step, &sim);
+            simulation_free(&sim);
+        }
+    }
+}
+
+/* rendering */
+
+#define BENCH_CULL_BODIES 100000
+
+struct cull_context
+{
+    struct cull_params params;
+    struct draw_list list;
+    double* x;
+    double* y;
+    double* z;
+    float* radii;
+};
+
+static uint64_t bench_cull(void* context, uint64_t iterations)
+{
+    struct cull_context* cull = context;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        cull_spheres(&cull->list, &cull->params, cull->x, cull->y, cull->z, cull->radii, BENCH_CULL_BODIES);
+    }
+    sink = (float)cull->list.counts[LOD_POINT];
+    return iterations * BENCH_CULL_BODIES;
+}
+
+static void bench_rendering(const struct bench_settings* settings)
+{
+    struct cull_context cull;
+    cull.x = util_allocate(BENCH_CULL_BODIES * sizeof(double), "benchmark data");
+    cull.y = util_allocate(BENCH_CULL_BODIES * sizeof(double), "benchmark data");
+    cull.z = util_allocate(BENCH_CULL_BODIES * sizeof(double), "benchmark data");
+    cull.radii = util_allocate(BENCH_CULL_BODIES * sizeof(float), "benchmark data");
+
+    /* A belt-like disc seen from the viewer's default camera */
+    uint32_t state = 12345;
+    for (uint32_t i = 0; i < BENCH_CULL_BODIES; ++i) {
+        state = state * 1664525u + 1013904223u;
+        const double angle = (double)(state >> 8) / 16777216.0 * 2.0 * M_PI;
+        const double distance = 2.0 + (double)(i % 1000) * 0.004;
+        cull.x[i] = distance * cos(angle);
+        cull.y[i] = distance * sin(angle);
+        cull.z[i] = 0.0;
+        cull.radii[i] = 0.05f;
+    }
+
+    /* Camera-relative like the renderer: the view only rotates */
+    struct mat4 projection = mat4_perspective_reversed(45.0f, 960.0f / 540.0f, 1e-6f);
+    struct vec3 camera;
+    struct vec3 eye;
+    struct vec3 direction;
+    struct vec3 up;
+    vec3_init(&camera, 0.0f, -40.0f, 25.0f);
+    vec3_init(&eye, 0.0f, 0.0f, 0.0f);
+    vec3_init(&direction, 0.0f, 40.0f, -25.0f);
+    vec3_init(&up, 0.0f, 0.0f, 1.0f);
+    struct mat4 view_projection = projection;
+    const struct mat4 view = mat4_look_at(eye, direction, up);
+    mat4_mul(&view_projection, &view);
+
+    cull_params_init(&cull.params, &projection, &view_projection, &camera, 540);
+    draw_list_init(&cull.list, BENCH_CULL_BODIES);
+    run(settings, "render/cull_spheres", bench_cull, &cull);
+
+    draw_list_free(&cull.list);
+    free(cull.x);
+    free(cull.y);
+    free(cull.z);
+    free(cull.radii);
+}
+
+/* assets */
+
+static uint64_t bench_shader_parse(void* context, uint64_t iterations)
+{
+    const char* path = context;
+    uint32_t slices = 0;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        struct shader_source source;
+        shader_source_parse(&source, path);
+        slices += source.stages[SHADER_STAGE_VERTEX].count;
+        shader_source_free(&source);
+    }
+    sink = (float)slices;
+    return iterations;
+}
+
+static uint64_t bench_texture_decode(void* context, uint64_t iterations)
+{
+    const char* path = context;
+    uint32_t levels = 0;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        struct texture_image image;
+        if (!texture_image_load(&image, path)) {
+            fprintf(stderr, "Failed to load '%s'!\n", path);
+            abort();
+        }
+        levels += image.level_count;
+        texture_image_free(&image);
+    }
+    sink = (float)levels;
+    return iterations;
+}
+
+static uint64_t bench_sphere_mesh(void* context, uint64_t iterations)
+{
+    const uint32_t* subdivisions = context;
+    uint32_t vertices = 0;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        struct mesh mesh;
+        sphere_mesh_generate(&mesh, *subdivisions);
+        mesh_optimize(&mesh);
+        vertices += mesh.vertex_count;
+        mesh_free(&mesh);
+    }
+    sink = (float)vertices;
+    return iterations;
+}
+
+static bool exists(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (file) {
+        fclose(file);
+    }
+    return file != NULL;
+}
+
+static void bench_assets(const struct bench_settings* settings)
+{
+    /* GL compile and upload need a context, so only the CPU side is timed here */
+    const char* shaders[] = {"basic.shader", "basic_instanced.shader"};
+    const char* textures[] = {"wall.jpg", "wall.ktx"};
+    char name[BENCH_NAME_MAX];
+
+    for (uint32_t i = 0; i < 2; ++i) {
+        if (exists(shaders[i])) {
+            snprintf(name, sizeof(name), "assets/shader_parse_%s", shaders[i]);
+            run(settings, name, bench_shader_parse, (void*)shaders[i]);
+        }
+    }
+    uint32_t subdivisions = 4;
+    run(settings, "assets/sphere_mesh_4", bench_sphere_mesh, &subdivisions);
+
+    for (uint32_t i = 0; i < 2; ++i) {
+        if (exists(textures[i])) {
+            snprintf(name, sizeof(name), "assets/texture_decode_%s", textures[i]);
+            run(settings, name, bench_texture_decode, (void*)textures[i]);
+        }
+    }
+}
+
+/* output */
+
+static void write_json(FILE* out)
+{
+    char features[64] = "";
+    const enum cpu_feature all[] = {CPU_FEATURE_SSE2, CPU_FEATURE_AVX, CPU_FEATURE_AVX2, CPU_FEATURE_FMA};
+    for (uint32_t i = 0; i < sizeof(all) / sizeof(all[0]); ++i) {
+        if (cpu_features() & all[i]) {
+            strcat(features, features[0] ? " " : "");
+            strcat(features, cpu_feature_name(all[i]));
+        }
+    }
+
+    fprintf(out, "{\n  \"profile\": \"%s\",\n  \"compiler\": \"%s\",\n  \"cpu_features\": \"%s\",\n", BENCH_PROFILE, __VERSION__, features);
+    fputs("  \"results\": [\n", out);
+    /* One result per line: baselines are read back line by line */
+    for (uint32_t i = 0; i < result_count; ++i) {
+        fprintf(out, "    {\"name\": \"%s\", \"ns_per_op\": %.3f, \"ops\": %" PRIu64 "}%s\n", results[i].name, results[i].ns_per_op,
+                results[i].ops, i + 1 < result_count ? "," : "");
+    }
+    fputs("  ]\n}\n", out);
+}
+
+static uint32_t compare_baseline(const char* path, double threshold)
+{
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Failed to open baseline '%s'!\n", path);
+        return 1;
+    }
+
+    uint32_t regressions = 0;
+    char line[512];
+    fprintf(stderr, "\n%-44s %12s %12s %8s\n", "benchmark", "baseline", "current", "change");
+    while (fgets(line, sizeof(line), file))
+    {
+        char name[BENCH_NAME_MAX];
+        double baseline;
+        const char* entry = strstr(line, "{\"name\": \"");
+        if (!entry || sscanf(entry, "{\"name\": \"%63[^\"]\", \"ns_per_op\": %lf", name, &baseline) != 2) {
+            continue;
+        }
+        for (uint32_t i = 0; i < result_count; ++i)
+        {
+            if (strcmp(results[i].name, name) != 0) {
+                continue;
+            }
+            const double change = results[i].ns_per_op / baseline - 1.0;
+            const bool regressed = change > threshold;
+            regressions += regressed;
+            fprintf(stderr, "%-44s %12.1f %12.1f %+7.1f%%%s\n", name, baseline, results[i].ns_per_op, 100.0 * change,
+                    regressed ? "  REGRESSION" : "");
+        }
+    }
+    fclose(file);
+    return regressions;
+}
+
+static void usage(const char* program)
+{
+    fprintf(stderr, "Usage: %s [options]\n", program);
+    fputs("  --filter TEXT         only run benchmarks whose name contains TEXT\n"
+          "  --quick               shorter samples, for smoke runs and PGO training\n"
+          "  --threads N           worker threads for the physics benchmarks (default 1, 0 = all cores)\n"
+          "  --json FILE           write results as JSON ('-' for stdout)\n"
+          "  --baseline FILE       compare against an earlier --json file\n"
+          "  --threshold FRACTION  slowdown that counts as a regression (default 0.10)\n"
+          "Run from the repository root so the asset benchmarks find their files.\n", stderr);
+}
+
+int main(int argc, char** argv)
+{
+    struct bench_settings settings = {.sample_time = 0.1, .filter = NULL, .threads = 1};
+    const char* json = NULL;
+    const char* baseline = NULL;
+    double threshold = 0.10;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            settings.filter = argv[++i];
+        } else if (strcmp(argv[i], "--quick") == 0) {
+            settings.sample_time = 0.01;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            settings.threads = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json = argv[++i];
+        } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baseline = argv[++i];
+        } else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            threshold = strtod(argv[++i], NULL);
+        } else {
+            usage(argv[0]);
+            return strcmp(argv[i], "--help") == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    struct thread_pool pool;
+    thread_pool_init(&pool, settings.threads);
+    fprintf(stderr, "Profile: %s, threads: %" PRIu32 "\n", BENCH_PROFILE, thread_pool_thread_count(&pool));
+
+    bench_math(&settings);
+    bench_physics(&settings, &pool);
+    bench_rendering(&settings);
+    bench_assets(&settings);
+
+    thread_pool_free(&pool);
+
+    if (json) {
+        FILE* out = strcmp(json, "-") == 0 ? stdout : fopen(json, "w");
+        if (!out) {
+            fprintf(stderr, "Failed to create '%s'!\n", json);
+            return EXIT_FAILURE;
+        }
+        write_json(out);
+        if (out != stdout) {
+            fclose(out);
+        }
+    }
+
+    if (baseline) {
+        const uint32_t regressions = compare_baseline(baseline, threshold);
+        if (regressions > 0) {
+            fprintf(stderr, "%" PRIu32 " benchmark(s) regressed by more than %.0f%%\n", regressions, 100.0 * threshold);
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,7 @@
+layout (std140, row_major, binding = 0) uniform Camera
+{
+   mat4 u_Projection;
+   mat4 u_View;
+   mat4 u_ViewProjection;
+   vec4 u_CameraPosition;
+};
@@ -0,0 +1,30 @@
+#shader vertex
+#version 450 core
+
+layout (std430, row_major, binding = 0) readonly buffer Instances
+{
+   mat4 u_Transforms[];
+};
+
+#include "camera.glsl"
+
+uniform int u_BaseInstance;
+uniform float u_PointSize;
+
+void main()
+{
+   /* Column 3 of the model matrix is the body position */
+   gl_Position = u_ViewProjection * vec4(u_Transforms[u_BaseInstance + gl_InstanceID][3].xyz, 1.0);
+   gl_PointSize = u_PointSize;
+}
+
+#shader fragment
+#version 450 core
+out vec4 FragColor;
+
+uniform vec4 u_Color;
+
+void main()
+{
+   FragColor = u_Color;
+}
@@ -1,5 +1,7 @@
 #include "buffers.h"
 
+#include <stdlib.h>
+
 #include <GL/glew.h>
 
 void buffers_init(uint32_t n, buffer_handle_t* buffers, size_t* sizes, void** data)
@@ -13,4 +15,90 @@ void buffers_init(uint32_t n, buffer_handle_t* buffers, size_t* sizes, void** da
 void buffers_free(uint32_t n, buffer_handle_t* buffers)
 {
     glDeleteBuffers(n, buffers);
-}
\ No newline at end of file
+}
+
+size_t buffers_offset_alignment(void)
+{
+    int32_t uniform_alignment = 256;
+    int32_t storage_alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniform_alignment);
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storage_alignment);
+    return (size_t)(uniform_alignment > storage_alignment ? uniform_alignment : storage_alignment);
+}
+
+void* buffers_init_persistent(buffer_handle_t* buffer, size_t size)
+{
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(1, buffer);
+    glNamedBufferStorage(*buffer, size, NULL, flags);
+    void* mapped = glMapNamedBufferRange(*buffer, 0, size, flags);
+    if (!mapped) {
+        fputs("Failed to map a persistent buffer!\n", stderr);
+        abort();
+    }
+    return mapped;
+}
+
+void stream_buffer_init(struct stream_buffer* stream, size_t region_size)
+{
+    /* Regions are bound with glBindBufferRange, so keep their offsets legal for UBOs and SSBOs */
+    const size_t alignment = buffers_offset_alignment();
+    region_size = (region_size + alignment - 1) / alignment * alignment;
+
+    stream->region_size = region_size;
+    stream->region = 0;
+    for (uint32_t i = 0; i < STREAM_BUFFER_REGIONS; ++i) {
+        stream->fences[i] = NULL;
+    }
+
+    /* Fences per region provide the synchronization the persistent mapping lacks */
+    stream->mapped = buffers_init_persistent(&stream->handle, region_size * STREAM_BUFFER_REGIONS);
+}
+
+void stream_buffer_free(struct stream_buffer* stream)
+{
+    for (uint32_t i = 0; i < STREAM_BUFFER_REGIONS; ++i) {
+        if (stream->fences[i]) {
+            glDeleteSync(stream->fences[i]);
+            stream->fences[i] = NULL;
+        }
+    }
+    glUnmapNamedBuffer(stream->handle);
+    glDeleteBuffers(1, &stream->handle);
+    stream->mapped = NULL;
+}
+
+void* stream_buffer_begin(struct stream_buffer* stream)
+{
+    GLsync fence = stream->fences[stream->region];
+    if (fence) {
+        /* Only blocks when the GPU is more than two frames behind */
+        GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        while (status == GL_TIMEOUT_EXPIRED) {
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        }
+        if (status == GL_WAIT_FAILED) {
+            fputs("Failed to wait on a stream buffer fence!\n", stderr);
+            abort();
+        }
+        glDeleteSync(fence);
+        stream->fences[stream->region] = NULL;
+    }
+    return stream->mapped + stream_buffer_offset(stream);
+}
+
+size_t stream_buffer_offset(const struct stream_buffer* stream)
+{
+    return stream->region * stream->region_size;
+}
+
+void stream_buffer_bind_range(const struct stream_buffer* stream, uint32_t target, uint32_t binding, size_t size)
+{
+    glBindBufferRange(target, binding, stream->handle, stream_buffer_offset(stream), size > 0 ? size : stream->region_size);
+}
+
+void stream_buffer_end(struct stream_buffer* stream)
+{
+    stream->fences[stream->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    stream->region = (stream->region + 1) % STREAM_BUFFER_REGIONS;
+}
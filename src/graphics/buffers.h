@@ -9,4 +9,35 @@ typedef uint32_t buffer_handle_t;
 void buffers_init(uint32_t n, buffer_handle_t* buffers, size_t* sizes, void** data);
 void buffers_free(uint32_t n, buffer_handle_t* buffers);
 
-#endif
\ No newline at end of file
+/* Offset alignment that is legal for both UBO and SSBO range bindings */
+size_t buffers_offset_alignment(void);
+
+/* Immutable storage mapped write-only for its whole lifetime and coherent, so
+ * writes need no flush. Returns the mapping; free with buffers_free. There is
+ * no synchronization: only write what draws in flight will not read */
+void* buffers_init_persistent(buffer_handle_t* buffer, size_t size);
+
+#define STREAM_BUFFER_REGIONS 3
+
+/*
+ * Persistently mapped ring for data rewritten every frame. Each frame writes
+ * one region while the GPU may still read the other two; a fence per region
+ * keeps the CPU from overwriting data a draw has not consumed yet.
+ */
+struct stream_buffer
+{
+    buffer_handle_t handle;
+    size_t region_size;
+    uint32_t region;
+    uint8_t* mapped;
+    void* fences[STREAM_BUFFER_REGIONS];
+};
+
+void stream_buffer_init(struct stream_buffer* stream, size_t region_size);
+void stream_buffer_free(struct stream_buffer* stream);
+void* stream_buffer_begin(struct stream_buffer* stream);
+size_t stream_buffer_offset(const struct stream_buffer* stream);
+void stream_buffer_bind_range(const struct stream_buffer* stream, uint32_t target, uint32_t binding, size_t size);
+void stream_buffer_end(struct stream_buffer* stream);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef CAMERA_H
+#define CAMERA_H
+
+#include "../math/vec4.h"
+#include "../math/mat4.h"
+
+/* Mirrors the std140 row_major "Camera" block shared by every program. The
+ * view has no translation: model matrices are already relative to the eye,
+ * whose world position is kept separately */
+struct camera_uniforms
+{
+    struct mat4 projection;
+    struct mat4 view;
+    struct mat4 view_projection;
+    struct vec4 position;
+};
+
+#endif
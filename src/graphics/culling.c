@@ -0,0 +1,160 @@
+#include "culling.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../util/util.h"
+
+/* Bodies are classified a block at a time into a byte per body, which the
+ * compiler vectorizes, and then compacted into the per-level lists */
+#define CULL_BLOCK 256
+#define CULL_REJECTED LOD_COUNT
+
+void frustum_init(struct frustum* frustum, const struct mat4* view_projection)
+{
+    /* Gribb-Hartmann: x and y planes are the last row plus or minus another row;
+     * with 0 <= z <= w the depth planes are row 2 and the last row minus row 2 */
+    const float* m = view_projection->elements;
+    for (uint32_t i = 0; i < 6; ++i)
+    {
+        float* plane = frustum->planes[i];
+        for (uint32_t col = 0; col < 4; ++col)
+        {
+            const float w = m[col + 3 * 4];
+            switch (i)
+            {
+            case 0: plane[col] = w + m[col + 0 * 4]; break;
+            case 1: plane[col] = w - m[col + 0 * 4]; break;
+            case 2: plane[col] = w + m[col + 1 * 4]; break;
+            case 3: plane[col] = w - m[col + 1 * 4]; break;
+            case 4: plane[col] = m[col + 2 * 4]; break;
+            default: plane[col] = w - m[col + 2 * 4]; break;
+            }
+        }
+
+        /* An infinite far plane has a zero normal and a positive distance, so it passes everything */
+        const float length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        if (length > 0.0f) {
+            for (uint32_t col = 0; col < 4; ++col) {
+                plane[col] /= length;
+            }
+        }
+    }
+}
+
+void cull_params_init(struct cull_params* params, const struct mat4* projection, const struct mat4* view_projection,
+                      const struct vec3* camera, uint32_t viewport_height)
+{
+    frustum_init(&params->frustum, view_projection);
+    params->camera[0] = camera->x;
+    params->camera[1] = camera->y;
+    params->camera[2] = camera->z;
+
+    /* elements[1 + 1 * 4] is cot(fov / 2) */
+    params->pixel_scale = projection->elements[1 + 1 * 4] * 0.5f * (float)viewport_height;
+
+    params->full_pixels = 24.0f;
+    params->low_pixels = 4.0f;
+    params->min_pixels = 0.0f;
+}
+
+void draw_list_init(struct draw_list* list, uint32_t capacity)
+{
+    list->capacity = capacity > 0 ? capacity : 1;
+    list->culled = 0;
+    for (uint32_t level = 0; level < LOD_COUNT; ++level)
+    {
+        list->counts[level] = 0;
+        list->indices[level] = util_allocate(list->capacity * sizeof(uint32_t), "draw list");
+    }
+}
+
+void draw_list_free(struct draw_list* list)
+{
+    for (uint32_t level = 0; level < LOD_COUNT; ++level) {
+        free(list->indices[level]);
+        list->indices[level] = NULL;
+        list->counts[level] = 0;
+    }
+    list->capacity = 0;
+}
+
+static void classify(uint8_t* restrict levels, const struct cull_params* params, float planes[6][4], const double* restrict x,
+                     const double* restrict y, const double* restrict z, const float* restrict radii, uint32_t count)
+{
+    /* Sizes are compared squared, pixels >= t as (r * scale)^2 >= t^2 * distance^2,
+     * which avoids sqrtf (it may set errno, which keeps the loop scalar) */
+    const float full2 = params->full_pixels * params->full_pixels;
+    const float low2 = params->low_pixels * params->low_pixels;
+    const float min2 = params->min_pixels * params->min_pixels;
+    const float pixel_scale = params->pixel_scale;
+    const double cx = params->camera[0];
+    const double cy = params->camera[1];
+    const double cz = params->camera[2];
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        /* Subtract in double so bodies near a distant camera keep their precision */
+        const float px = (float)(x[i] - cx);
+        const float py = (float)(y[i] - cy);
+        const float pz = (float)(z[i] - cz);
+        const float r = radii[i];
+
+        /* Bitwise & so every plane is evaluated without branches */
+        int inside = 1;
+        for (uint32_t p = 0; p < 6; ++p) {
+            inside &= planes[p][0] * px + planes[p][1] * py + planes[p][2] * pz + planes[p][3] >= -r;
+        }
+
+        const float distance2 = px * px + py * py + pz * pz;
+        const float projected = r * pixel_scale;
+        const float projected2 = projected * projected;
+
+        int level = CULL_REJECTED;
+        level = projected2 >= min2 * distance2 ? LOD_POINT : level;
+        level = projected2 >= low2 * distance2 ? LOD_LOW : level;
+        level = projected2 >= full2 * distance2 ? LOD_FULL : level;
+        levels[i] = (uint8_t)(inside ? level : CULL_REJECTED);
+    }
+}
+
+void cull_spheres(struct draw_list* list, const struct cull_params* params, const double* x, const double* y, const double* z,
+                  const float* radii, uint32_t count)
+{
+    if (count > list->capacity) {
+        draw_list_free(list);
+        draw_list_init(list, count + count / 2);
+    }
+
+    float planes[6][4];
+    memcpy(planes, params->frustum.planes, sizeof(planes));
+
+    uint32_t counts[LOD_COUNT + 1] = {0};
+    uint32_t* indices[LOD_COUNT];
+    for (uint32_t level = 0; level < LOD_COUNT; ++level) {
+        indices[level] = list->indices[level];
+    }
+
+    uint8_t levels[CULL_BLOCK];
+    for (uint32_t begin = 0; begin < count; begin += CULL_BLOCK)
+    {
+        const uint32_t block = count - begin < CULL_BLOCK ? count - begin : CULL_BLOCK;
+        classify(levels, params, planes, x + begin, y + begin, z + begin, radii + begin, block);
+
+        for (uint32_t i = 0; i < block; ++i)
+        {
+            const uint8_t level = levels[i];
+            if (level != CULL_REJECTED) {
+                indices[level][counts[level]] = begin + i;
+            }
+            counts[level]++;
+        }
+    }
+
+    for (uint32_t level = 0; level < LOD_COUNT; ++level) {
+        list->counts[level] = counts[level];
+    }
+    list->culled = counts[CULL_REJECTED];
+}
@@ -0,0 +1,63 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <inttypes.h>
+
+#include "../math/vec3.h"
+#include "../math/mat4.h"
+
+enum lod_level
+{
+    LOD_FULL = 0,
+    LOD_LOW,
+    LOD_POINT,
+    LOD_COUNT
+};
+
+/* Planes as (normal, distance) with normals pointing inwards, in the order
+ * left, right, bottom, top, then the two depth planes. Extracted for a
+ * [0, 1] clip depth range, as set up by glClipControl */
+struct frustum
+{
+    float planes[6][4];
+};
+
+struct cull_params
+{
+    struct frustum frustum;
+    /* Eye position; the planes live in camera-relative space around it */
+    double camera[3];
+    /* Projected radius in pixels of a unit sphere at unit distance */
+    float pixel_scale;
+
+    /* Smallest projected radius in pixels that selects each level; anything
+     * below min_pixels is dropped entirely */
+    float full_pixels;
+    float low_pixels;
+    float min_pixels;
+};
+
+/* Body indices to draw, grouped by level */
+struct draw_list
+{
+    uint32_t capacity;
+    uint32_t counts[LOD_COUNT];
+    uint32_t* indices[LOD_COUNT];
+    uint32_t culled;
+};
+
+void frustum_init(struct frustum* frustum, const struct mat4* view_projection);
+
+/* view_projection must be built from projection and a view without translation,
+ * the same camera-relative matrix the renderer draws with */
+void cull_params_init(struct cull_params* params, const struct mat4* projection, const struct mat4* view_projection,
+                      const struct vec3* camera, uint32_t viewport_height);
+
+void draw_list_init(struct draw_list* list, uint32_t capacity);
+void draw_list_free(struct draw_list* list);
+
+/* Tests bounding spheres against the frustum and picks a level by projected size */
+void cull_spheres(struct draw_list* list, const struct cull_params* params, const double* x, const double* y, const double* z,
+                  const float* radii, uint32_t count);
+
+#endif
@@ -0,0 +1,58 @@
+#include "framebuffer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <GL/glew.h>
+
+void framebuffer_init(struct framebuffer* framebuffer, uint32_t width, uint32_t height)
+{
+    framebuffer->width = width > 0 ? width : 1;
+    framebuffer->height = height > 0 ? height : 1;
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &framebuffer->color);
+    glTextureStorage2D(framebuffer->color, 1, GL_RGBA8, framebuffer->width, framebuffer->height);
+    glCreateTextures(GL_TEXTURE_2D, 1, &framebuffer->depth);
+    glTextureStorage2D(framebuffer->depth, 1, GL_DEPTH_COMPONENT32F, framebuffer->width, framebuffer->height);
+
+    glCreateFramebuffers(1, &framebuffer->handle);
+    glNamedFramebufferTexture(framebuffer->handle, GL_COLOR_ATTACHMENT0, framebuffer->color, 0);
+    glNamedFramebufferTexture(framebuffer->handle, GL_DEPTH_ATTACHMENT, framebuffer->depth, 0);
+
+    if (glCheckNamedFramebufferStatus(framebuffer->handle, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        fputs("Incomplete framebuffer!\n", stderr);
+        abort();
+    }
+}
+
+void framebuffer_free(struct framebuffer* framebuffer)
+{
+    glDeleteFramebuffers(1, &framebuffer->handle);
+    glDeleteTextures(1, &framebuffer->color);
+    glDeleteTextures(1, &framebuffer->depth);
+}
+
+void framebuffer_resize(struct framebuffer* framebuffer, uint32_t width, uint32_t height)
+{
+    /* A minimized window reports 0x0; keep the 1x1 target instead of recreating it every frame */
+    width = width > 0 ? width : 1;
+    height = height > 0 ? height : 1;
+    if (width == framebuffer->width && height == framebuffer->height) {
+        return;
+    }
+    framebuffer_free(framebuffer);
+    framebuffer_init(framebuffer, width, height);
+}
+
+void framebuffer_bind(const struct framebuffer* framebuffer)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer->handle);
+    glViewport(0, 0, (GLsizei)framebuffer->width, (GLsizei)framebuffer->height);
+}
+
+void framebuffer_present(const struct framebuffer* framebuffer)
+{
+    const GLint width = (GLint)framebuffer->width;
+    const GLint height = (GLint)framebuffer->height;
+    glBlitNamedFramebuffer(framebuffer->handle, 0, 0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+}
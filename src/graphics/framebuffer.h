@@ -0,0 +1,28 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <inttypes.h>
+
+#include "texture.h"
+
+/* Off-screen colour target with a 32-bit float depth buffer. The default
+ * framebuffer only offers fixed-point depth, which wastes reversed-Z */
+struct framebuffer
+{
+    uint32_t handle;
+    texture_t color;
+    texture_t depth;
+    uint32_t width;
+    uint32_t height;
+};
+
+void framebuffer_init(struct framebuffer* framebuffer, uint32_t width, uint32_t height);
+void framebuffer_free(struct framebuffer* framebuffer);
+/* Recreates the attachments if the size changed */
+void framebuffer_resize(struct framebuffer* framebuffer, uint32_t width, uint32_t height);
+/* Binds for drawing and sets the viewport to cover it */
+void framebuffer_bind(const struct framebuffer* framebuffer);
+/* Copies colour to the default framebuffer, which must be the same size */
+void framebuffer_present(const struct framebuffer* framebuffer);
+
+#endif
@@ -0,0 +1,51 @@
+#include "instances.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <GL/glew.h>
+
+void instance_buffer_init(struct instance_buffer* instances, uint32_t capacity)
+{
+    instances->count = 0;
+    instances->capacity = capacity > 0 ? capacity : 1;
+    instances->transforms = NULL;
+    stream_buffer_init(&instances->stream, instances->capacity * sizeof(struct mat4));
+}
+
+void instance_buffer_free(struct instance_buffer* instances)
+{
+    stream_buffer_free(&instances->stream);
+    instances->transforms = NULL;
+    instances->count = 0;
+    instances->capacity = 0;
+}
+
+void instance_buffer_reserve(struct instance_buffer* instances, uint32_t capacity)
+{
+    if (capacity <= instances->capacity) {
+        return;
+    }
+
+    /* GL keeps the old storage alive until draws that use it have finished */
+    stream_buffer_free(&instances->stream);
+    instances->capacity = capacity + capacity / 2;
+    stream_buffer_init(&instances->stream, instances->capacity * sizeof(struct mat4));
+}
+
+struct mat4* instance_buffer_begin(struct instance_buffer* instances)
+{
+    instances->transforms = stream_buffer_begin(&instances->stream);
+    return instances->transforms;
+}
+
+void instance_buffer_bind(const struct instance_buffer* instances, uint32_t binding)
+{
+    stream_buffer_bind_range(&instances->stream, GL_SHADER_STORAGE_BUFFER, binding, instances->count * sizeof(struct mat4));
+}
+
+void instance_buffer_end(struct instance_buffer* instances)
+{
+    stream_buffer_end(&instances->stream);
+    instances->transforms = NULL;
+}
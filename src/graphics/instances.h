@@ -0,0 +1,30 @@
+#ifndef INSTANCES_H
+#define INSTANCES_H
+
+#include <inttypes.h>
+
+#include "../math/mat4.h"
+#include "buffers.h"
+
+/*
+ * Per-instance model matrices, read by the shader as a std430 row_major mat4[].
+ * transforms points into write-combined GPU memory between begin and end:
+ * write whole matrices and never read them back.
+ */
+struct instance_buffer
+{
+    struct stream_buffer stream;
+
+    uint32_t count;
+    uint32_t capacity;
+    struct mat4* transforms;
+};
+
+void instance_buffer_init(struct instance_buffer* instances, uint32_t capacity);
+void instance_buffer_free(struct instance_buffer* instances);
+void instance_buffer_reserve(struct instance_buffer* instances, uint32_t capacity);
+struct mat4* instance_buffer_begin(struct instance_buffer* instances);
+void instance_buffer_bind(const struct instance_buffer* instances, uint32_t binding);
+void instance_buffer_end(struct instance_buffer* instances);
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef KTX_H
+#define KTX_H
+
+#include <stddef.h>
+#include <inttypes.h>
+
+/*
+ * KTX 1.1 container as written by tools/texconv: a fixed header, no
+ * key/value data, then for each mip level a uint32 byte count followed by
+ * the level's compressed blocks.
+ */
+#define KTX_IDENTIFIER {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A}
+#define KTX_ENDIANNESS 0x04030201u
+
+#define KTX_FORMAT_RGB 0x1907u
+#define KTX_FORMAT_BC1 0x83F0u /* GL_COMPRESSED_RGB_S3TC_DXT1_EXT */
+
+/* Bytes in a BC1 image: one 8 byte block per 4x4 pixels, partial blocks rounded up */
+static inline size_t ktx_bc1_size(uint32_t width, uint32_t height)
+{
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * 8;
+}
+
+struct ktx_header
+{
+    uint8_t identifier[12];
+    uint32_t endianness;
+    uint32_t gl_type;
+    uint32_t gl_type_size;
+    uint32_t gl_format;
+    uint32_t gl_internal_format;
+    uint32_t gl_base_internal_format;
+    uint32_t pixel_width;
+    uint32_t pixel_height;
+    uint32_t pixel_depth;
+    uint32_t array_elements;
+    uint32_t faces;
+    uint32_t mip_levels;
+    uint32_t key_value_bytes;
+};
+
+#endif
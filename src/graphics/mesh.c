@@ -0,0 +1,311 @@
+#include "mesh.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../util/util.h"
+
+#define MESH_FILE_MAGIC 0x484D5353u /* "SSMH" */
+#define MESH_FILE_VERSION 1
+
+#define MESH_NONE UINT32_MAX
+
+struct mesh_file_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertex_size;
+    uint32_t vertex_count;
+    uint32_t index_count;
+};
+
+void mesh_init(struct mesh* mesh, uint32_t vertex_count, uint32_t index_count)
+{
+    mesh->vertex_count = vertex_count;
+    mesh->index_count = index_count;
+    mesh->vertices = util_allocate(vertex_count * sizeof(struct mesh_vertex), "mesh");
+    mesh->indices = util_allocate(index_count * sizeof(uint32_t), "mesh");
+}
+
+void mesh_free(struct mesh* mesh)
+{
+    free(mesh->vertices);
+    free(mesh->indices);
+    mesh->vertices = NULL;
+    mesh->indices = NULL;
+    mesh->vertex_count = 0;
+    mesh->index_count = 0;
+}
+
+#define MESH_VALENCE_TABLE 32
+
+/* Forsyth's scoring, tabulated once per optimize call */
+struct vertex_scoring
+{
+    float cache[MESH_VERTEX_CACHE_SIZE];
+    float valence[MESH_VALENCE_TABLE];
+};
+
+static void vertex_scoring_init(struct vertex_scoring* scoring)
+{
+    /* The last triangle's vertices score lower so strips do not just zig-zag */
+    const float scale = 1.0f / (MESH_VERTEX_CACHE_SIZE - 3);
+    for (uint32_t i = 0; i < MESH_VERTEX_CACHE_SIZE; ++i) {
+        scoring->cache[i] = i < 3 ? 0.75f : powf(1.0f - (float)(i - 3) * scale, 1.5f);
+    }
+    /* Boost vertices with few triangles left so they get finished off */
+    scoring->valence[0] = 0.0f;
+    for (uint32_t i = 1; i < MESH_VALENCE_TABLE; ++i) {
+        scoring->valence[i] = 2.0f * powf((float)i, -0.5f);
+    }
+}
+
+static float vertex_score(const struct vertex_scoring* scoring, int32_t cache_position, uint32_t remaining)
+{
+    /* A vertex no remaining triangle uses must never attract the next pick */
+    if (remaining == 0) {
+        return -1.0f;
+    }
+
+    const float cache = cache_position >= 0 ? scoring->cache[cache_position] : 0.0f;
+    const float valence = remaining < MESH_VALENCE_TABLE ? scoring->valence[remaining] : 2.0f * powf((float)remaining, -0.5f);
+    return cache + valence;
+}
+
+static void reorder_triangles(struct mesh* mesh)
+{
+    const uint32_t triangle_count = mesh->index_count / 3;
+    const uint32_t vertex_count = mesh->vertex_count;
+    uint32_t* indices = mesh->indices;
+
+    /* Vertex to triangle adjacency, compressed; the first remaining[v] entries are live */
+    uint32_t* offsets = util_allocate((vertex_count + 1) * sizeof(uint32_t), "mesh");
+    uint32_t* remaining = util_allocate(vertex_count * sizeof(uint32_t), "mesh");
+    uint32_t* adjacency = util_allocate(mesh->index_count * sizeof(uint32_t), "mesh");
+    int32_t* positions = util_allocate(vertex_count * sizeof(int32_t), "mesh");
+    float* scores = util_allocate(vertex_count * sizeof(float), "mesh");
+    float* triangle_scores = util_allocate(triangle_count * sizeof(float), "mesh");
+    bool* emitted = util_allocate(triangle_count * sizeof(bool), "mesh");
+    uint32_t* output = util_allocate(mesh->index_count * sizeof(uint32_t), "mesh");
+
+    struct vertex_scoring scoring;
+    vertex_scoring_init(&scoring);
+
+    memset(remaining, 0, vertex_count * sizeof(uint32_t));
+    for (uint32_t i = 0; i < mesh->index_count; ++i) {
+        remaining[indices[i]]++;
+    }
+    offsets[0] = 0;
+    for (uint32_t v = 0; v < vertex_count; ++v) {
+        offsets[v + 1] = offsets[v] + remaining[v];
+        remaining[v] = 0;
+    }
+    for (uint32_t i = 0; i < mesh->index_count; ++i) {
+        const uint32_t v = indices[i];
+        adjacency[offsets[v] + remaining[v]++] = i / 3;
+    }
+
+    for (uint32_t v = 0; v < vertex_count; ++v) {
+        positions[v] = -1;
+        scores[v] = vertex_score(&scoring, -1, remaining[v]);
+    }
+    uint32_t best = MESH_NONE;
+    float best_score = -1.0f;
+    for (uint32_t t = 0; t < triangle_count; ++t)
+    {
+        emitted[t] = false;
+        triangle_scores[t] = scores[indices[3 * t]] + scores[indices[3 * t + 1]] + scores[indices[3 * t + 2]];
+        if (triangle_scores[t] > best_score) {
+            best_score = triangle_scores[t];
+            best = t;
+        }
+    }
+
+    /* Three extra slots hold vertices just pushed out, so their scores get updated too */
+    uint32_t cache[MESH_VERTEX_CACHE_SIZE + 3];
+    uint32_t cache_count = 0;
+    uint32_t cursor = 0;
+
+    for (uint32_t written = 0; written < triangle_count; ++written)
+    {
+        if (best == MESH_NONE) {
+            /* Nothing in the cache has triangles left: continue from the next unused one */
+            while (emitted[cursor]) {
+                cursor++;
+            }
+            best = cursor;
+        }
+
+        const uint32_t* triangle = &indices[3 * best];
+        memcpy(&output[3 * written], triangle, 3 * sizeof(uint32_t));
+        emitted[best] = true;
+
+        uint32_t next[MESH_VERTEX_CACHE_SIZE + 3];
+        uint32_t next_count = 0;
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            const uint32_t v = triangle[k];
+            uint32_t* list = &adjacency[offsets[v]];
+            for (uint32_t j = 0; j < remaining[v]; ++j)
+            {
+                if (list[j] == best) {
+                    list[j] = list[--remaining[v]];
+                    break;
+                }
+            }
+            next[next_count++] = v;
+        }
+        for (uint32_t i = 0; i < cache_count && next_count < MESH_VERTEX_CACHE_SIZE + 3; ++i)
+        {
+            const uint32_t v = cache[i];
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+                next[next_count++] = v;
+            }
+        }
+        /* Anything that fell off the end of the extended cache was already scored as uncached */
+        memcpy(cache, next, next_count * sizeof(uint32_t));
+        cache_count = next_count;
+
+        for (uint32_t i = 0; i < cache_count; ++i)
+        {
+            const uint32_t v = cache[i];
+            positions[v] = i < MESH_VERTEX_CACHE_SIZE ? (int32_t)i : -1;
+            scores[v] = vertex_score(&scoring, positions[v], remaining[v]);
+        }
+
+        best = MESH_NONE;
+        best_score = -1.0f;
+        for (uint32_t i = 0; i < cache_count; ++i)
+        {
+            const uint32_t v = cache[i];
+            const uint32_t* list = &adjacency[offsets[v]];
+            for (uint32_t j = 0; j < remaining[v]; ++j)
+            {
+                const uint32_t t = list[j];
+                const uint32_t* other = &indices[3 * t];
+                triangle_scores[t] = scores[other[0]] + scores[other[1]] + scores[other[2]];
+                if (triangle_scores[t] > best_score) {
+                    best_score = triangle_scores[t];
+                    best = t;
+                }
+            }
+        }
+    }
+
+    memcpy(indices, output, mesh->index_count * sizeof(uint32_t));
+
+    free(offsets);
+    free(remaining);
+    free(adjacency);
+    free(positions);
+    free(scores);
+    free(triangle_scores);
+    free(emitted);
+    free(output);
+}
+
+static void reorder_vertices(struct mesh* mesh)
+{
+    uint32_t* remap = util_allocate(mesh->vertex_count * sizeof(uint32_t), "mesh");
+    struct mesh_vertex* vertices = util_allocate(mesh->vertex_count * sizeof(struct mesh_vertex), "mesh");
+    for (uint32_t v = 0; v < mesh->vertex_count; ++v) {
+        remap[v] = MESH_NONE;
+    }
+
+    uint32_t next = 0;
+    for (uint32_t i = 0; i < mesh->index_count; ++i)
+    {
+        const uint32_t v = mesh->indices[i];
+        if (remap[v] == MESH_NONE) {
+            remap[v] = next;
+            vertices[next++] = mesh->vertices[v];
+        }
+        mesh->indices[i] = remap[v];
+    }
+
+    /* Vertices no triangle references are dropped */
+    free(mesh->vertices);
+    mesh->vertices = vertices;
+    mesh->vertex_count = next;
+    free(remap);
+}
+
+void mesh_optimize(struct mesh* mesh)
+{
+    if (mesh->index_count < 3 || mesh->vertex_count == 0) {
+        return;
+    }
+    reorder_triangles(mesh);
+    reorder_vertices(mesh);
+}
+
+float mesh_acmr(const struct mesh* mesh, uint32_t cache_size)
+{
+    if (mesh->index_count < 3 || cache_size == 0) {
+        return 0.0f;
+    }
+
+    /* FIFO, as fixed-function post-transform caches were */
+    uint32_t* stamps = util_allocate(mesh->vertex_count * sizeof(uint32_t), "mesh");
+    memset(stamps, 0, mesh->vertex_count * sizeof(uint32_t));
+    uint32_t misses = 0;
+    for (uint32_t i = 0; i < mesh->index_count; ++i)
+    {
+        const uint32_t v = mesh->indices[i];
+        /* stamps hold the miss count just after v was loaded, 0 if it never was */
+        if (stamps[v] == 0 || misses - stamps[v] >= cache_size) {
+            stamps[v] = ++misses;
+        }
+    }
+    free(stamps);
+    return (float)misses / (float)(mesh->index_count / 3);
+}
+
+bool mesh_read(struct mesh* mesh, const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+
+    struct mesh_file_header header;
+    bool loaded = false;
+    if (fread(&header, sizeof(header), 1, file) == 1 && header.magic == MESH_FILE_MAGIC && header.version == MESH_FILE_VERSION &&
+        header.vertex_size == sizeof(struct mesh_vertex) && header.index_count % 3 == 0)
+    {
+        mesh_init(mesh, header.vertex_count, header.index_count);
+        loaded = fread(mesh->vertices, sizeof(struct mesh_vertex), header.vertex_count, file) == header.vertex_count &&
+                 fread(mesh->indices, sizeof(uint32_t), header.index_count, file) == header.index_count;
+        for (uint32_t i = 0; loaded && i < header.index_count; ++i) {
+            loaded = mesh->indices[i] < header.vertex_count;
+        }
+        if (!loaded) {
+            mesh_free(mesh);
+        }
+    }
+
+    fclose(file);
+    return loaded;
+}
+
+static bool write_mesh(FILE* file, void* context)
+{
+    const struct mesh* mesh = context;
+    const struct mesh_file_header header = {
+        .magic = MESH_FILE_MAGIC,
+        .version = MESH_FILE_VERSION,
+        .vertex_size = sizeof(struct mesh_vertex),
+        .vertex_count = mesh->vertex_count,
+        .index_count = mesh->index_count
+    };
+    return fwrite(&header, sizeof(header), 1, file) == 1 &&
+           fwrite(mesh->vertices, sizeof(struct mesh_vertex), mesh->vertex_count, file) == mesh->vertex_count &&
+           fwrite(mesh->indices, sizeof(uint32_t), mesh->index_count, file) == mesh->index_count;
+}
+
+bool mesh_write(const struct mesh* mesh, const char* path)
+{
+    return util_write_file(path, write_mesh, (void*)mesh);
+}
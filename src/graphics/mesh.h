@@ -0,0 +1,36 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include "vertex.h"
+
+/* Post-transform cache size mesh_optimize targets; larger than any real
+ * GPU's FIFO costs little, smaller wastes reuse on big caches */
+#define MESH_VERTEX_CACHE_SIZE 32
+
+/* Indexed triangle list in host memory, ready for buffers_init */
+struct mesh
+{
+    uint32_t vertex_count;
+    uint32_t index_count;
+    struct mesh_vertex* vertices;
+    uint32_t* indices;
+};
+
+void mesh_init(struct mesh* mesh, uint32_t vertex_count, uint32_t index_count);
+void mesh_free(struct mesh* mesh);
+
+/* Reorders triangles for the post-transform vertex cache (Forsyth's linear
+ * speed algorithm), then renumbers vertices in first-use order so fetches
+ * walk the vertex buffer forwards */
+void mesh_optimize(struct mesh* mesh);
+/* Average cache miss ratio: vertices transformed per triangle with a FIFO cache */
+float mesh_acmr(const struct mesh* mesh, uint32_t cache_size);
+
+/* Raw binary dump; read fails on anything written by a different layout */
+bool mesh_read(struct mesh* mesh, const char* path);
+bool mesh_write(const struct mesh* mesh, const char* path);
+
+#endif
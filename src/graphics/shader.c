@@ -4,41 +4,66 @@
 #include <stdlib.h>
 #include <string.h>
 #include <inttypes.h>
+#include <stdbool.h>
 
 #include <GL/glew.h>
 
-static void shader_parse(const char* filepath, char** shaders);
-static uint32_t compile_shader(const char* source, int shader_type);
-static int get_uniform_location(struct shader* shader, const char* name);
+#include "shader_parser.h"
+#include "shader_cache.h"
+#include "../util/util.h"
+
+static const GLenum stage_types[SHADER_STAGE_COUNT] = {
+    GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_GEOMETRY_SHADER, GL_COMPUTE_SHADER
+};
+
+static uint32_t compile_shader(const struct shader_stage_source* source, enum shader_stage stage);
+static void shader_reflect(struct shader* shader);
 
 void shader_init(struct shader* shader, const char* shader_file_path)
 {
-    char* shaders[2];
-    shader_parse(shader_file_path, shaders);
+    struct shader_source source;
+    shader_source_parse(&source, shader_file_path);
 
-    uint32_t vs = compile_shader(shaders[0], GL_VERTEX_SHADER);
-    uint32_t fs = compile_shader(shaders[1], GL_FRAGMENT_SHADER);
+    const uint64_t key = shader_cache_key(&source);
 
     shader->handle = glCreateProgram();
-    glAttachShader(shader->handle, vs);
-    glAttachShader(shader->handle, fs);
-    glLinkProgram(shader->handle);
-    int success;
-    glGetProgramiv(shader->handle, GL_LINK_STATUS, &success);
-    if (!success) {
-        int32_t length;
-        glGetProgramiv(shader->handle, GL_INFO_LOG_LENGTH, &length);
-        char* error_message = calloc(length, sizeof(char));
-        fprintf(stderr, "Failed to link shader program:\n%s\n", error_message);
-        free(error_message);
-        glDeleteProgram(shader->handle);
-        abort();
+    if (!shader_cache_load(shader->handle, key)) {
+        uint32_t stages[SHADER_STAGE_COUNT] = {0};
+        for (uint32_t stage = 0; stage < SHADER_STAGE_COUNT; ++stage) {
+            if (source.stages[stage].count > 0) {
+                stages[stage] = compile_shader(&source.stages[stage], stage);
+                glAttachShader(shader->handle, stages[stage]);
+            }
+        }
+
+        glProgramParameteri(shader->handle, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(shader->handle);
+        int success;
+        glGetProgramiv(shader->handle, GL_LINK_STATUS, &success);
+        if (!success) {
+            int32_t length;
+            glGetProgramiv(shader->handle, GL_INFO_LOG_LENGTH, &length);
+            char* error_message = calloc(length, sizeof(char));
+            glGetProgramInfoLog(shader->handle, length, &length, error_message);
+            fprintf(stderr, "Failed to link shader program '%s':\n%s\n", shader_file_path, error_message);
+            free(error_message);
+            glDeleteProgram(shader->handle);
+            abort();
+        }
+
+        for (uint32_t stage = 0; stage < SHADER_STAGE_COUNT; ++stage) {
+            if (stages[stage]) {
+                glDetachShader(shader->handle, stages[stage]);
+                glDeleteShader(stages[stage]);
+            }
+        }
+
+        shader_cache_store(shader->handle, key);
     }
 
-    glDeleteShader(vs);
-    glDeleteShader(fs);
-    free(shaders[0]);
-    free(shaders[1]);
+    shader_source_free(&source);
+
+    shader_reflect(shader);
 }
 
 void shader_bind(struct shader* shader)
@@ -49,48 +74,172 @@ void shader_bind(struct shader* shader)
 void shader_free(struct shader* shader)
 {
     glDeleteProgram(shader->handle);
+    free(shader->uniforms);
+    shader->uniforms = NULL;
+    shader->uniform_count = 0;
+    shader->uniform_capacity = 0;
+}
+
+static uint32_t hash_name(const char* name)
+{
+    /* FNV-1a */
+    uint32_t hash = 2166136261u;
+    for (; *name; ++name) {
+        hash ^= (uint8_t)*name;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static const struct shader_uniform* shader_find(const struct shader* shader, const char* name, bool block)
+{
+    if (shader->uniform_capacity == 0) {
+        return NULL;
+    }
+
+    const uint32_t hash = hash_name(name);
+    const uint32_t mask = shader->uniform_capacity - 1;
+    for (uint32_t slot = hash & mask;; slot = (slot + 1) & mask)
+    {
+        const struct shader_uniform* uniform = &shader->uniforms[slot];
+        if (uniform->name[0] == '\0') {
+            return NULL;
+        }
+        if (uniform->hash == hash && (uniform->type == GL_UNIFORM_BLOCK) == block && strcmp(uniform->name, name) == 0) {
+            return uniform;
+        }
+    }
+}
+
+int32_t shader_uniform_location(const struct shader* shader, const char* name)
+{
+    /* Inactive or misspelled uniforms get -1, which GL silently ignores */
+    const struct shader_uniform* uniform = shader_find(shader, name, false);
+    return uniform ? uniform->location : -1;
+}
+
+int32_t shader_uniform_block_binding(const struct shader* shader, const char* name)
+{
+    const struct shader_uniform* block = shader_find(shader, name, true);
+    return block ? block->location : -1;
 }
 
 void shader_set_1i(struct shader* shader, const char* name, int value)
 {
-    int location = get_uniform_location(shader, name);
+    shader_set_location_1i(shader_uniform_location(shader, name), value);
+}
+
+void shader_set_location_1i(int32_t location, int value)
+{
     glUniform1i(location, value);
 }
 
+void shader_set_1f(struct shader* shader, const char* name, float value)
+{
+    int location = shader_uniform_location(shader, name);
+    glUniform1f(location, value);
+}
+
 void shader_set_2f(struct shader* shader, const char* name, const struct vec2* value)
 {
-    int location = get_uniform_location(shader, name);
+    int location = shader_uniform_location(shader, name);
     glUniform2f(location, value->x, value->y);
 }
 
 void shader_set_3f(struct shader* shader, const char* name, const struct vec3* value)
 {
-    int location = get_uniform_location(shader, name);
+    int location = shader_uniform_location(shader, name);
     glUniform3f(location, value->x, value->y, value->z);
 }
 
 void shader_set_4f(struct shader* shader, const char* name, const struct vec4* value)
 {
-    int location = get_uniform_location(shader, name);
+    int location = shader_uniform_location(shader, name);
     glUniform4f(location, value->x, value->y, value->z, value->w);
 }
 
 void shader_set_mat4(struct shader* shader, const char* name, const struct mat4* matrix)
 {
-    int location = get_uniform_location(shader, name);
-    glUniformMatrix4fv(location, 1, GL_FALSE, matrix->elements);
+    int location = shader_uniform_location(shader, name);
+    /* mat4 is stored row-major */
+    glUniformMatrix4fv(location, 1, GL_TRUE, matrix->elements);
 }
 
-static int get_uniform_location(struct shader* shader, const char* name)
+static void shader_insert(struct shader* shader, const char* name, int32_t location, uint32_t type)
 {
-    /* TODO: HashTable */
-    return glGetUniformLocation(shader->handle, name);
+    const uint32_t hash = hash_name(name);
+    const uint32_t mask = shader->uniform_capacity - 1;
+    uint32_t slot = hash & mask;
+    while (shader->uniforms[slot].name[0] != '\0') {
+        slot = (slot + 1) & mask;
+    }
+
+    struct shader_uniform* uniform = &shader->uniforms[slot];
+    uniform->hash = hash;
+    uniform->location = location;
+    uniform->type = type;
+    snprintf(uniform->name, sizeof(uniform->name), "%s", name);
+    ++shader->uniform_count;
 }
 
-static uint32_t compile_shader(const char* source, int shader_type)
+static void shader_reflect(struct shader* shader)
 {
-    uint32_t shader = glCreateShader(shader_type);
-    glShaderSource(shader, 1, (const char**) &source, NULL);
+    int32_t active_uniforms = 0;
+    int32_t active_blocks = 0;
+    glGetProgramInterfaceiv(shader->handle, GL_UNIFORM, GL_ACTIVE_RESOURCES, &active_uniforms);
+    glGetProgramInterfaceiv(shader->handle, GL_UNIFORM_BLOCK, GL_ACTIVE_RESOURCES, &active_blocks);
+
+    /* Keep the load factor at or below one half so probes stay short */
+    uint32_t capacity = 8;
+    while (capacity < 2 * (uint32_t)(active_uniforms + active_blocks)) {
+        capacity *= 2;
+    }
+    shader->uniform_count = 0;
+    shader->uniform_capacity = capacity;
+    shader->uniforms = util_allocate_zeroed(capacity * sizeof(struct shader_uniform), "the uniform table");
+
+    char name[SHADER_UNIFORM_NAME_MAX];
+
+    const GLenum uniform_properties[] = {GL_LOCATION, GL_TYPE};
+    for (int32_t i = 0; i < active_uniforms; ++i)
+    {
+        int32_t values[2];
+        glGetProgramResourceiv(shader->handle, GL_UNIFORM, i, 2, uniform_properties, 2, NULL, values);
+        if (values[0] < 0) {
+            /* Members of uniform blocks have no location */
+            continue;
+        }
+
+        glGetProgramResourceName(shader->handle, GL_UNIFORM, i, sizeof(name), NULL, name);
+        /* Arrays are reported as "name[0]"; look them up by their base name */
+        char* bracket = strchr(name, '[');
+        if (bracket) {
+            *bracket = '\0';
+        }
+        shader_insert(shader, name, values[0], (uint32_t)values[1]);
+    }
+
+    const GLenum block_properties[] = {GL_BUFFER_BINDING};
+    for (int32_t i = 0; i < active_blocks; ++i)
+    {
+        glGetProgramResourceName(shader->handle, GL_UNIFORM_BLOCK, i, sizeof(name), NULL, name);
+
+        int32_t binding;
+        if (strcmp(name, SHADER_CAMERA_BLOCK) == 0) {
+            /* Shared blocks land on their fixed binding even without a layout qualifier */
+            binding = SHADER_CAMERA_BINDING;
+            glUniformBlockBinding(shader->handle, i, binding);
+        } else {
+            glGetProgramResourceiv(shader->handle, GL_UNIFORM_BLOCK, i, 1, block_properties, 1, NULL, &binding);
+        }
+        shader_insert(shader, name, binding, GL_UNIFORM_BLOCK);
+    }
+}
+
+static uint32_t compile_shader(const struct shader_stage_source* source, enum shader_stage stage)
+{
+    uint32_t shader = glCreateShader(stage_types[stage]);
+    glShaderSource(shader, (GLsizei)source->count, source->strings, source->lengths);
     glCompileShader(shader);
     int success;
     glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
@@ -99,51 +248,10 @@ static uint32_t compile_shader(const char* source, int shader_type)
         glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
         char* error_message = calloc(length, sizeof(char));
         glGetShaderInfoLog(shader, length, &length, error_message);
-        const char* shader_name = (shader_type == GL_VERTEX_SHADER) ? "vertex" : "fragment";
-        fprintf(stderr, "Failed to compile %s shader:\n%s\n", shader_name, error_message);
+        fprintf(stderr, "Failed to compile %s shader:\n%s\n", shader_stage_name(stage), error_message);
         free(error_message);
         glDeleteShader(shader);
         abort();
     }
     return shader;
 }
-
-static int starts_with(const char* a, const char* b)
-{
-    return strncmp(a, b, strlen(b));
-}
-
-static void shader_parse(const char* filepath, char** shaders)
-{
-    FILE* file = fopen(filepath, "r");
-
-    fseek(file, 0, SEEK_END);
-    long size = ftell(file);
-    fseek(file, 0, SEEK_SET);
-
-    shaders[0] = calloc(size, sizeof(char));
-    shaders[1] = calloc(size, sizeof(char));
-    if (!shaders[0] || !shaders[1]) {
-        abort();
-        return;
-    }
-    int32_t shader_write_index = -1;
-
-    char line[256];
-    while (fgets(line, sizeof(line), file)) 
-    {
-        if (starts_with(line, "#shader vertex") == 0) {
-            shader_write_index = 0;
-        } else if (starts_with(line, "#shader fragment") == 0) {
-            shader_write_index = 1;
-        } else {
-            if (shader_write_index < 0) {
-                fputs("No shader directive found in the shader file!\n", stderr);
-                abort();
-            }
-            strcat(shaders[shader_write_index], line);
-        }
-    }
-
-    fclose(file);
-}
\ No newline at end of file
@@ -8,18 +8,42 @@
 #include "../math/vec4.h"
 #include "../math/mat4.h"
 
+#define SHADER_UNIFORM_NAME_MAX 64
+
+/* Uniform blocks with these names are bound to fixed points in every program */
+#define SHADER_CAMERA_BLOCK "Camera"
+#define SHADER_CAMERA_BINDING 0
+
+/* A uniform, or a uniform block when type is GL_UNIFORM_BLOCK and location holds its binding */
+struct shader_uniform
+{
+    uint32_t hash;
+    int32_t location;
+    uint32_t type;
+    char name[SHADER_UNIFORM_NAME_MAX];
+};
+
 struct shader
 {
     uint32_t handle;
 
-    /* TODO HashTable for uniform locations */
+    /* Open-addressed table of active uniforms, filled when the program links */
+    uint32_t uniform_count;
+    uint32_t uniform_capacity;
+    struct shader_uniform* uniforms;
 };
 
 void shader_init(struct shader* shader, const char* shader_file_path);
 void shader_bind(struct shader* shader);
 void shader_free(struct shader* shader);
 
+int32_t shader_uniform_location(const struct shader* shader, const char* name);
+int32_t shader_uniform_block_binding(const struct shader* shader, const char* name);
+
 void shader_set_1i(struct shader* shader, const char* name, int value);
+/* For uniforms set every frame or draw: look the location up once, outside the loop */
+void shader_set_location_1i(int32_t location, int value);
+void shader_set_1f(struct shader* shader, const char* name, float value);
 void shader_set_2f(struct shader* shader, const char* name, const struct vec2* value);
 void shader_set_3f(struct shader* shader, const char* name, const struct vec3* value);
 void shader_set_4f(struct shader* shader, const char* name, const struct vec4* value);
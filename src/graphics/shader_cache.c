@@ -0,0 +1,172 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "shader_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include <GL/glew.h>
+
+#include "../util/util.h"
+
+#define SHADER_CACHE_MAGIC 0x42505353u /* "SSPB" */
+#define SHADER_CACHE_VERSION 1
+
+struct shader_cache_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t format;
+    uint32_t length;
+};
+
+static struct
+{
+    bool enabled;
+    char directory[256];
+    uint64_t driver_hash;
+} cache;
+
+static uint64_t hash_bytes(uint64_t hash, const void* data, size_t size)
+{
+    /* FNV-1a, 64-bit */
+    const uint8_t* bytes = data;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static uint64_t hash_string(uint64_t hash, const char* string)
+{
+    /* Include the terminator so "ab" + "c" and "a" + "bc" differ */
+    return hash_bytes(hash, string ? string : "", string ? strlen(string) + 1 : 1);
+}
+
+void shader_cache_configure(const char* directory, const char* vendor, const char* renderer, const char* version)
+{
+    cache.enabled = false;
+
+    int32_t formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if (formats <= 0 || !directory || strlen(directory) >= sizeof(cache.directory)) {
+        return;
+    }
+    if (mkdir(directory, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Failed to create shader cache directory '%s'!\n", directory);
+        return;
+    }
+
+    strcpy(cache.directory, directory);
+    cache.driver_hash = 14695981039346656037ull;
+    cache.driver_hash = hash_string(cache.driver_hash, vendor);
+    cache.driver_hash = hash_string(cache.driver_hash, renderer);
+    cache.driver_hash = hash_string(cache.driver_hash, version);
+    cache.enabled = true;
+}
+
+uint64_t shader_cache_key(const struct shader_source* source)
+{
+    uint64_t hash = cache.driver_hash;
+    for (uint32_t stage = 0; stage < SHADER_STAGE_COUNT; ++stage)
+    {
+        const struct shader_stage_source* slices = &source->stages[stage];
+        /* Mark stage boundaries so moving code between stages changes the key */
+        hash = hash_bytes(hash, &stage, sizeof(stage));
+        for (uint32_t i = 0; i < slices->count; ++i) {
+            hash = hash_bytes(hash, slices->strings[i], (size_t)slices->lengths[i]);
+        }
+    }
+    return hash;
+}
+
+static void cache_path(char* path, size_t size, uint64_t key)
+{
+    snprintf(path, size, "%s/%016" PRIx64 ".bin", cache.directory, key);
+}
+
+bool shader_cache_load(uint32_t program, uint64_t key)
+{
+    if (!cache.enabled) {
+        return false;
+    }
+
+    char path[320];
+    cache_path(path, sizeof(path), key);
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+
+    struct shader_cache_header header;
+    void* binary = NULL;
+    bool loaded = false;
+    if (fread(&header, sizeof(header), 1, file) == 1 && header.magic == SHADER_CACHE_MAGIC &&
+        header.version == SHADER_CACHE_VERSION && header.key == key && header.length > 0)
+    {
+        binary = malloc(header.length);
+        if (binary && fread(binary, 1, header.length, file) == header.length) {
+            glProgramBinary(program, header.format, binary, (GLsizei)header.length);
+            int32_t success = 0;
+            glGetProgramiv(program, GL_LINK_STATUS, &success);
+            /* Drivers reject binaries from older builds of themselves; recompile then */
+            loaded = success != 0;
+        }
+    }
+
+    free(binary);
+    fclose(file);
+    return loaded;
+}
+
+struct cache_entry
+{
+    const struct shader_cache_header* header;
+    const void* binary;
+};
+
+static bool write_entry(FILE* file, void* context)
+{
+    const struct cache_entry* entry = context;
+    return fwrite(entry->header, sizeof(*entry->header), 1, file) == 1 &&
+           fwrite(entry->binary, 1, entry->header->length, file) == entry->header->length;
+}
+
+void shader_cache_store(uint32_t program, uint64_t key)
+{
+    if (!cache.enabled) {
+        return;
+    }
+
+    int32_t length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+    void* binary = malloc((size_t)length);
+    if (!binary) {
+        return;
+    }
+
+    struct shader_cache_header header = {
+        .magic = SHADER_CACHE_MAGIC,
+        .version = SHADER_CACHE_VERSION,
+        .key = key
+    };
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary);
+    header.format = format;
+    header.length = (uint32_t)length;
+
+    /* A failed write only costs a compile next run */
+    char path[320];
+    cache_path(path, sizeof(path), key);
+    struct cache_entry entry = {&header, binary};
+    util_write_file(path, write_entry, &entry);
+    free(binary);
+}
@@ -0,0 +1,21 @@
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include "shader_parser.h"
+
+#define SHADER_CACHE_DIRECTORY ".shader_cache"
+
+/*
+ * Linked program binaries on disk, keyed by the program's sources and the
+ * driver that produced them. Until configured every lookup misses.
+ */
+void shader_cache_configure(const char* directory, const char* vendor, const char* renderer, const char* version);
+
+uint64_t shader_cache_key(const struct shader_source* source);
+bool shader_cache_load(uint32_t program, uint64_t key);
+void shader_cache_store(uint32_t program, uint64_t key);
+
+#endif
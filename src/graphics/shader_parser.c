@@ -0,0 +1,259 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "shader_parser.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../util/util.h"
+
+static const char* stage_names[SHADER_STAGE_COUNT] = {"vertex", "fragment", "geometry", "compute"};
+
+const char* shader_stage_name(enum shader_stage stage)
+{
+    return stage < SHADER_STAGE_COUNT ? stage_names[stage] : "unknown";
+}
+
+static void* grow(void* data, uint32_t* capacity, size_t element_size)
+{
+    *capacity = *capacity ? *capacity * 2 : 16;
+    return util_reallocate(data, *capacity * element_size, "shader source");
+}
+
+static void add_piece(struct shader_source* source, const char* data, size_t length, int32_t include, int32_t stage)
+{
+    if (include < 0 && length == 0) {
+        return;
+    }
+    if (source->piece_count == source->piece_capacity) {
+        source->pieces = grow(source->pieces, &source->piece_capacity, sizeof(struct shader_source_piece));
+    }
+    source->pieces[source->piece_count++] = (struct shader_source_piece) {
+        .data = data,
+        .length = (int32_t)length,
+        .include = include,
+        .stage = stage
+    };
+}
+
+static void add_slice(struct shader_stage_source* stage, const char* data, int32_t length)
+{
+    if (stage->count == stage->capacity) {
+        uint32_t capacity = stage->capacity;
+        stage->strings = grow(stage->strings, &capacity, sizeof(const char*));
+        stage->lengths = util_reallocate(stage->lengths, capacity * sizeof(int32_t), "shader source");
+        stage->capacity = capacity;
+    }
+    stage->strings[stage->count] = data;
+    stage->lengths[stage->count] = length;
+    ++stage->count;
+}
+
+static void map_file(struct shader_source_file* file)
+{
+    int fd = open(file->path, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        fprintf(stderr, "Failed to open shader file '%s'!\n", file->path);
+        abort();
+    }
+
+    file->size = (size_t)info.st_size;
+    file->mapping = NULL;
+    if (file->size > 0) {
+        file->mapping = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (file->mapping == MAP_FAILED) {
+            fprintf(stderr, "Failed to map shader file '%s'!\n", file->path);
+            abort();
+        }
+    }
+    close(fd);
+}
+
+static int32_t find_or_add_file(struct shader_source* source, const char* path)
+{
+    for (uint32_t i = 0; i < source->file_count; ++i) {
+        if (strcmp(source->files[i].path, path) == 0) {
+            return (int32_t)i;
+        }
+    }
+    if (source->file_count == SHADER_SOURCE_MAX_FILES) {
+        fputs("Too many shader includes!\n", stderr);
+        abort();
+    }
+
+    struct shader_source_file* file = &source->files[source->file_count];
+    memset(file, 0, sizeof(*file));
+    strcpy(file->path, path);
+    map_file(file);
+    return (int32_t)source->file_count++;
+}
+
+static bool directive(const char** cursor, const char* end, const char* name)
+{
+    const char* at = *cursor;
+    while (at < end && (*at == ' ' || *at == '\t')) {
+        ++at;
+    }
+    const size_t length = strlen(name);
+    if ((size_t)(end - at) < length || memcmp(at, name, length) != 0) {
+        return false;
+    }
+    at += length;
+    if (at < end && *at != ' ' && *at != '\t' && *at != '\r' && *at != '\n') {
+        return false;
+    }
+    *cursor = at;
+    return true;
+}
+
+static int32_t parse_stage(const char* at, const char* end)
+{
+    while (at < end && (*at == ' ' || *at == '\t')) {
+        ++at;
+    }
+    for (int32_t stage = 0; stage < SHADER_STAGE_COUNT; ++stage) {
+        const size_t length = strlen(stage_names[stage]);
+        if ((size_t)(end - at) >= length && memcmp(at, stage_names[stage], length) == 0) {
+            return stage;
+        }
+    }
+    return -1;
+}
+
+static int32_t parse_include(struct shader_source* source, uint32_t index, const char* at, const char* end)
+{
+    const char* open = memchr(at, '"', (size_t)(end - at));
+    const char* close = open ? memchr(open + 1, '"', (size_t)(end - open - 1)) : NULL;
+    if (!close) {
+        fprintf(stderr, "Malformed #include in '%s'!\n", source->files[index].path);
+        abort();
+    }
+
+    /* Resolve relative to the directory of the including file */
+    const char* including = source->files[index].path;
+    const char* slash = strrchr(including, '/');
+    const size_t directory = slash ? (size_t)(slash - including + 1) : 0;
+    const size_t name = (size_t)(close - open - 1);
+    if (directory + name >= SHADER_SOURCE_MAX_PATH) {
+        fputs("Shader include path is too long!\n", stderr);
+        abort();
+    }
+
+    char path[SHADER_SOURCE_MAX_PATH];
+    memcpy(path, including, directory);
+    memcpy(path + directory, open + 1, name);
+    path[directory + name] = '\0';
+    return find_or_add_file(source, path);
+}
+
+static void scan_file(struct shader_source* source, uint32_t index, bool root)
+{
+    const char* begin = source->files[index].mapping;
+    const char* end = begin + source->files[index].size;
+    const char* section = begin;
+    int32_t stage = -1;
+
+    source->files[index].first_piece = source->piece_count;
+
+    for (const char* line = begin; line < end;)
+    {
+        const char* newline = memchr(line, '\n', (size_t)(end - line));
+        const char* next = newline ? newline + 1 : end;
+
+        const char* at = line;
+        if (directive(&at, next, "#shader")) {
+            if (!root) {
+                fprintf(stderr, "#shader directive in included file '%s'!\n", source->files[index].path);
+                abort();
+            }
+            add_piece(source, section, (size_t)(line - section), -1, stage);
+            stage = parse_stage(at, next);
+            if (stage < 0) {
+                fprintf(stderr, "Unknown shader stage in '%s'!\n", source->files[index].path);
+                abort();
+            }
+            section = next;
+        } else if (directive(&at, next, "#include")) {
+            add_piece(source, section, (size_t)(line - section), -1, stage);
+            /* Files are only registered here; they are scanned after this one so pieces stay contiguous */
+            add_piece(source, NULL, 0, parse_include(source, index, at, next), stage);
+            section = next;
+        } else if (root && stage < 0 && line != next) {
+            const char* text = line;
+            while (text < next && (*text == ' ' || *text == '\t' || *text == '\r' || *text == '\n')) {
+                ++text;
+            }
+            if (text < next) {
+                fputs("No shader directive found in the shader file!\n", stderr);
+                abort();
+            }
+        }
+        line = next;
+    }
+    add_piece(source, section, (size_t)(end - section), -1, stage);
+
+    source->files[index].piece_count = source->piece_count - source->files[index].first_piece;
+}
+
+static void emit(struct shader_source* source, struct shader_stage_source* stage, uint32_t index, int32_t only_stage, bool* included)
+{
+    const struct shader_source_file* file = &source->files[index];
+    for (uint32_t i = 0; i < file->piece_count; ++i)
+    {
+        const struct shader_source_piece* piece = &source->pieces[file->first_piece + i];
+        if (only_stage >= 0 && piece->stage != only_stage) {
+            continue;
+        }
+        if (piece->include < 0) {
+            add_slice(stage, piece->data, piece->length);
+        } else if (!included[piece->include]) {
+            included[piece->include] = true;
+            emit(source, stage, (uint32_t)piece->include, -1, included);
+            /* The included file may not end with a newline */
+            add_slice(stage, "\n", 1);
+        }
+    }
+}
+
+void shader_source_parse(struct shader_source* source, const char* path)
+{
+    memset(source, 0, sizeof(*source));
+    if (strlen(path) >= SHADER_SOURCE_MAX_PATH) {
+        fputs("Shader path is too long!\n", stderr);
+        abort();
+    }
+    find_or_add_file(source, path);
+
+    /* file_count grows as includes are discovered */
+    for (uint32_t i = 0; i < source->file_count; ++i) {
+        scan_file(source, i, i == 0);
+    }
+
+    for (int32_t s = 0; s < SHADER_STAGE_COUNT; ++s)
+    {
+        /* The root counts as included so it can never pull itself in */
+        bool included[SHADER_SOURCE_MAX_FILES] = {true};
+        emit(source, &source->stages[s], 0, s, included);
+    }
+}
+
+void shader_source_free(struct shader_source* source)
+{
+    for (uint32_t i = 0; i < source->file_count; ++i) {
+        if (source->files[i].mapping) {
+            munmap(source->files[i].mapping, source->files[i].size);
+        }
+    }
+    for (uint32_t s = 0; s < SHADER_STAGE_COUNT; ++s) {
+        free(source->stages[s].strings);
+        free(source->stages[s].lengths);
+    }
+    free(source->pieces);
+    memset(source, 0, sizeof(*source));
+}
@@ -0,0 +1,68 @@
+#ifndef SHADER_PARSER_H
+#define SHADER_PARSER_H
+
+#include <stdio.h>
+#include <inttypes.h>
+
+#define SHADER_SOURCE_MAX_FILES 32
+#define SHADER_SOURCE_MAX_PATH 256
+
+enum shader_stage
+{
+    SHADER_STAGE_VERTEX = 0,
+    SHADER_STAGE_FRAGMENT,
+    SHADER_STAGE_GEOMETRY,
+    SHADER_STAGE_COMPUTE,
+    SHADER_STAGE_COUNT
+};
+
+/* A file section, or a whole included file when include >= 0 */
+struct shader_source_piece
+{
+    const char* data;
+    int32_t length;
+    int32_t include;
+    int32_t stage;
+};
+
+struct shader_source_file
+{
+    char path[SHADER_SOURCE_MAX_PATH];
+    char* mapping;
+    size_t size;
+    uint32_t first_piece;
+    uint32_t piece_count;
+};
+
+/* Ready for glShaderSource: strings point into the mapped files, nothing is copied */
+struct shader_stage_source
+{
+    uint32_t count;
+    uint32_t capacity;
+    const char** strings;
+    int32_t* lengths;
+};
+
+/*
+ * A .shader file split at "#shader <stage>" lines, with #include "path"
+ * resolved relative to the including file. Each file is mapped and scanned
+ * once; within a stage an included file is inlined at its first #include only.
+ */
+struct shader_source
+{
+    uint32_t file_count;
+    struct shader_source_file files[SHADER_SOURCE_MAX_FILES];
+
+    uint32_t piece_count;
+    uint32_t piece_capacity;
+    struct shader_source_piece* pieces;
+
+    struct shader_stage_source stages[SHADER_STAGE_COUNT];
+};
+
+void shader_source_parse(struct shader_source* source, const char* path);
+void shader_source_free(struct shader_source* source);
+
+const char* shader_stage_name(enum shader_stage stage);
+
+#endif
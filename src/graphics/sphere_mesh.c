@@ -0,0 +1,281 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "sphere_mesh.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <math.h>
+#include <sys/stat.h>
+
+#include "../util/util.h"
+
+/* Bump when the generated geometry changes so stale cache files are ignored */
+#define SPHERE_MESH_VERSION 1
+
+#define SPHERE_NONE UINT32_MAX
+
+/* Positions are built in double so midpoints of midpoints stay on the sphere */
+struct sphere_builder
+{
+    uint32_t count;
+    uint32_t capacity;
+    double (*positions)[3];
+
+    /* Edge midpoints of the current level, keyed by the ordered vertex pair */
+    uint32_t edge_capacity;
+    uint64_t* edge_keys;
+    uint32_t* edge_values;
+};
+
+static uint32_t add_position(struct sphere_builder* builder, double x, double y, double z)
+{
+    const double length = sqrt(x * x + y * y + z * z);
+    double* position = builder->positions[builder->count];
+    position[0] = x / length;
+    position[1] = y / length;
+    position[2] = z / length;
+    return builder->count++;
+}
+
+static uint32_t midpoint(struct sphere_builder* builder, uint32_t a, uint32_t b)
+{
+    const uint64_t key = a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+
+    /* splitmix64 finalizer, then linear probing */
+    uint64_t hash = key + 0x9E3779B97F4A7C15ull;
+    hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+    hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBull;
+    hash ^= hash >> 31;
+
+    const uint32_t mask = builder->edge_capacity - 1;
+    uint32_t slot = (uint32_t)hash & mask;
+    while (builder->edge_values[slot] != SPHERE_NONE)
+    {
+        if (builder->edge_keys[slot] == key) {
+            return builder->edge_values[slot];
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    const double* pa = builder->positions[a];
+    const double* pb = builder->positions[b];
+    builder->edge_keys[slot] = key;
+    builder->edge_values[slot] = add_position(builder, pa[0] + pb[0], pa[1] + pb[1], pa[2] + pb[2]);
+    return builder->edge_values[slot];
+}
+
+static void add_face(uint32_t* indices, const struct sphere_builder* builder, uint32_t a, uint32_t b, uint32_t c)
+{
+    /* Wind counter-clockwise seen from outside, whatever order the table lists */
+    const double* pa = builder->positions[a];
+    const double* pb = builder->positions[b];
+    const double* pc = builder->positions[c];
+    const double ab[3] = {pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2]};
+    const double ac[3] = {pc[0] - pa[0], pc[1] - pa[1], pc[2] - pa[2]};
+    const double normal[3] = {ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2], ab[0] * ac[1] - ab[1] * ac[0]};
+    const bool outward = normal[0] * pa[0] + normal[1] * pa[1] + normal[2] * pa[2] > 0.0;
+
+    indices[0] = a;
+    indices[1] = outward ? b : c;
+    indices[2] = outward ? c : b;
+}
+
+static uint32_t* build_icosahedron(struct sphere_builder* builder)
+{
+    /* Poles on the z axis and two staggered rings of five, so the UV poles fall on vertices */
+    const double ring = atan(0.5);
+    add_position(builder, 0.0, 0.0, 1.0);
+    add_position(builder, 0.0, 0.0, -1.0);
+    for (uint32_t i = 0; i < 5; ++i) {
+        const double longitude = i * 2.0 * M_PI / 5.0;
+        add_position(builder, cos(ring) * cos(longitude), cos(ring) * sin(longitude), sin(ring));
+    }
+    for (uint32_t i = 0; i < 5; ++i) {
+        const double longitude = (i + 0.5) * 2.0 * M_PI / 5.0;
+        add_position(builder, cos(ring) * cos(longitude), cos(ring) * sin(longitude), -sin(ring));
+    }
+
+    uint32_t* indices = util_allocate(20 * 3 * sizeof(uint32_t), "sphere mesh");
+    for (uint32_t i = 0; i < 5; ++i)
+    {
+        const uint32_t upper = 2 + i;
+        const uint32_t upper_next = 2 + (i + 1) % 5;
+        const uint32_t lower = 7 + i;
+        const uint32_t lower_next = 7 + (i + 1) % 5;
+        add_face(&indices[12 * i + 0], builder, 0, upper, upper_next);
+        add_face(&indices[12 * i + 3], builder, upper, lower, upper_next);
+        add_face(&indices[12 * i + 6], builder, upper_next, lower, lower_next);
+        add_face(&indices[12 * i + 9], builder, 1, lower_next, lower);
+    }
+    return indices;
+}
+
+static uint32_t* subdivide(struct sphere_builder* builder, uint32_t* indices, uint32_t triangle_count)
+{
+    /* Each edge is shared by two triangles, so 3/2 * triangles edges; keep the table at most half full */
+    uint32_t capacity = 16;
+    while (capacity < 3 * triangle_count) {
+        capacity *= 2;
+    }
+    builder->edge_capacity = capacity;
+    builder->edge_keys = util_allocate(capacity * sizeof(uint64_t), "sphere mesh");
+    builder->edge_values = util_allocate(capacity * sizeof(uint32_t), "sphere mesh");
+    for (uint32_t i = 0; i < capacity; ++i) {
+        builder->edge_values[i] = SPHERE_NONE;
+    }
+
+    uint32_t* result = util_allocate(4 * 3 * triangle_count * sizeof(uint32_t), "sphere mesh");
+    for (uint32_t t = 0; t < triangle_count; ++t)
+    {
+        const uint32_t a = indices[3 * t];
+        const uint32_t b = indices[3 * t + 1];
+        const uint32_t c = indices[3 * t + 2];
+        const uint32_t ab = midpoint(builder, a, b);
+        const uint32_t bc = midpoint(builder, b, c);
+        const uint32_t ca = midpoint(builder, c, a);
+
+        const uint32_t children[12] = {a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca};
+        memcpy(&result[12 * t], children, sizeof(children));
+    }
+
+    free(builder->edge_keys);
+    free(builder->edge_values);
+    free(indices);
+    return result;
+}
+
+static void set_vertex(struct mesh_vertex* vertex, const double position[3], double u)
+{
+    vertex->pos.x = (float)position[0];
+    vertex->pos.y = (float)position[1];
+    vertex->pos.z = (float)position[2];
+    vertex->normal = vertex->pos;
+
+    /* Tangent points along +u, i.e. east; cross(normal, tangent) then points north along +v */
+    const double longitude = (u - 0.5) * 2.0 * M_PI;
+    vertex->tangent.x = (float)-sin(longitude);
+    vertex->tangent.y = (float)cos(longitude);
+    vertex->tangent.z = 0.0f;
+    vertex->handedness = 1.0f;
+
+    vertex->uv.x = (float)u;
+    vertex->uv.y = (float)(0.5 + asin(position[2] < -1.0 ? -1.0 : position[2] > 1.0 ? 1.0 : position[2]) / M_PI);
+}
+
+void sphere_mesh_generate(struct mesh* mesh, uint32_t subdivisions)
+{
+    /* 10 * 4^n + 2 vertices; more than about 11 subdivisions overflows the indices anyway */
+    if (subdivisions > 10) {
+        subdivisions = 10;
+    }
+
+    struct sphere_builder builder;
+    builder.count = 0;
+    builder.capacity = 10 * (1u << (2 * subdivisions)) + 2;
+    builder.positions = util_allocate(builder.capacity * sizeof(*builder.positions), "sphere mesh");
+
+    uint32_t triangle_count = 20;
+    uint32_t* indices = build_icosahedron(&builder);
+    for (uint32_t level = 0; level < subdivisions; ++level) {
+        indices = subdivide(&builder, indices, triangle_count);
+        triangle_count *= 4;
+    }
+
+    double* us = util_allocate(builder.count * sizeof(double), "sphere mesh");
+    for (uint32_t v = 0; v < builder.count; ++v) {
+        const double* position = builder.positions[v];
+        us[v] = 0.5 + atan2(position[1], position[0]) / (2.0 * M_PI);
+    }
+
+    /* Worst case every seam vertex is duplicated and each pole once per fan triangle */
+    uint32_t capacity = builder.count + builder.count / 2 + 16;
+    mesh_init(mesh, capacity, 3 * triangle_count);
+    mesh->vertex_count = builder.count;
+    for (uint32_t v = 0; v < builder.count; ++v) {
+        set_vertex(&mesh->vertices[v], builder.positions[v], us[v]);
+    }
+
+    uint32_t* seam = util_allocate(builder.count * sizeof(uint32_t), "sphere mesh");
+    for (uint32_t v = 0; v < builder.count; ++v) {
+        seam[v] = SPHERE_NONE;
+    }
+
+    for (uint32_t t = 0; t < triangle_count; ++t)
+    {
+        uint32_t* triangle = &indices[3 * t];
+
+        /* Vertices 0 and 1 are the poles, whose longitude is meaningless */
+        double min_u = 1.0;
+        double max_u = 0.0;
+        for (uint32_t k = 0; k < 3; ++k) {
+            if (triangle[k] > 1) {
+                min_u = fmin(min_u, us[triangle[k]]);
+                max_u = fmax(max_u, us[triangle[k]]);
+            }
+        }
+
+        /* A triangle spanning more than half the texture crosses the seam:
+         * move its west side past u = 1 through a shared duplicate */
+        double sum_u = 0.0;
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            const uint32_t v = triangle[k];
+            if (v <= 1) {
+                continue;
+            }
+            if (max_u - min_u > 0.5 && us[v] < 0.5) {
+                if (seam[v] == SPHERE_NONE) {
+                    seam[v] = mesh->vertex_count++;
+                    set_vertex(&mesh->vertices[seam[v]], builder.positions[v], us[v] + 1.0);
+                }
+                triangle[k] = seam[v];
+            }
+            sum_u += mesh->vertices[triangle[k]].uv.x;
+        }
+
+        /* Each triangle gets its own pole vertex, centred on its other two */
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            const uint32_t v = triangle[k];
+            if (v <= 1) {
+                const uint32_t pole = mesh->vertex_count++;
+                set_vertex(&mesh->vertices[pole], builder.positions[v], 0.5 * sum_u);
+                triangle[k] = pole;
+            }
+        }
+    }
+    memcpy(mesh->indices, indices, 3 * triangle_count * sizeof(uint32_t));
+
+    /* The shared pole vertices are unreferenced now; mesh_optimize drops them */
+    free(seam);
+    free(us);
+    free(indices);
+    free(builder.positions);
+}
+
+void sphere_mesh_load(struct mesh* mesh, uint32_t subdivisions, const char* cache_directory)
+{
+    char path[512];
+    if (cache_directory) {
+        snprintf(path, sizeof(path), "%s/icosphere_%" PRIu32 "_v%d.mesh", cache_directory, subdivisions, SPHERE_MESH_VERSION);
+        if (mesh_read(mesh, path)) {
+            return;
+        }
+    }
+
+    sphere_mesh_generate(mesh, subdivisions);
+    mesh_optimize(mesh);
+
+    if (cache_directory) {
+        if (mkdir(cache_directory, 0755) != 0 && errno != EEXIST) {
+            fprintf(stderr, "Failed to create mesh cache directory '%s'!\n", cache_directory);
+            return;
+        }
+        if (!mesh_write(mesh, path)) {
+            fprintf(stderr, "Failed to write mesh cache '%s'!\n", path);
+        }
+    }
+}
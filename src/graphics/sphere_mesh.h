@@ -0,0 +1,19 @@
+#ifndef SPHERE_MESH_H
+#define SPHERE_MESH_H
+
+#include <inttypes.h>
+
+#include "mesh.h"
+
+#define SPHERE_MESH_CACHE_DIRECTORY ".mesh_cache"
+
+/* Unit icosphere with 20 * 4^subdivisions triangles and equirectangular UVs
+ * (u along longitude from -180 degrees, v from the south pole). Vertices on
+ * the u seam and at the poles are duplicated so no triangle wraps around */
+void sphere_mesh_generate(struct mesh* mesh, uint32_t subdivisions);
+
+/* sphere_mesh_generate followed by mesh_optimize, going through a binary
+ * file in cache_directory when one is given */
+void sphere_mesh_load(struct mesh* mesh, uint32_t subdivisions, const char* cache_directory);
+
+#endif
@@ -1,9 +1,76 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "texture.h"
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include <GL/glew.h>
 
-#define STB_IMAGE_IMPLEMENTATION
-#include "../../vendor/stb_image.h"
+#include "ktx.h"
+
+static void upload_levels(uint32_t texture, const struct texture_image* image, const uint8_t* data)
+{
+    glTextureStorage2D(texture, image->levels, image->internal_format, image->width, image->height);
+    for (uint32_t level = 0; level < image->level_count; ++level)
+    {
+        const uint32_t width = image->width >> level ? image->width >> level : 1;
+        const uint32_t height = image->height >> level ? image->height >> level : 1;
+        glCompressedTextureSubImage2D(texture, level, 0, 0, width, height, image->internal_format,
+                                      (GLsizei)image->level_sizes[level], data + image->level_offsets[level]);
+    }
+}
+
+static void load_ktx(uint32_t texture, const char* texture_path)
+{
+    int fd = open(texture_path, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0 || info.st_size == 0) {
+        fprintf(stderr, "Failed to open the texture '%s'!\n", texture_path);
+        abort();
+    }
+    const size_t size = (size_t)info.st_size;
+    const uint8_t* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        fprintf(stderr, "Failed to map the texture '%s'!\n", texture_path);
+        abort();
+    }
+
+    struct texture_image image;
+    if (!texture_image_parse_ktx(&image, mapping, size)) {
+        fprintf(stderr, "Unsupported KTX texture '%s'!\n", texture_path);
+        abort();
+    }
+    /* Upload straight from the mapping; the pages are read once and dropped */
+    upload_levels(texture, &image, mapping);
+
+    munmap((void*)mapping, size);
+}
+
+static void load_image(uint32_t texture, const char* texture_path)
+{
+    struct texture_image image;
+    if (!texture_image_load(&image, texture_path)) {
+        fputs("Failed to load the texture!\n", stderr);
+        abort();
+    }
+
+    glTextureStorage2D(texture, image.levels, image.internal_format, image.width, image.height);
+    /* Rows of 1 and 3 channel images are not 4-byte aligned in general */
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTextureSubImage2D(texture, 0, 0, 0, image.width, image.height, image.format, GL_UNSIGNED_BYTE, image.data);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glGenerateTextureMipmap(texture);
+
+    texture_image_free(&image);
+}
 
 texture_t texture_init(const char* texture_path)
 {
@@ -11,21 +78,16 @@ texture_t texture_init(const char* texture_path)
     glCreateTextures(GL_TEXTURE_2D, 1, &texture);
     glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    int width, height, channels;
-    uint8_t* data = stbi_load(texture_path, &width, &height, &channels, 0);
-    if (data) {
-        glTextureStorage2D(texture, 1, GL_RGB8, width, height);
-        glTextureSubImage2D(texture, 0, 0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, data);
-        glGenerateTextureMipmap(texture);
+    /* Baked textures come with their mip chain; anything else is decoded here */
+    if (texture_is_ktx(texture_path)) {
+        load_ktx(texture, texture_path);
     } else {
-        fputs("Failed to load the texture!\n", stderr);
-        abort();
+        load_image(texture, texture_path);
     }
 
-    stbi_image_free(data);
     return texture;
 }
 
@@ -37,4 +99,4 @@ void texture_free(texture_t texture)
 void texture_bind(texture_t texture, uint32_t slot)
 {
     glBindTextureUnit(slot, texture);
-}
\ No newline at end of file
+}
@@ -1,12 +1,39 @@
 #ifndef TEXTURE_H
 #define TEXTURE_H
 
+#include <stdio.h>
 #include <inttypes.h>
+#include <stdbool.h>
 
 typedef uint32_t texture_t;
 
+#define TEXTURE_MAX_LEVELS 16
+
+/* A decoded image in CPU memory; loading one makes no GL calls */
+struct texture_image
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t levels;
+    uint32_t level_count;
+    uint32_t internal_format;
+    uint32_t format;
+    bool compressed;
+
+    uint8_t* data;
+    size_t level_offsets[TEXTURE_MAX_LEVELS];
+    size_t level_sizes[TEXTURE_MAX_LEVELS];
+};
+
 texture_t texture_init(const char* texture_path);
 void texture_free(texture_t texture);
 void texture_bind(texture_t texture, uint32_t slot);
 
-#endif
\ No newline at end of file
+bool texture_image_load(struct texture_image* image, const char* texture_path);
+bool texture_image_parse_ktx(struct texture_image* image, const uint8_t* data, size_t size);
+void texture_image_free(struct texture_image* image);
+
+uint32_t texture_mip_levels(uint32_t width, uint32_t height);
+bool texture_is_ktx(const char* path);
+
+#endif
@@ -0,0 +1,132 @@
+#include "texture.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ktx.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../../vendor/stb_image.h"
+
+/* Decoding makes no GL calls, so the GL enums are spelled out */
+static const uint32_t internal_formats[] = {0x8229 /* GL_R8 */, 0x822B /* GL_RG8 */, 0x8051 /* GL_RGB8 */, 0x8058 /* GL_RGBA8 */};
+static const uint32_t formats[] = {0x1903 /* GL_RED */, 0x8227 /* GL_RG */, 0x1907 /* GL_RGB */, 0x1908 /* GL_RGBA */};
+
+uint32_t texture_mip_levels(uint32_t width, uint32_t height)
+{
+    uint32_t levels = 1;
+    for (uint32_t size = width > height ? width : height; size > 1; size /= 2) {
+        ++levels;
+    }
+    return levels;
+}
+
+static bool has_extension(const char* path, const char* extension)
+{
+    const size_t length = strlen(path);
+    const size_t extension_length = strlen(extension);
+    return length >= extension_length && strcmp(path + length - extension_length, extension) == 0;
+}
+
+bool texture_is_ktx(const char* path)
+{
+    return has_extension(path, ".ktx");
+}
+
+bool texture_image_parse_ktx(struct texture_image* image, const uint8_t* data, size_t size)
+{
+    if (size < sizeof(struct ktx_header)) {
+        return false;
+    }
+
+    /* Only what texconv bakes: a 2D BC1 image with its whole mip chain */
+    struct ktx_header header;
+    memcpy(&header, data, sizeof(header));
+    const uint8_t identifier[12] = KTX_IDENTIFIER;
+    if (memcmp(header.identifier, identifier, sizeof(identifier)) != 0 || header.endianness != KTX_ENDIANNESS ||
+        header.gl_type != 0 || header.gl_internal_format != KTX_FORMAT_BC1 || header.pixel_width == 0 ||
+        header.pixel_height == 0 || header.pixel_depth > 1 || header.faces != 1 || header.array_elements > 1 ||
+        header.mip_levels != texture_mip_levels(header.pixel_width, header.pixel_height) ||
+        header.mip_levels > TEXTURE_MAX_LEVELS || header.key_value_bytes > size - sizeof(header))
+    {
+        return false;
+    }
+
+    image->width = header.pixel_width;
+    image->height = header.pixel_height;
+    image->levels = header.mip_levels;
+    image->level_count = 0;
+    image->internal_format = header.gl_internal_format;
+    image->format = 0;
+    image->compressed = true;
+
+    size_t offset = sizeof(header) + header.key_value_bytes;
+    for (uint32_t level = 0; level < image->levels; ++level)
+    {
+        uint32_t image_size;
+        if (size - offset < sizeof(image_size)) {
+            return false;
+        }
+        memcpy(&image_size, data + offset, sizeof(image_size));
+        offset += sizeof(image_size);
+
+        const uint32_t width = image->width >> level ? image->width >> level : 1;
+        const uint32_t height = image->height >> level ? image->height >> level : 1;
+        if (image_size != ktx_bc1_size(width, height) || size - offset < image_size) {
+            return false;
+        }
+        image->level_offsets[level] = offset;
+        image->level_sizes[level] = image_size;
+        /* BC1 levels are multiples of 8 bytes, so KTX's 4 byte level padding is always empty */
+        offset += image_size;
+    }
+    image->level_count = image->levels;
+    return true;
+}
+
+bool texture_image_load(struct texture_image* image, const char* texture_path)
+{
+    memset(image, 0, sizeof(*image));
+
+    if (texture_is_ktx(texture_path)) {
+        /* Read rather than map: the point is to take the I/O off the calling thread */
+        FILE* file = fopen(texture_path, "rb");
+        if (!file) {
+            return false;
+        }
+        fseek(file, 0, SEEK_END);
+        const long size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        image->data = size > 0 ? malloc((size_t)size) : NULL;
+        const bool read = image->data && fread(image->data, 1, (size_t)size, file) == (size_t)size;
+        fclose(file);
+        if (!read || !texture_image_parse_ktx(image, image->data, (size_t)size)) {
+            texture_image_free(image);
+            return false;
+        }
+        return true;
+    }
+
+    int width, height, channels;
+    image->data = stbi_load(texture_path, &width, &height, &channels, 0);
+    if (!image->data) {
+        return false;
+    }
+    image->width = (uint32_t)width;
+    image->height = (uint32_t)height;
+    image->levels = texture_mip_levels(image->width, image->height);
+    image->level_count = 1;
+    image->internal_format = internal_formats[channels - 1];
+    image->format = formats[channels - 1];
+    image->compressed = false;
+    image->level_offsets[0] = 0;
+    image->level_sizes[0] = (size_t)width * height * channels;
+    return true;
+}
+
+void texture_image_free(struct texture_image* image)
+{
+    /* stb_image allocates with malloc too */
+    free(image->data);
+    image->data = NULL;
+}
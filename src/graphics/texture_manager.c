@@ -0,0 +1,245 @@
+#include "texture_manager.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <GL/glew.h>
+
+#include "../util/util.h"
+
+static void* worker_main(void* argument)
+{
+    struct texture_manager* manager = argument;
+
+    pthread_mutex_lock(&manager->mutex);
+    while (true)
+    {
+        while (!manager->shutdown && manager->next_decode == manager->count) {
+            pthread_cond_wait(&manager->wake, &manager->mutex);
+        }
+        if (manager->shutdown) {
+            break;
+        }
+
+        /* Requests are allocated individually, so the pointer stays valid while the array grows */
+        struct texture_request* request = manager->requests[manager->next_decode++];
+        request->state = TEXTURE_STATE_DECODING;
+        pthread_mutex_unlock(&manager->mutex);
+
+        struct texture_image image;
+        bool loaded = texture_image_load(&image, request->path);
+        /* Mipmaps cannot be generated into compressed storage, so a baked
+         * image must bring its whole chain */
+        if (loaded && image.compressed && image.level_count < image.levels) {
+            texture_image_free(&image);
+            loaded = false;
+        }
+        if (!loaded) {
+            fprintf(stderr, "Failed to load the texture '%s'!\n", request->path);
+        }
+
+        pthread_mutex_lock(&manager->mutex);
+        request->image = image;
+        request->state = loaded ? TEXTURE_STATE_DECODED : TEXTURE_STATE_FAILED;
+    }
+    pthread_mutex_unlock(&manager->mutex);
+    return NULL;
+}
+
+void texture_manager_init(struct texture_manager* manager, uint32_t worker_count, size_t upload_budget)
+{
+    memset(manager, 0, sizeof(*manager));
+
+    /* A single row of the widest supported texture must fit in one frame's budget */
+    manager->upload_budget = upload_budget > TEXTURE_MANAGER_MIN_BUDGET ? upload_budget : TEXTURE_MANAGER_MIN_BUDGET;
+    stream_buffer_init(&manager->staging, manager->upload_budget);
+
+    const uint8_t grey[4] = {128, 128, 128, 255};
+    glCreateTextures(GL_TEXTURE_2D, 1, &manager->placeholder);
+    glTextureStorage2D(manager->placeholder, 1, GL_RGBA8, 1, 1);
+    glTextureSubImage2D(manager->placeholder, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+
+    pthread_mutex_init(&manager->mutex, NULL);
+    pthread_cond_init(&manager->wake, NULL);
+
+    manager->worker_count = worker_count > 0 ? worker_count : 1;
+    manager->workers = util_allocate(manager->worker_count * sizeof(pthread_t), "texture workers");
+    for (uint32_t i = 0; i < manager->worker_count; ++i) {
+        if (pthread_create(&manager->workers[i], NULL, worker_main, manager) != 0) {
+            fputs("Failed to start a texture worker!\n", stderr);
+            abort();
+        }
+    }
+}
+
+void texture_manager_free(struct texture_manager* manager)
+{
+    pthread_mutex_lock(&manager->mutex);
+    manager->shutdown = true;
+    pthread_cond_broadcast(&manager->wake);
+    pthread_mutex_unlock(&manager->mutex);
+    for (uint32_t i = 0; i < manager->worker_count; ++i) {
+        pthread_join(manager->workers[i], NULL);
+    }
+    free(manager->workers);
+
+    for (uint32_t i = 0; i < manager->count; ++i) {
+        texture_image_free(&manager->requests[i]->image);
+        texture_free(manager->requests[i]->texture);
+        free(manager->requests[i]);
+    }
+    free(manager->requests);
+
+    texture_free(manager->placeholder);
+    stream_buffer_free(&manager->staging);
+    pthread_mutex_destroy(&manager->mutex);
+    pthread_cond_destroy(&manager->wake);
+}
+
+uint32_t texture_manager_load(struct texture_manager* manager, const char* texture_path)
+{
+    if (strlen(texture_path) >= TEXTURE_MANAGER_PATH_MAX) {
+        fputs("Failed to queue the texture!\n", stderr);
+        abort();
+    }
+    struct texture_request* request = util_allocate_zeroed(sizeof(struct texture_request), "a texture request");
+    strcpy(request->path, texture_path);
+    request->state = TEXTURE_STATE_QUEUED;
+
+    /* The texture object exists now; its storage is allocated once the image is decoded */
+    glCreateTextures(GL_TEXTURE_2D, 1, &request->texture);
+    glTextureParameteri(request->texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTextureParameteri(request->texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTextureParameteri(request->texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTextureParameteri(request->texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    pthread_mutex_lock(&manager->mutex);
+    if (manager->count == manager->capacity) {
+        manager->capacity = manager->capacity ? manager->capacity * 2 : 16;
+        manager->requests = util_reallocate(manager->requests, manager->capacity * sizeof(struct texture_request*), "the texture queue");
+    }
+    const uint32_t id = manager->count++;
+    manager->requests[id] = request;
+    pthread_cond_signal(&manager->wake);
+    pthread_mutex_unlock(&manager->mutex);
+
+    return id;
+}
+
+static uint32_t level_dimension(uint32_t size, uint32_t level)
+{
+    return size >> level ? size >> level : 1;
+}
+
+/* Copies as many rows of the request as fit into the staging region; returns bytes used */
+static size_t upload_rows(struct texture_manager* manager, struct texture_request* request, uint8_t* region, size_t used)
+{
+    const struct texture_image* image = &request->image;
+    const uint32_t width = level_dimension(image->width, request->level);
+    const uint32_t height = level_dimension(image->height, request->level);
+    const uint32_t row_height = image->compressed ? 4 : 1;
+    const uint32_t rows = (height + row_height - 1) / row_height;
+    const size_t row_bytes = image->level_sizes[request->level] / rows;
+
+    if (row_bytes > manager->upload_budget) {
+        fprintf(stderr, "Texture '%s' is too wide to stream!\n", request->path);
+        abort();
+    }
+    uint32_t count = (uint32_t)((manager->upload_budget - used) / row_bytes);
+    count = count < rows - request->row ? count : rows - request->row;
+    if (count == 0) {
+        return 0;
+    }
+
+    const size_t bytes = count * row_bytes;
+    memcpy(region + used, image->data + image->level_offsets[request->level] + request->row * row_bytes, bytes);
+
+    /* With a pixel unpack buffer bound the data pointer is an offset into it */
+    const void* offset = (const void*)(uintptr_t)(stream_buffer_offset(&manager->staging) + used);
+    const uint32_t y = request->row * row_height;
+    const uint32_t rows_height = count * row_height < height - y ? count * row_height : height - y;
+    if (image->compressed) {
+        glCompressedTextureSubImage2D(request->texture, request->level, 0, y, width, rows_height, image->internal_format,
+                                      (GLsizei)bytes, offset);
+    } else {
+        glTextureSubImage2D(request->texture, request->level, 0, y, width, rows_height, image->format, GL_UNSIGNED_BYTE, offset);
+    }
+
+    request->row += count;
+    if (request->row == rows) {
+        request->row = 0;
+        ++request->level;
+    }
+    return bytes;
+}
+
+void texture_manager_update(struct texture_manager* manager)
+{
+    size_t used = 0;
+    uint8_t* region = NULL;
+
+    while (used < manager->upload_budget)
+    {
+        pthread_mutex_lock(&manager->mutex);
+        /* Uploads go in request order; a texture still decoding holds back the ones after it */
+        while (manager->next_upload < manager->count && manager->requests[manager->next_upload]->state == TEXTURE_STATE_FAILED) {
+            ++manager->next_upload;
+        }
+        struct texture_request* request = NULL;
+        if (manager->next_upload < manager->count && manager->requests[manager->next_upload]->state == TEXTURE_STATE_DECODED) {
+            request = manager->requests[manager->next_upload];
+        }
+        pthread_mutex_unlock(&manager->mutex);
+        if (!request) {
+            break;
+        }
+
+        if (!region) {
+            region = stream_buffer_begin(&manager->staging);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, manager->staging.handle);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        }
+
+        const struct texture_image* image = &request->image;
+        if (!request->allocated) {
+            glTextureStorage2D(request->texture, image->levels, image->internal_format, image->width, image->height);
+            request->allocated = true;
+        }
+
+        const size_t bytes = upload_rows(manager, request, region, used);
+        if (bytes == 0) {
+            break;
+        }
+        used += bytes;
+
+        if (request->level == image->level_count) {
+            if (!image->compressed && image->level_count < image->levels) {
+                glGenerateTextureMipmap(request->texture);
+            }
+            texture_image_free(&request->image);
+            request->resident = true;
+            pthread_mutex_lock(&manager->mutex);
+            request->state = TEXTURE_STATE_RESIDENT;
+            pthread_mutex_unlock(&manager->mutex);
+            ++manager->next_upload;
+        }
+    }
+
+    if (region) {
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        stream_buffer_end(&manager->staging);
+        manager->uploaded_bytes += used;
+    }
+}
+
+texture_t texture_manager_get(const struct texture_manager* manager, uint32_t id)
+{
+    return texture_manager_resident(manager, id) ? manager->requests[id]->texture : manager->placeholder;
+}
+
+bool texture_manager_resident(const struct texture_manager* manager, uint32_t id)
+{
+    /* resident is only touched by the render thread, so no lock is needed here */
+    return id < manager->count && manager->requests[id]->resident;
+}
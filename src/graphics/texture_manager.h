@@ -0,0 +1,72 @@
+#ifndef TEXTURE_MANAGER_H
+#define TEXTURE_MANAGER_H
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "texture.h"
+#include "buffers.h"
+
+#define TEXTURE_MANAGER_PATH_MAX 256
+#define TEXTURE_MANAGER_MIN_BUDGET (1u << 20)
+
+enum texture_state
+{
+    TEXTURE_STATE_QUEUED = 0,
+    TEXTURE_STATE_DECODING,
+    TEXTURE_STATE_DECODED,
+    TEXTURE_STATE_RESIDENT,
+    TEXTURE_STATE_FAILED
+};
+
+struct texture_request
+{
+    char path[TEXTURE_MANAGER_PATH_MAX];
+    texture_t texture;
+    enum texture_state state;
+    struct texture_image image;
+
+    /* Upload progress, in rows (block rows when compressed) of the current level */
+    bool allocated;
+    bool resident;
+    uint32_t level;
+    uint32_t row;
+};
+
+/*
+ * Textures are decoded on worker threads and uploaded by the render thread
+ * through a fenced PBO ring, at most upload_budget bytes per frame. Until a
+ * texture is complete, texture_manager_get hands out a grey placeholder.
+ */
+struct texture_manager
+{
+    texture_t placeholder;
+
+    uint32_t worker_count;
+    pthread_t* workers;
+    pthread_mutex_t mutex;
+    pthread_cond_t wake;
+    bool shutdown;
+
+    uint32_t count;
+    uint32_t capacity;
+    struct texture_request** requests;
+    uint32_t next_decode;
+    uint32_t next_upload;
+
+    size_t upload_budget;
+    struct stream_buffer staging;
+    uint64_t uploaded_bytes;
+};
+
+void texture_manager_init(struct texture_manager* manager, uint32_t worker_count, size_t upload_budget);
+void texture_manager_free(struct texture_manager* manager);
+
+uint32_t texture_manager_load(struct texture_manager* manager, const char* texture_path);
+void texture_manager_update(struct texture_manager* manager);
+texture_t texture_manager_get(const struct texture_manager* manager, uint32_t id);
+bool texture_manager_resident(const struct texture_manager* manager, uint32_t id);
+
+#endif
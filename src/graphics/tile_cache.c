@@ -0,0 +1,507 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tile_cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <GL/glew.h>
+
+#include "ktx.h"
+#include "../util/util.h"
+
+#define TILE_NONE UINT32_MAX
+
+static uint64_t tile_key(uint32_t source, uint32_t level, uint32_t x, uint32_t y)
+{
+    return ((uint64_t)source << 56) | ((uint64_t)level << 48) | ((uint64_t)y << 24) | x;
+}
+
+static uint32_t hash_key(uint64_t key)
+{
+    /* splitmix64 finaliser */
+    key ^= key >> 30;
+    key *= 0xBF58476D1CE4E5B9ull;
+    key ^= key >> 27;
+    key *= 0x94D049BB133111EBull;
+    key ^= key >> 31;
+    return (uint32_t)key;
+}
+
+static void lru_unlink(struct tile_cache* cache, uint32_t slot)
+{
+    struct tile_slot* s = &cache->slots[slot];
+    if (s->prev != TILE_NONE) {
+        cache->slots[s->prev].next = s->next;
+    } else {
+        cache->lru_head = s->next;
+    }
+    if (s->next != TILE_NONE) {
+        cache->slots[s->next].prev = s->prev;
+    } else {
+        cache->lru_tail = s->prev;
+    }
+    s->prev = TILE_NONE;
+    s->next = TILE_NONE;
+}
+
+static void lru_push_front(struct tile_cache* cache, uint32_t slot)
+{
+    struct tile_slot* s = &cache->slots[slot];
+    s->prev = TILE_NONE;
+    s->next = cache->lru_head;
+    if (cache->lru_head != TILE_NONE) {
+        cache->slots[cache->lru_head].prev = slot;
+    } else {
+        cache->lru_tail = slot;
+    }
+    cache->lru_head = slot;
+}
+
+static uint32_t table_find(const struct tile_cache* cache, uint64_t key)
+{
+    for (uint32_t i = hash_key(key) & cache->table_mask;; i = (i + 1) & cache->table_mask)
+    {
+        const uint32_t entry = cache->table[i];
+        if (entry == 0) {
+            return TILE_NONE;
+        }
+        if (cache->slots[entry - 1].key == key) {
+            return entry - 1;
+        }
+    }
+}
+
+static void table_insert(struct tile_cache* cache, uint64_t key, uint32_t slot)
+{
+    uint32_t i = hash_key(key) & cache->table_mask;
+    while (cache->table[i] != 0) {
+        i = (i + 1) & cache->table_mask;
+    }
+    cache->table[i] = slot + 1;
+}
+
+static void table_remove(struct tile_cache* cache, uint64_t key)
+{
+    uint32_t i = hash_key(key) & cache->table_mask;
+    while (cache->slots[cache->table[i] - 1].key != key) {
+        i = (i + 1) & cache->table_mask;
+    }
+    cache->table[i] = 0;
+
+    /* Backward-shift deletion keeps probe chains intact without tombstones */
+    for (uint32_t j = (i + 1) & cache->table_mask; cache->table[j] != 0; j = (j + 1) & cache->table_mask)
+    {
+        const uint32_t home = hash_key(cache->slots[cache->table[j] - 1].key) & cache->table_mask;
+        const bool movable = (i <= j) ? (home <= i || home > j) : (home <= i && home > j);
+        if (movable) {
+            cache->table[i] = cache->table[j];
+            cache->table[j] = 0;
+            i = j;
+        }
+    }
+}
+
+static const uint8_t* tile_data(const struct tile_cache* cache, uint32_t source, uint32_t level, uint32_t x, uint32_t y)
+{
+    const uint64_t index = ((1ull << (2 * level)) - 1) / 3 + (uint64_t)y * (1u << level) + x;
+    return cache->sources[source].mapping + sizeof(struct tiles_header) + index * cache->tile_bytes;
+}
+
+/* Takes the least recently used slot for a tile and uploads it from memory */
+static uint32_t tile_cache_place(struct tile_cache* cache, uint64_t key, const uint8_t* data)
+{
+    const uint32_t slot = cache->lru_tail;
+    if (slot == TILE_NONE || cache->slots[slot].last_used == cache->frame) {
+        /* Everything resident was asked for this frame; keep it */
+        return TILE_NONE;
+    }
+    struct tile_slot* s = &cache->slots[slot];
+
+    if (s->occupied) {
+        table_remove(cache, s->key);
+        ++cache->evictions;
+        --cache->resident;
+    }
+
+    glCompressedTextureSubImage3D(cache->atlas, 0, 0, 0, slot, cache->tile_size, cache->tile_size, 1, cache->format,
+                                  cache->tile_bytes, data);
+
+    /* A fresh tile is not the next one out, even before anything asks for it */
+    s->key = key;
+    s->occupied = true;
+    s->last_used = cache->frame;
+    lru_unlink(cache, slot);
+    lru_push_front(cache, slot);
+    table_insert(cache, s->key, slot);
+    ++cache->resident;
+    ++cache->uploads;
+    ++cache->uploaded;
+    return slot;
+}
+
+static struct tile_fetch* next_queued(struct tile_cache* cache)
+{
+    for (uint32_t i = 0; i < TILE_CACHE_FETCHES; ++i) {
+        if (cache->fetches[i].state == TILE_FETCH_QUEUED) {
+            return &cache->fetches[i];
+        }
+    }
+    return NULL;
+}
+
+static void* reader_main(void* argument)
+{
+    struct tile_cache* cache = argument;
+
+    pthread_mutex_lock(&cache->mutex);
+    while (true)
+    {
+        struct tile_fetch* fetch;
+        while (!cache->shutdown && !(fetch = next_queued(cache))) {
+            pthread_cond_wait(&cache->wake, &cache->mutex);
+        }
+        if (cache->shutdown) {
+            break;
+        }
+        fetch->state = TILE_FETCH_READING;
+        pthread_mutex_unlock(&cache->mutex);
+
+        /* The page faults happen here rather than inside a frame */
+        memcpy(fetch->data, tile_data(cache, fetch->source, fetch->level, fetch->x, fetch->y), cache->tile_bytes);
+
+        pthread_mutex_lock(&cache->mutex);
+        fetch->state = TILE_FETCH_READY;
+    }
+    pthread_mutex_unlock(&cache->mutex);
+    return NULL;
+}
+
+/* Queues a missed tile for the reader unless it is already on its way */
+static void tile_cache_fetch(struct tile_cache* cache, uint64_t key, uint32_t source, uint32_t level, uint32_t x, uint32_t y)
+{
+    pthread_mutex_lock(&cache->mutex);
+    struct tile_fetch* free_fetch = NULL;
+    for (uint32_t i = 0; i < TILE_CACHE_FETCHES; ++i)
+    {
+        struct tile_fetch* fetch = &cache->fetches[i];
+        if (fetch->state == TILE_FETCH_FREE) {
+            free_fetch = free_fetch ? free_fetch : fetch;
+        } else if (fetch->key == key) {
+            free_fetch = NULL;
+            break;
+        }
+    }
+    /* With every fetch busy the tile is asked for again next frame */
+    if (free_fetch) {
+        *free_fetch = (struct tile_fetch){key, source, level, x, y, TILE_FETCH_QUEUED, free_fetch->data};
+        pthread_cond_signal(&cache->wake);
+    }
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+void tile_cache_init(struct tile_cache* cache, uint32_t tile_size, uint32_t slot_count, uint32_t upload_limit)
+{
+    memset(cache, 0, sizeof(*cache));
+    cache->format = KTX_FORMAT_BC1;
+    cache->tile_size = tile_size;
+    cache->tile_bytes = (uint32_t)ktx_bc1_size(tile_size, tile_size);
+    cache->slot_count = slot_count;
+    cache->upload_limit = upload_limit;
+
+    uint32_t capacity = 16;
+    while (capacity < 2 * slot_count) {
+        capacity *= 2;
+    }
+    cache->table_mask = capacity - 1;
+    cache->table = util_allocate_zeroed(capacity * sizeof(uint32_t), "the tile cache");
+    cache->slots = util_allocate_zeroed(slot_count * sizeof(struct tile_slot), "the tile cache");
+
+    /* Every slot starts free, in LRU order, so empty slots are taken before anything is evicted */
+    cache->lru_head = TILE_NONE;
+    cache->lru_tail = TILE_NONE;
+    for (uint32_t i = 0; i < slot_count; ++i) {
+        cache->slots[i].last_used = UINT32_MAX;
+        lru_push_front(cache, i);
+    }
+
+    cache->fetch_data = util_allocate((size_t)TILE_CACHE_FETCHES * cache->tile_bytes, "the tile cache");
+    for (uint32_t i = 0; i < TILE_CACHE_FETCHES; ++i) {
+        cache->fetches[i].data = cache->fetch_data + (size_t)i * cache->tile_bytes;
+    }
+    pthread_mutex_init(&cache->mutex, NULL);
+    pthread_cond_init(&cache->wake, NULL);
+    if (pthread_create(&cache->reader, NULL, reader_main, cache) != 0) {
+        fputs("Failed to start the tile reader!\n", stderr);
+        abort();
+    }
+
+    glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &cache->atlas);
+    glTextureParameteri(cache->atlas, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(cache->atlas, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(cache->atlas, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTextureParameteri(cache->atlas, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureStorage3D(cache->atlas, 1, cache->format, tile_size, tile_size, slot_count);
+}
+
+void tile_cache_free(struct tile_cache* cache)
+{
+    pthread_mutex_lock(&cache->mutex);
+    cache->shutdown = true;
+    pthread_cond_signal(&cache->wake);
+    pthread_mutex_unlock(&cache->mutex);
+    pthread_join(cache->reader, NULL);
+    pthread_mutex_destroy(&cache->mutex);
+    pthread_cond_destroy(&cache->wake);
+    free(cache->fetch_data);
+
+    for (uint32_t i = 0; i < cache->source_count; ++i) {
+        munmap(cache->sources[i].mapping, cache->sources[i].size);
+    }
+    texture_free(cache->atlas);
+    free(cache->table);
+    free(cache->slots);
+    memset(cache, 0, sizeof(*cache));
+}
+
+int32_t tile_cache_open(struct tile_cache* cache, const char* path)
+{
+    if (cache->source_count == TILE_CACHE_MAX_SOURCES || cache->pinned == cache->slot_count) {
+        fputs("Too many tiled textures for the tile cache!\n", stderr);
+        return -1;
+    }
+
+    int fd = open(path, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(struct tiles_header)) {
+        fprintf(stderr, "Failed to open the tiled texture '%s'!\n", path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+
+    struct tile_source* file = &cache->sources[cache->source_count];
+    file->size = (size_t)info.st_size;
+    file->mapping = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (file->mapping == MAP_FAILED) {
+        fprintf(stderr, "Failed to map the tiled texture '%s'!\n", path);
+        return -1;
+    }
+
+    memcpy(&file->header, file->mapping, sizeof(file->header));
+    const struct tiles_header* header = &file->header;
+    const uint64_t tiles = ((1ull << (2 * header->levels)) - 1) / 3;
+    if (header->magic != TILES_MAGIC || header->version != TILES_VERSION || header->format != cache->format ||
+        header->tile_size != cache->tile_size || header->tile_bytes != cache->tile_bytes || header->levels == 0 ||
+        header->levels > TILES_MAX_LEVELS || file->size < sizeof(*header) + tiles * header->tile_bytes)
+    {
+        fprintf(stderr, "Tiled texture '%s' does not match the tile cache!\n", path);
+        munmap(file->mapping, file->size);
+        return -1;
+    }
+
+    /* Pin the root so every lookup has a fallback. It is read here, once,
+     * rather than through the reader, so a source is usable as soon as it opens */
+    const uint32_t source = cache->source_count;
+    const uint32_t slot = tile_cache_place(cache, tile_key(source, 0, 0, 0), tile_data(cache, source, 0, 0, 0));
+    if (slot == TILE_NONE) {
+        fprintf(stderr, "No free tile slot for the root of '%s'!\n", path);
+        munmap(file->mapping, file->size);
+        return -1;
+    }
+    ++cache->source_count;
+    lru_unlink(cache, slot);
+    cache->slots[slot].pinned = true;
+    ++cache->pinned;
+    return (int32_t)source;
+}
+
+void tile_cache_begin_frame(struct tile_cache* cache)
+{
+    cache->uploads = 0;
+
+    /* The reader never touches a READY fetch, so its data is uploaded outside the lock */
+    struct tile_fetch* ready[TILE_CACHE_FETCHES];
+    uint32_t ready_count = 0;
+    pthread_mutex_lock(&cache->mutex);
+    for (uint32_t i = 0; i < TILE_CACHE_FETCHES; ++i) {
+        if (cache->fetches[i].state == TILE_FETCH_READY) {
+            ready[ready_count++] = &cache->fetches[i];
+        }
+    }
+    pthread_mutex_unlock(&cache->mutex);
+
+    /* Slots used in the frame just finished are kept; what does not fit waits */
+    uint32_t uploaded = 0;
+    while (uploaded < ready_count && cache->uploads < cache->upload_limit &&
+           tile_cache_place(cache, ready[uploaded]->key, ready[uploaded]->data) != TILE_NONE)
+    {
+        ++uploaded;
+    }
+
+    pthread_mutex_lock(&cache->mutex);
+    for (uint32_t i = 0; i < uploaded; ++i) {
+        ready[i]->state = TILE_FETCH_FREE;
+    }
+    pthread_mutex_unlock(&cache->mutex);
+
+    ++cache->frame;
+}
+
+uint32_t tile_cache_level(const struct tile_cache* cache, uint32_t source, float screen_diameter)
+{
+    /* Half the texture wraps the visible hemisphere, so it spans the disc twice over */
+    const float texels = 2.0f * screen_diameter;
+    const uint32_t level = texels > (float)cache->tile_size ? (uint32_t)ceilf(log2f(texels / (float)cache->tile_size)) : 0;
+
+    const uint32_t finest = cache->sources[source].header.levels - 1;
+    return level < finest ? level : finest;
+}
+
+/* Closest resident tile to (level, x, y), itself included, as a lookup into the atlas */
+static uint32_t tile_cache_resolve(const struct tile_cache* cache, uint32_t source, uint32_t level, uint32_t x, uint32_t y,
+                                   struct tile_lookup* lookup)
+{
+    uint32_t found = level;
+    uint32_t slot = table_find(cache, tile_key(source, level, x, y));
+    while (slot == TILE_NONE) {
+        --found;
+        slot = table_find(cache, tile_key(source, found, x >> (level - found), y >> (level - found)));
+    }
+
+    const uint32_t depth = level - found;
+    const uint32_t mask = (1u << depth) - 1;
+    lookup->layer = slot;
+    lookup->level = found;
+    lookup->scale = 1.0f / (float)(1u << depth);
+    lookup->offset_x = (float)(x & mask) * lookup->scale;
+    lookup->offset_y = (float)(y & mask) * lookup->scale;
+    return slot;
+}
+
+bool tile_cache_request(struct tile_cache* cache, uint32_t source, uint32_t level, uint32_t x, uint32_t y, struct tile_lookup* lookup)
+{
+    const bool exact = table_find(cache, tile_key(source, level, x, y)) != TILE_NONE;
+    if (exact) {
+        ++cache->hits;
+    } else {
+        ++cache->misses;
+        tile_cache_fetch(cache, tile_key(source, level, x, y), source, level, x, y);
+    }
+
+    /* Fall back to the closest resident ancestor, sampling the matching part of it */
+    const uint32_t slot = tile_cache_resolve(cache, source, level, x, y, lookup);
+    struct tile_slot* s = &cache->slots[slot];
+    s->last_used = cache->frame;
+    if (!s->pinned) {
+        lru_unlink(cache, slot);
+        lru_push_front(cache, slot);
+    }
+    return exact;
+}
+
+/* The viewer seen from the sphere's centre, in the longitude and latitude of its uv mapping */
+struct sphere_view
+{
+    float longitude;
+    float equatorial;
+    float polar;
+    float horizon;
+};
+
+/* Whether any point of a tile faces the viewer above the horizon. The
+ * largest cosine to the view direction over the tile's longitude and
+ * latitude ranges is found exactly: the longitude term peaks at the viewer's
+ * longitude or an edge, and what remains is a single sinusoid in latitude */
+static bool tile_visible(const struct sphere_view* view, uint32_t level, uint32_t x, uint32_t y)
+{
+    const float pi = (float)M_PI;
+    const float n = (float)(1u << level);
+
+    /* u = 0.5 + longitude / 2pi and v = 0.5 + latitude / pi, as sphere_mesh maps them */
+    const float west = 2.0f * pi * ((float)x / n - 0.5f) - view->longitude;
+    const float east = west + 2.0f * pi / n;
+    const bool facing = ceilf(west / (2.0f * pi)) <= floorf(east / (2.0f * pi));
+    const float along = view->equatorial * (facing ? 1.0f : fmaxf(cosf(west), cosf(east)));
+
+    const float south = pi * ((float)y / n - 0.5f);
+    const float north = south + pi / n;
+    float best = fmaxf(along * cosf(south) + view->polar * sinf(south), along * cosf(north) + view->polar * sinf(north));
+    const float peak = atan2f(view->polar, along);
+    if (peak >= south && peak <= north) {
+        best = hypotf(along, view->polar);
+    }
+    return best > view->horizon;
+}
+
+/* Visible tiles per level down to max_level; children of hidden tiles are hidden too */
+static void count_visible(const struct sphere_view* view, uint32_t level, uint32_t x, uint32_t y, uint32_t max_level, uint32_t* counts)
+{
+    if (!tile_visible(view, level, x, y)) {
+        return;
+    }
+    ++counts[level];
+    if (level < max_level) {
+        for (uint32_t child = 0; child < 4; ++child) {
+            count_visible(view, level + 1, 2 * x + (child & 1), 2 * y + (child >> 1), max_level, counts);
+        }
+    }
+}
+
+uint32_t tile_cache_request_sphere(struct tile_cache* cache, uint32_t source, float screen_diameter, const float view[3], float horizon,
+                                   uint32_t max_level, struct tile_lookup* table)
+{
+    const float equatorial = sqrtf(view[0] * view[0] + view[1] * view[1]);
+    const struct sphere_view sphere = {atan2f(view[1], view[0]), equatorial, view[2], horizon};
+
+    uint32_t level = tile_cache_level(cache, source, screen_diameter);
+    level = level < max_level ? level : max_level;
+
+    /* The finest level whose visible tiles all fit among the unpinned slots;
+     * a sphere with none visible, the viewer inside it, only needs its root */
+    uint32_t counts[TILES_MAX_LEVELS] = {0};
+    count_visible(&sphere, 0, 0, 0, level, counts);
+    while (level > 0 && (counts[level] == 0 || counts[level] > cache->slot_count - cache->pinned)) {
+        --level;
+    }
+
+    /* Hidden tiles are never sampled but still get an entry, from whatever is resident */
+    const uint32_t n = 1u << level;
+    for (uint32_t y = 0; y < n; ++y) {
+        for (uint32_t x = 0; x < n; ++x) {
+            struct tile_lookup* lookup = &table[y * n + x];
+            if (tile_visible(&sphere, level, x, y)) {
+                tile_cache_request(cache, source, level, x, y, lookup);
+            } else {
+                tile_cache_resolve(cache, source, level, x, y, lookup);
+            }
+        }
+    }
+    return level;
+}
+
+double tile_cache_hit_rate(const struct tile_cache* cache)
+{
+    const uint64_t requests = cache->hits + cache->misses;
+    return requests > 0 ? (double)cache->hits / (double)requests : 0.0;
+}
+
+double tile_cache_occupancy(const struct tile_cache* cache)
+{
+    return cache->slot_count > 0 ? (double)cache->resident / (double)cache->slot_count : 0.0;
+}
+
+void tile_cache_report(const struct tile_cache* cache, FILE* stream)
+{
+    fprintf(stream, "Tile cache: %" PRIu32 "/%" PRIu32 " slots resident (%.1f%%, %" PRIu32 " pinned)\n",
+            cache->resident, cache->slot_count, 100.0 * tile_cache_occupancy(cache), cache->pinned);
+    fprintf(stream, "  %" PRIu64 " hits, %" PRIu64 " misses (hit rate %.1f%%), %" PRIu64 " uploads, %" PRIu64 " evictions\n",
+            cache->hits, cache->misses, 100.0 * tile_cache_hit_rate(cache), cache->uploaded, cache->evictions);
+}
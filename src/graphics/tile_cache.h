@@ -0,0 +1,134 @@
+#ifndef TILE_CACHE_H
+#define TILE_CACHE_H
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "texture.h"
+#include "tiles.h"
+
+#define TILE_CACHE_MAX_SOURCES 16
+/* Tiles being read or waiting for upload at once */
+#define TILE_CACHE_FETCHES 64
+
+struct tile_source
+{
+    struct tiles_header header;
+    uint8_t* mapping;
+    size_t size;
+};
+
+struct tile_slot
+{
+    uint64_t key;
+    uint32_t prev;
+    uint32_t next;
+    uint32_t last_used;
+    bool occupied;
+    bool pinned;
+};
+
+enum tile_fetch_state
+{
+    TILE_FETCH_FREE = 0,
+    TILE_FETCH_QUEUED,
+    TILE_FETCH_READING,
+    TILE_FETCH_READY
+};
+
+/* A missed tile on its way from the mapped file to the atlas */
+struct tile_fetch
+{
+    uint64_t key;
+    uint32_t source;
+    uint32_t level;
+    uint32_t x;
+    uint32_t y;
+    enum tile_fetch_state state;
+    uint8_t* data;
+};
+
+/* Where to sample a tile: an atlas layer and the tile's uv rectangle inside it */
+struct tile_lookup
+{
+    uint32_t layer;
+    uint32_t level;
+    float scale;
+    float offset_x;
+    float offset_y;
+};
+
+/*
+ * Fixed-size cache of tiles from tiled texture files, resident as layers of
+ * one compressed texture array. A request that misses queues the tile for a
+ * reader thread, which copies it out of the mapped file so page faults never
+ * land on the render thread; tile_cache_begin_frame uploads what has been
+ * read, at most upload_limit tiles per frame, evicting least recently used.
+ * Until then the request is answered with its nearest resident ancestor; the
+ * root tile of every source is pinned, so there always is one.
+ */
+struct tile_cache
+{
+    texture_t atlas;
+    uint32_t format;
+    uint32_t tile_size;
+    uint32_t tile_bytes;
+
+    uint32_t slot_count;
+    struct tile_slot* slots;
+    uint32_t lru_head;
+    uint32_t lru_tail;
+
+    uint32_t table_mask;
+    uint32_t* table;
+
+    uint32_t source_count;
+    struct tile_source sources[TILE_CACHE_MAX_SOURCES];
+
+    uint32_t frame;
+    uint32_t upload_limit;
+    uint32_t uploads;
+
+    /* Guarded by mutex; the reader owns a fetch only while it is READING */
+    struct tile_fetch fetches[TILE_CACHE_FETCHES];
+    uint8_t* fetch_data;
+    pthread_t reader;
+    pthread_mutex_t mutex;
+    pthread_cond_t wake;
+    bool shutdown;
+
+    uint32_t resident;
+    uint32_t pinned;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t uploaded;
+};
+
+void tile_cache_init(struct tile_cache* cache, uint32_t tile_size, uint32_t slot_count, uint32_t upload_limit);
+void tile_cache_free(struct tile_cache* cache);
+
+/* Maps a tiled texture and uploads its root tile; returns the source index or -1 */
+int32_t tile_cache_open(struct tile_cache* cache, const char* path);
+/* Uploads tiles the reader has finished, then starts a new frame for LRU purposes */
+void tile_cache_begin_frame(struct tile_cache* cache);
+
+/* Level whose tiles match a surface spanning screen_diameter pixels */
+uint32_t tile_cache_level(const struct tile_cache* cache, uint32_t source, float screen_diameter);
+/* True on a hit; a miss queues the tile and looks up its closest resident ancestor */
+bool tile_cache_request(struct tile_cache* cache, uint32_t source, uint32_t level, uint32_t x, uint32_t y, struct tile_lookup* lookup);
+/* Requests the tiles of a sphere that face the viewer, at the finest level up
+ * to max_level whose visible tiles fit the cache, and fills table with all
+ * 4^level lookups, row-major. view is the unit direction from the centre to
+ * the viewer in the sphere's frame, horizon the radius over the distance.
+ * Returns the level */
+uint32_t tile_cache_request_sphere(struct tile_cache* cache, uint32_t source, float screen_diameter, const float view[3], float horizon,
+                                   uint32_t max_level, struct tile_lookup* table);
+
+double tile_cache_hit_rate(const struct tile_cache* cache);
+double tile_cache_occupancy(const struct tile_cache* cache);
+void tile_cache_report(const struct tile_cache* cache, FILE* stream);
+
+#endif
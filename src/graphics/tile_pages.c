@@ -0,0 +1,84 @@
+#include "tile_pages.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <GL/glew.h>
+
+#include "../util/util.h"
+
+static void tile_pages_reserve(struct tile_pages* pages, uint32_t capacity)
+{
+    if (capacity <= pages->capacity) {
+        return;
+    }
+
+    /* GL keeps the old storage alive until draws that use it have finished */
+    if (pages->capacity > 0) {
+        stream_buffer_free(&pages->stream);
+    }
+    pages->capacity = capacity + capacity / 2;
+    stream_buffer_init(&pages->stream, pages->capacity * 4 * sizeof(uint32_t));
+}
+
+void tile_pages_init(struct tile_pages* pages, uint32_t page_budget)
+{
+    memset(pages, 0, sizeof(*pages));
+    pages->page_budget = page_budget;
+    pages->table = util_allocate((1u << (2 * TILE_PAGES_MAX_LEVEL)) * sizeof(struct tile_lookup), "the tile page table");
+    tile_pages_reserve(pages, page_budget + 2);
+}
+
+void tile_pages_free(struct tile_pages* pages)
+{
+    stream_buffer_free(&pages->stream);
+    free(pages->table);
+    memset(pages, 0, sizeof(*pages));
+}
+
+void tile_pages_begin(struct tile_pages* pages, uint32_t instance_count)
+{
+    /* A header and a root page per instance, whatever the budget */
+    tile_pages_reserve(pages, 2 * instance_count + pages->page_budget);
+    pages->instance_count = instance_count;
+    pages->added = 0;
+    pages->count = instance_count;
+    pages->entries = stream_buffer_begin(&pages->stream);
+}
+
+void tile_pages_add(struct tile_pages* pages, struct tile_cache* cache, uint32_t source, float screen_diameter, const float view[3],
+                    float horizon)
+{
+    /* Leave a root page for every instance still to come */
+    const uint32_t room = pages->capacity - pages->count - (pages->instance_count - pages->added - 1);
+    uint32_t max_level = TILE_PAGES_MAX_LEVEL;
+    while (max_level > 0 && (1u << (2 * max_level)) > room) {
+        --max_level;
+    }
+
+    const uint32_t level = tile_cache_request_sphere(cache, source, screen_diameter, view, horizon, max_level, pages->table);
+    const uint32_t header[4] = {pages->count, level, 0, 0};
+    memcpy(pages->entries[pages->added++], header, sizeof(header));
+
+    const uint32_t page_count = 1u << (2 * level);
+    for (uint32_t i = 0; i < page_count; ++i)
+    {
+        const struct tile_lookup* lookup = &pages->table[i];
+        uint32_t* entry = pages->entries[pages->count++];
+        entry[0] = lookup->layer;
+        memcpy(&entry[1], &lookup->scale, sizeof(float));
+        memcpy(&entry[2], &lookup->offset_x, sizeof(float));
+        memcpy(&entry[3], &lookup->offset_y, sizeof(float));
+    }
+}
+
+void tile_pages_bind(const struct tile_pages* pages, uint32_t binding)
+{
+    stream_buffer_bind_range(&pages->stream, GL_SHADER_STORAGE_BUFFER, binding, pages->count * 4 * sizeof(uint32_t));
+}
+
+void tile_pages_end(struct tile_pages* pages)
+{
+    stream_buffer_end(&pages->stream);
+    pages->entries = NULL;
+}
@@ -0,0 +1,47 @@
+#ifndef TILE_PAGES_H
+#define TILE_PAGES_H
+
+#include <inttypes.h>
+
+#include "buffers.h"
+#include "tile_cache.h"
+
+/* Finest level a page table covers: 32 x 32 tiles, 8192px at 256px tiles */
+#define TILE_PAGES_MAX_LEVEL 5
+
+/*
+ * Page tables telling the body shader where each part of a sphere's tiled
+ * texture sits in the tile cache atlas, rebuilt every frame in one stream
+ * buffer read as a std430 uvec4[]. The first entries are one header per
+ * mesh instance, (first page, level, 0, 0); the pages follow, 4^level per
+ * instance, as (atlas layer, scale, offset x, offset y) with the last three
+ * stored as float bits.
+ */
+struct tile_pages
+{
+    struct stream_buffer stream;
+    /* uvec4 entries per region, and those left for pages beyond one per instance */
+    uint32_t capacity;
+    uint32_t page_budget;
+
+    uint32_t instance_count;
+    uint32_t added;
+    uint32_t count;
+    uint32_t (*entries)[4];
+    struct tile_lookup* table;
+};
+
+void tile_pages_init(struct tile_pages* pages, uint32_t page_budget);
+void tile_pages_free(struct tile_pages* pages);
+
+/* Starts the frame's tables for instance_count instances, added in instance order */
+void tile_pages_begin(struct tile_pages* pages, uint32_t instance_count);
+/* Requests the tiles of the next instance's sphere and writes its table;
+ * see tile_cache_request_sphere. Earlier instances get the finer levels
+ * when the budget runs short; every instance has at least its root */
+void tile_pages_add(struct tile_pages* pages, struct tile_cache* cache, uint32_t source, float screen_diameter, const float view[3],
+                    float horizon);
+void tile_pages_bind(const struct tile_pages* pages, uint32_t binding);
+void tile_pages_end(struct tile_pages* pages);
+
+#endif
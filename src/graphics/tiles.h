@@ -0,0 +1,29 @@
+#ifndef TILES_H
+#define TILES_H
+
+#include <inttypes.h>
+
+/*
+ * Tiled texture file as written by texconv --tiles: a quadtree of mip
+ * levels where level L is 2^L x 2^L square tiles covering the whole image,
+ * level 0 being the single coarsest tile. Every tile is tile_bytes of
+ * compressed blocks, stored level by level in row-major order after the
+ * header, so a tile's offset follows from its coordinates alone.
+ */
+#define TILES_MAGIC 0x4C545353u /* "SSTL" */
+#define TILES_VERSION 1
+#define TILES_MAX_LEVELS 16
+
+struct tiles_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t format;
+    uint32_t tile_size;
+    uint32_t tile_bytes;
+    uint32_t levels;
+    uint32_t source_width;
+    uint32_t source_height;
+};
+
+#endif
@@ -0,0 +1,148 @@
+#include "trails.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <GL/glew.h>
+
+#include "../util/util.h"
+
+void trails_init(struct trails* trails, uint32_t body_count, uint32_t length)
+{
+    trails->body_count = body_count > 0 ? body_count : 1;
+    trails->length = length > 2 ? length : 2;
+
+    const size_t points = (size_t)trails->body_count * trails->length;
+    trails->points = buffers_init_persistent(&trails->points_handle, points * 4 * sizeof(float));
+    stream_buffer_init(&trails->heads, trails->body_count * 2 * sizeof(uint32_t));
+    trails->world = util_allocate(points * sizeof(*trails->world), "trails");
+    memset(trails->origin, 0, sizeof(trails->origin));
+
+    trails->newest = util_allocate(trails->body_count * sizeof(uint32_t), "trails");
+    trails->counts = util_allocate(trails->body_count * sizeof(uint32_t), "trails");
+    trails->anchors = util_allocate(trails->body_count * sizeof(*trails->anchors), "trails");
+    trails->directions = util_allocate(trails->body_count * sizeof(*trails->directions), "trails");
+
+    trails->max_turn_cos = cosf(2.0f * (float)M_PI / 180.0f);
+    trails->min_spacing = 1e-6f;
+    trails->max_spacing = 0.25f;
+    trails_clear(trails);
+}
+
+void trails_free(struct trails* trails)
+{
+    buffers_free(1, &trails->points_handle);
+    stream_buffer_free(&trails->heads);
+    free(trails->world);
+    free(trails->newest);
+    free(trails->counts);
+    free(trails->anchors);
+    free(trails->directions);
+    trails->points = NULL;
+    trails->body_count = 0;
+}
+
+void trails_clear(struct trails* trails)
+{
+    memset(trails->newest, 0, trails->body_count * sizeof(uint32_t));
+    memset(trails->counts, 0, trails->body_count * sizeof(uint32_t));
+}
+
+static void write_point(struct trails* trails, size_t index, const double position[3])
+{
+    float* point = trails->points + 4 * index;
+    memcpy(trails->world[index], position, 3 * sizeof(double));
+    point[0] = (float)(position[0] - trails->origin[0]);
+    point[1] = (float)(position[1] - trails->origin[1]);
+    point[2] = (float)(position[2] - trails->origin[2]);
+    point[3] = 1.0f;
+}
+
+static void rebase(struct trails* trails, const double origin[3])
+{
+    memcpy(trails->origin, origin, sizeof(trails->origin));
+    /* Rings fill from slot 0 and only wrap once full, so the first count slots are live */
+    for (uint32_t i = 0; i < trails->body_count; ++i) {
+        const size_t first = (size_t)i * trails->length;
+        for (size_t index = first; index < first + trails->counts[i]; ++index) {
+            write_point(trails, index, trails->world[index]);
+        }
+    }
+}
+
+void trails_update(struct trails* trails, const double* x, const double* y, const double* z, uint32_t count,
+                   const double origin[3])
+{
+    if (count != trails->body_count) {
+        const uint32_t length = trails->length;
+        trails_free(trails);
+        trails_init(trails, count, length);
+    }
+    if (memcmp(origin, trails->origin, sizeof(trails->origin)) != 0) {
+        rebase(trails, origin);
+    }
+
+    const uint32_t length = trails->length;
+    const float min_spacing2 = trails->min_spacing * trails->min_spacing;
+    const float max_spacing2 = trails->max_spacing * trails->max_spacing;
+    uint32_t* heads = stream_buffer_begin(&trails->heads);
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const size_t ring = (size_t)i * length;
+        const double position[3] = {x[i], y[i], z[i]};
+        double* anchor = trails->anchors[i];
+        float* direction = trails->directions[i];
+
+        if (trails->counts[i] == 0) {
+            /* Commit the first point and start the live one on top of it */
+            memcpy(anchor, position, sizeof(position));
+            direction[0] = direction[1] = direction[2] = 0.0f;
+            write_point(trails, ring, position);
+            write_point(trails, ring + 1, position);
+            trails->newest[i] = 1;
+            trails->counts[i] = 2;
+        } else {
+            const float dx = (float)(position[0] - anchor[0]);
+            const float dy = (float)(position[1] - anchor[1]);
+            const float dz = (float)(position[2] - anchor[2]);
+            const float distance2 = dx * dx + dy * dy + dz * dz;
+
+            /* cos(turn) * |d| compared against max_turn_cos * |d| avoids a division per body */
+            const float along = direction[0] * dx + direction[1] * dy + direction[2] * dz;
+            const float distance = sqrtf(distance2);
+            const bool turned = distance2 >= min_spacing2 && along < trails->max_turn_cos * distance;
+
+            if (turned || distance2 >= max_spacing2) {
+                /* The live point becomes permanent; a new live point starts in the next slot.
+                 * The slot it takes is the oldest point, already faded out on screen */
+                memcpy(anchor, position, sizeof(position));
+                direction[0] = dx / distance;
+                direction[1] = dy / distance;
+                direction[2] = dz / distance;
+                trails->newest[i] = (trails->newest[i] + 1) % length;
+                if (trails->counts[i] < length) {
+                    trails->counts[i]++;
+                }
+            }
+            write_point(trails, ring + trails->newest[i], position);
+        }
+
+        heads[2 * i] = trails->newest[i];
+        heads[2 * i + 1] = trails->counts[i];
+    }
+}
+
+void trails_bind(const struct trails* trails, uint32_t points_binding, uint32_t heads_binding)
+{
+    const size_t points = (size_t)trails->body_count * trails->length;
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, points_binding, trails->points_handle, 0, points * 4 * sizeof(float));
+    stream_buffer_bind_range(&trails->heads, GL_SHADER_STORAGE_BUFFER, heads_binding, trails->body_count * 2 * sizeof(uint32_t));
+}
+
+void trails_end(struct trails* trails)
+{
+    stream_buffer_end(&trails->heads);
+}
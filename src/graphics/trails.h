@@ -0,0 +1,57 @@
+#ifndef TRAILS_H
+#define TRAILS_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include "buffers.h"
+
+/*
+ * Orbit trails as one ring of points per body inside a single persistently
+ * mapped buffer. Each frame a body's current position overwrites the newest
+ * slot; the slot is only committed, and the ring advanced, once the body has
+ * turned or travelled far enough, so points are spent on curvature rather than
+ * on frames. Every trail is drawn with one instanced line-strip call.
+ * Points reach the GPU relative to the render origin, subtracted in double
+ * like the bodies' transforms, and are rebased when the origin moves.
+ */
+struct trails
+{
+    /* Points as origin-relative vec4, body-major: body * length + slot */
+    buffer_handle_t points_handle;
+    float* points;
+    /* The same points in world space, kept to rebase them exactly */
+    double (*world)[3];
+    double origin[3];
+    /* (newest slot, point count) per body, rewritten every frame */
+    struct stream_buffer heads;
+
+    uint32_t body_count;
+    uint32_t length;
+
+    uint32_t* newest;
+    uint32_t* counts;
+    /* Last committed position and the unit direction of the segment before it */
+    double (*anchors)[3];
+    float (*directions)[3];
+
+    /* Commit when the path turned more than max_turn since the last point and
+     * moved at least min_spacing, or moved max_spacing in any case (AU) */
+    float max_turn_cos;
+    float min_spacing;
+    float max_spacing;
+};
+
+void trails_init(struct trails* trails, uint32_t body_count, uint32_t length);
+void trails_free(struct trails* trails);
+void trails_clear(struct trails* trails);
+
+/* Appends this frame's positions, relative to the render origin; a change of
+ * body count restarts every trail */
+void trails_update(struct trails* trails, const double* x, const double* y, const double* z, uint32_t count,
+                   const double origin[3]);
+void trails_bind(const struct trails* trails, uint32_t points_binding, uint32_t heads_binding);
+/* Ends the frame for the head ring; call after the draw that reads it */
+void trails_end(struct trails* trails);
+
+#endif
@@ -0,0 +1,22 @@
+#include "uniform_buffer.h"
+
+#include <GL/glew.h>
+
+void uniform_buffer_init(struct uniform_buffer* ubo, size_t size, uint32_t binding)
+{
+    ubo->size = size;
+    ubo->binding = binding;
+    glCreateBuffers(1, &ubo->handle);
+    glNamedBufferData(ubo->handle, size, NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, ubo->handle);
+}
+
+void uniform_buffer_free(struct uniform_buffer* ubo)
+{
+    glDeleteBuffers(1, &ubo->handle);
+}
+
+void uniform_buffer_update(struct uniform_buffer* ubo, const void* data)
+{
+    glNamedBufferSubData(ubo->handle, 0, ubo->size, data);
+}
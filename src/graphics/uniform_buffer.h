@@ -0,0 +1,20 @@
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "buffers.h"
+
+struct uniform_buffer
+{
+    buffer_handle_t handle;
+    size_t size;
+    uint32_t binding;
+};
+
+void uniform_buffer_init(struct uniform_buffer* ubo, size_t size, uint32_t binding);
+void uniform_buffer_free(struct uniform_buffer* ubo);
+void uniform_buffer_update(struct uniform_buffer* ubo, const void* data);
+
+#endif
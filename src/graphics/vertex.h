@@ -10,4 +10,14 @@ struct vertex
     struct vec2 uv;
 };
 
+/* Lit mesh vertex; the bitangent is cross(normal, tangent) * handedness */
+struct mesh_vertex
+{
+    struct vec3 pos;
+    struct vec3 normal;
+    struct vec3 tangent;
+    float handedness;
+    struct vec2 uv;
+};
+
 #endif
\ No newline at end of file
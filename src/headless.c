@@ -0,0 +1,273 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "physics/options.h"
+#include "physics/ephemeris.h"
+#include "physics/simulation.h"
+#include "physics/force_report.h"
+#include "physics/checkpoint.h"
+#include "physics/trajectory.h"
+
+#include "util/thread_pool.h"
+#include "util/timer.h"
+#include "util/util.h"
+
+static void usage(const char* program)
+{
+    fprintf(stderr, "Usage: %s [options]\n", program);
+    simulation_options_usage(stderr);
+    fputs("  --end DAYS            simulated time to run (default 3652.5)\n"
+          "  --steps N             stop after N steps instead\n"
+          "  --progress SECONDS    wall-clock interval between progress lines, 0 to disable\n"
+          "  --energy              report the relative energy error (O(N^2) at start and end)\n"
+          "  --force-report        compare Barnes-Hut against direct summation and exit\n"
+          "  --validate            integrate the --ephemeris bodies too and report their drift from it\n"
+          "  --checkpoint FILE     save the state to FILE, with deltas appended to FILE.delta in between\n"
+          "  --checkpoint-every S  wall-clock seconds between checkpoints (default 300)\n"
+          "  --full-every N        deltas between full checkpoints (default 8)\n"
+          "  --restore FILE        continue from a checkpoint and its deltas\n"
+          "  --trajectory FILE     record every body's positions to FILE from a background thread\n"
+          "  --tolerance AU        largest position error in the trajectory (default 1e-9)\n"
+          "  --record-every N      steps between recorded trajectory frames (default 1)\n", stderr);
+}
+
+static void report_ephemeris_drift(const struct ephemeris* eph, const struct simulation* sim)
+{
+    if (!ephemeris_covers(eph, sim->time)) {
+        printf("t = %.3f days is past the end of the ephemeris (%.3f days)\n", sim->time, eph->end);
+        return;
+    }
+
+    const uint32_t count = eph->body_count < sim->bodies.count ? eph->body_count : sim->bodies.count;
+    double* expected = util_allocate(3 * count * sizeof(double), "the ephemeris positions");
+    ephemeris_evaluate(eph, sim->time, count, expected, expected + count, expected + 2 * count, NULL, NULL, NULL);
+
+    printf("Drift from the ephemeris at t = %.3f days:\n", sim->time);
+    for (uint32_t i = 0; i < count; ++i) {
+        const double dx = sim->bodies.x[i] - expected[i];
+        const double dy = sim->bodies.y[i] - expected[count + i];
+        const double dz = sim->bodies.z[i] - expected[2 * count + i];
+        printf("  body %2" PRIu32 ": %.3e AU\n", i, sqrt(dx * dx + dy * dy + dz * dz));
+    }
+    free(expected);
+}
+
+static void save_checkpoint(struct checkpoint* checkpoint, struct simulation* sim)
+{
+    const double start = timer_now();
+    const bool written = checkpoint_write(checkpoint, sim);
+    const double elapsed = timer_now() - start;
+    if (!written) {
+        fprintf(stderr, "Failed to write the checkpoint '%s'!\n", checkpoint->path);
+        return;
+    }
+    printf("Checkpoint (%s) at step %" PRIu64 ": %.1f KiB in %.3f ms\n", checkpoint->last_kind == CHECKPOINT_FULL ? "full" : "delta",
+           sim->steps, checkpoint->last_bytes / 1024.0, elapsed * 1e3);
+}
+
+int main(int argc, char** argv)
+{
+    struct simulation_options options;
+    simulation_options_default(&options);
+
+    double end_time = 3652.5;
+    uint64_t max_steps = 0;
+    double progress = 1.0;
+    bool energy = false;
+    bool report = false;
+    bool validate = false;
+    const char* checkpoint_path = NULL;
+    double checkpoint_interval = 300.0;
+    uint32_t full_interval = 8;
+    const char* restore_path = NULL;
+    const char* trajectory_path = NULL;
+    double tolerance = 1e-9;
+    uint64_t record_interval = 1;
+
+    for (int i = 1; i < argc;)
+    {
+        const int consumed = simulation_options_parse(&options, argc, argv, i);
+        if (consumed < 0) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        if (consumed > 0) {
+            i += consumed;
+            continue;
+        }
+
+        if (strcmp(argv[i], "--end") == 0 && i + 1 < argc) {
+            end_time = strtod(argv[i + 1], NULL);
+            i += 2;
+        } else if (strcmp(argv[i], "--steps") == 0 && i + 1 < argc) {
+            max_steps = strtoull(argv[i + 1], NULL, 10);
+            i += 2;
+        } else if (strcmp(argv[i], "--progress") == 0 && i + 1 < argc) {
+            progress = strtod(argv[i + 1], NULL);
+            i += 2;
+        } else if (strcmp(argv[i], "--energy") == 0) {
+            energy = true;
+            i += 1;
+        } else if (strcmp(argv[i], "--force-report") == 0) {
+            report = true;
+            i += 1;
+        } else if (strcmp(argv[i], "--validate") == 0) {
+            validate = true;
+            i += 1;
+        } else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            checkpoint_path = argv[i + 1];
+            i += 2;
+        } else if (strcmp(argv[i], "--checkpoint-every") == 0 && i + 1 < argc) {
+            checkpoint_interval = strtod(argv[i + 1], NULL);
+            i += 2;
+        } else if (strcmp(argv[i], "--full-every") == 0 && i + 1 < argc) {
+            full_interval = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+            i += 2;
+        } else if (strcmp(argv[i], "--restore") == 0 && i + 1 < argc) {
+            restore_path = argv[i + 1];
+            i += 2;
+        } else if (strcmp(argv[i], "--trajectory") == 0 && i + 1 < argc) {
+            trajectory_path = argv[i + 1];
+            i += 2;
+        } else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            tolerance = strtod(argv[i + 1], NULL);
+            i += 2;
+        } else if (strcmp(argv[i], "--record-every") == 0 && i + 1 < argc) {
+            record_interval = strtoull(argv[i + 1], NULL, 10);
+            i += 2;
+        } else {
+            usage(argv[0]);
+            return strcmp(argv[i], "--help") == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if (trajectory_path && (!(tolerance > 0.0) || record_interval == 0)) {
+        fputs("--tolerance and --record-every must be positive\n", stderr);
+        return EXIT_FAILURE;
+    }
+    if (validate && !options.ephemeris) {
+        fputs("--validate needs an --ephemeris to compare against\n", stderr);
+        return EXIT_FAILURE;
+    }
+    struct ephemeris eph = {0};
+    if (options.ephemeris && !ephemeris_open(&eph, options.ephemeris)) {
+        return EXIT_FAILURE;
+    }
+
+    struct thread_pool pool;
+    thread_pool_init(&pool, options.threads);
+
+    struct simulation sim;
+    simulation_init(&sim, options.asteroids + 16, options.dt);
+    simulation_set_thread_pool(&sim, &pool);
+    if (!simulation_options_apply(&options, &sim, options.ephemeris ? &eph : NULL)) {
+        simulation_free(&sim);
+        thread_pool_free(&pool);
+        ephemeris_close(&eph);
+        return EXIT_FAILURE;
+    }
+    if (validate) {
+        /* Start on the ephemeris, then integrate everything */
+        simulation_set_ephemeris(&sim, NULL);
+    }
+    if (restore_path) {
+        uint64_t deltas = 0;
+        if (!checkpoint_restore(&sim, restore_path, &deltas)) {
+            simulation_free(&sim);
+            thread_pool_free(&pool);
+            ephemeris_close(&eph);
+            return EXIT_FAILURE;
+        }
+        printf("Restored t = %.3f days, step %" PRIu64 " from %s and %" PRIu64 " deltas\n", sim.time, sim.steps, restore_path, deltas);
+    }
+
+    printf("Bodies: %" PRIu32 " (gravity: %s, kernel: %s, integrator: %s, dt: %g, threads: %" PRIu32 ")\n", sim.bodies.count,
+           gravity_solver_name(sim.gravity.solver), gravity_kernel_name(sim.gravity.kernel), integrator_name(sim.integrator.type),
+           sim.dt, thread_pool_thread_count(&pool));
+
+    if (report) {
+        const double thetas[] = {0.2, 0.4, 0.6, 0.8, 1.0};
+        force_report(stdout, &sim.gravity, &sim.bodies, thetas, sizeof(thetas) / sizeof(thetas[0]));
+        simulation_free(&sim);
+        thread_pool_free(&pool);
+        ephemeris_close(&eph);
+        return EXIT_SUCCESS;
+    }
+
+    const double initial_energy = energy ? simulation_energy(&sim) : 0.0;
+
+    struct checkpoint checkpoint;
+    if (checkpoint_path) {
+        checkpoint_init(&checkpoint, checkpoint_path, full_interval);
+    }
+    struct trajectory_writer trajectory;
+    if (trajectory_path) {
+        if (!trajectory_writer_open(&trajectory, trajectory_path, sim.bodies.count, tolerance, TRAJECTORY_CHUNK_FRAMES)) {
+            simulation_free(&sim);
+            thread_pool_free(&pool);
+            ephemeris_close(&eph);
+            return EXIT_FAILURE;
+        }
+        trajectory_writer_record(&trajectory, &sim);
+    }
+
+    const double start = timer_now();
+    const uint64_t first_step = sim.steps;
+    double last_progress = start;
+    double last_checkpoint = start;
+    uint64_t last_steps = sim.steps;
+    while (max_steps ? sim.steps < max_steps : sim.time < end_time)
+    {
+        simulation_step(&sim);
+        if (trajectory_path && (sim.steps - first_step) % record_interval == 0) {
+            trajectory_writer_record(&trajectory, &sim);
+        }
+
+        const double now = timer_now();
+        if (checkpoint_path && now - last_checkpoint >= checkpoint_interval) {
+            save_checkpoint(&checkpoint, &sim);
+            last_checkpoint = now;
+        }
+        if (progress > 0.0 && now - last_progress >= progress) {
+            printf("t = %12.3f days, %10" PRIu64 " steps, %10.1f steps/s\n", sim.time, sim.steps, (sim.steps - last_steps) / (now - last_progress));
+            fflush(stdout);
+            last_progress = now;
+            last_steps = sim.steps;
+        }
+    }
+    const double elapsed = timer_now() - start;
+    const uint64_t steps = sim.steps - first_step;
+    if (checkpoint_path) {
+        save_checkpoint(&checkpoint, &sim);
+        checkpoint_free(&checkpoint);
+    }
+    if (trajectory_path) {
+        if (!trajectory_writer_close(&trajectory)) {
+            fprintf(stderr, "Failed to write the trajectory '%s'!\n", trajectory_path);
+        }
+        printf("Trajectory: %" PRIu64 " frames, %.1f KiB (%.2f bytes per body-frame), %" PRIu64 " stalls\n", trajectory.frames,
+               trajectory.offset / 1024.0, (double)trajectory.offset / ((double)trajectory.frames * trajectory.body_count),
+               trajectory.stalls);
+    }
+
+    printf("Simulated %.3f days in %" PRIu64 " steps, %.3f s wall\n", sim.time, steps, elapsed);
+    printf("Throughput: %.1f steps/s, %.3e body-steps/s\n", steps / elapsed, (double)steps * sim.bodies.count / elapsed);
+    if (energy) {
+        printf("Relative energy error: %.3e\n", fabs((simulation_energy(&sim) - initial_energy) / initial_energy));
+    }
+    if (sim.integrator.type == INTEGRATOR_BLOCK_LEAPFROG) {
+        block_timestep_report(&sim.integrator.block, stdout, sim.dt);
+    }
+    if (validate) {
+        report_ephemeris_drift(&eph, &sim);
+    }
+
+    simulation_free(&sim);
+    thread_pool_free(&pool);
+    ephemeris_close(&eph);
+    return EXIT_SUCCESS;
+}
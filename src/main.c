@@ -3,6 +3,7 @@
 #include <string.h>
 #include <inttypes.h>
 #include <stdbool.h>
+#include <math.h>
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -12,24 +13,98 @@
 #include "math/vec4.h"
 #include "math/mat4.h"
 
+#include "physics/options.h"
+#include "physics/ephemeris.h"
+#include "physics/simulation.h"
+#include "physics/sim_thread.h"
+
+#include "util/thread_pool.h"
+#include "util/util.h"
+
 #include "graphics/vertex.h"
+#include "graphics/mesh.h"
+#include "graphics/sphere_mesh.h"
 #include "graphics/shader.h"
+#include "graphics/shader_cache.h"
 #include "graphics/texture.h"
+#include "graphics/texture_manager.h"
 #include "graphics/buffers.h"
 #include "graphics/vertex_array.h"
+#include "graphics/instances.h"
+#include "graphics/uniform_buffer.h"
+#include "graphics/camera.h"
+#include "graphics/culling.h"
+#include "graphics/framebuffer.h"
+#include "graphics/trails.h"
+#include "graphics/tile_cache.h"
+#include "graphics/tile_pages.h"
 
 static void message_callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, GLchar const* message, void const* user_param);
 
+struct mesh_lod
+{
+    buffer_handle_t buffers[2];
+    struct vertex_layout layout;
+    struct vertex_array vao;
+    uint32_t index_count;
+};
+
+static void mesh_lod_init(struct mesh_lod* lod, uint32_t subdivisions);
+static void mesh_lod_free(struct mesh_lod* lod);
+
 enum buffer_id
 {
     BUFFER_ID_VBO = 0,
     BUFFER_ID_IBO = 1
 };
 
+enum storage_binding
+{
+    STORAGE_BINDING_INSTANCES = 0,
+    STORAGE_BINDING_TRAIL_POINTS = 1,
+    STORAGE_BINDING_TRAIL_HEADS = 2,
+    STORAGE_BINDING_TILE_PAGES = 3
+};
+
 int main(int argc, char** argv)
 {
-    (void) argc;
-    (void) argv;
+    struct simulation_options options;
+    simulation_options_default(&options);
+
+    const char* tiles_path = NULL;
+    for (int i = 1; i < argc;) {
+        if (strcmp(argv[i], "--tiles") == 0 && i + 1 < argc) {
+            tiles_path = argv[i + 1];
+            i += 2;
+            continue;
+        }
+        const int consumed = simulation_options_parse(&options, argc, argv, i);
+        if (consumed <= 0) {
+            fprintf(stderr, "Usage: %s [options]\n", argv[0]);
+            fputs("  --tiles FILE          stream the bodies' surface from a texconv --tiles file\n", stderr);
+            simulation_options_usage(stderr);
+            return strcmp(argv[i], "--help") == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+        i += consumed;
+    }
+
+    struct ephemeris eph = {0};
+    if (options.ephemeris && !ephemeris_open(&eph, options.ephemeris)) {
+        return EXIT_FAILURE;
+    }
+
+    struct thread_pool pool;
+    thread_pool_init(&pool, options.threads);
+
+    struct simulation sim;
+    simulation_init(&sim, options.asteroids + 16, options.dt);
+    simulation_set_thread_pool(&sim, &pool);
+    if (!simulation_options_apply(&options, &sim, options.ephemeris ? &eph : NULL)) {
+        simulation_free(&sim);
+        thread_pool_free(&pool);
+        ephemeris_close(&eph);
+        return EXIT_FAILURE;
+    }
 
     if (glfwInit() != GLFW_TRUE) {
         fputs("Failed to initialize GLFW!", stderr);
@@ -68,103 +143,310 @@ int main(int argc, char** argv)
     const char* renderer_str = (const char*)glGetString(GL_RENDERER);
     printf("Vendor: %s\nVersion: %s\nRenderer: %s\n", vendor_str, version_str, renderer_str);
 
-    struct vertex vertices[] = {
-        {.pos = {.x =  0.5f, .y =  0.5f, .z = 0.0f}, .uv = {.x = 1.0f, .y = 1.0f}},
-        {.pos = {.x =  0.5f, .y = -0.5f, .z = 0.0f}, .uv = {.x = 1.0f, .y = 0.0f}},
-        {.pos = {.x = -0.5f, .y = -0.5f, .z = 0.0f}, .uv = {.x = 0.0f, .y = 0.0f}},
-        {.pos = {.x = -0.5f, .y =  0.5f, .z = 0.0f}, .uv = {.x = 0.0f, .y = 1.0f}}
-    };
-    
-    uint32_t indices[] = {
-        0, 1, 3,
-        1, 2, 3
-    };
+    shader_cache_configure(SHADER_CACHE_DIRECTORY, vendor_str, renderer_str, version_str);
 
-    buffer_handle_t buffers[2];
-    size_t sizes[2] = {sizeof(vertices), sizeof(indices)};
-    void* data[2] = {vertices, indices};
-    buffers_init(2, buffers, sizes, data);
-
-    struct vertex_array vao;
-    vertex_array_init(&vao);
-
-    struct vertex_layout layout;
-    vertex_layout_init(&layout);
-    vertex_layout_add(&layout, 3, GL_FLOAT, false, 0);
-    vertex_layout_add(&layout, 2, GL_FLOAT, false, offsetof(struct vertex, uv));
-    
-    vertex_array_add(&vao, &layout);
-    vertex_array_bind(&vao);
-    vertex_array_set(&vao, sizeof(struct vertex), buffers[BUFFER_ID_VBO], buffers[BUFFER_ID_IBO]);
+    /* One shared sphere per mesh level of the draw list, generated once or read from disk */
+    const uint32_t sphere_subdivisions[LOD_POINT] = {4, 2};
+    struct mesh_lod spheres[LOD_POINT];
+    for (uint32_t level = 0; level < LOD_POINT; ++level) {
+        mesh_lod_init(&spheres[level], sphere_subdivisions[level]);
+    }
 
-    texture_t texture = texture_init("wall.jpg");
-    texture_bind(texture, 0);
+    /* Reversed-Z: depth 1 at the near plane falling towards 0 at infinity, into a
+     * float depth buffer, so moons and the outer system share one pass */
+    glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_GREATER);
+    glClearDepth(0.0);
+    glEnable(GL_CULL_FACE);
+
+    int framebuffer_width = 0;
+    int framebuffer_height = 0;
+    glfwGetFramebufferSize(window, &framebuffer_width, &framebuffer_height);
+    struct framebuffer framebuffer;
+    framebuffer_init(&framebuffer, (uint32_t)framebuffer_width, (uint32_t)framebuffer_height);
+
+    /* Decoded off-thread; bodies show a placeholder until it is resident */
+    struct texture_manager textures;
+    texture_manager_init(&textures, 2, 8u << 20);
+    const uint32_t wall_texture = texture_manager_load(&textures, "wall.jpg");
+
+    /* With --tiles, mesh bodies sample the tiles of their visible side from
+     * the tile cache instead; the wall texture stays the fallback */
+    struct tile_cache tile_cache;
+    struct tile_pages tile_pages;
+    int32_t tile_source = -1;
+    if (tiles_path) {
+        tile_cache_init(&tile_cache, 256, 512, 8);
+        tile_pages_init(&tile_pages, 16384);
+        tile_source = tile_cache_open(&tile_cache, tiles_path);
+    }
+    const bool tiled = tile_source >= 0;
 
     struct shader shader;
-    shader_init(&shader, "basic.shader");
+    shader_init(&shader, "basic_instanced.shader");
     shader_bind(&shader);
     shader_set_1i(&shader, "u_Texture", 0);
-
-    struct mat4 identity;
-    mat4_identity(&identity);
-
-    struct mat4 projection = mat4_perspective(45.0f, 960.0f / 540.0f, 0.1f, 100.0f);
-    shader_set_mat4(&shader, "u_Projection", &projection);
+    shader_set_1i(&shader, "u_TileAtlas", 1);
+    shader_set_1i(&shader, "u_Tiled", tiled);
+    const int32_t base_instance = shader_uniform_location(&shader, "u_BaseInstance");
+
+    /* Bodies too small on screen for a mesh are drawn as points */
+    struct shader point_shader;
+    shader_init(&point_shader, "point_instanced.shader");
+    shader_bind(&point_shader);
+    shader_set_1f(&point_shader, "u_PointSize", 2.0f);
+    struct vec4 point_color;
+    vec4_init(&point_color, 0.8f, 0.8f, 0.8f, 1.0f);
+    shader_set_4f(&point_shader, "u_Color", &point_color);
+    const int32_t point_base_instance = shader_uniform_location(&point_shader, "u_BaseInstance");
+    glEnable(GL_PROGRAM_POINT_SIZE);
+
+    const uint32_t TRAIL_LENGTH = 256;
+    struct shader trail_shader;
+    shader_init(&trail_shader, "trail.shader");
+    shader_bind(&trail_shader);
+    shader_set_1i(&trail_shader, "u_TrailLength", (int)TRAIL_LENGTH);
+    struct vec4 trail_color;
+    vec4_init(&trail_color, 0.4f, 0.6f, 1.0f, 0.8f);
+    shader_set_4f(&trail_shader, "u_Color", &trail_color);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    printf("Bodies: %" PRIu32 " (gravity: %s, kernel: %s, integrator: %s, threads: %" PRIu32 ")\n", sim.bodies.count,
+           gravity_solver_name(sim.gravity.solver), gravity_kernel_name(sim.gravity.kernel), integrator_name(sim.integrator.type),
+           thread_pool_thread_count(&pool));
+
+    struct uniform_buffer camera_ubo;
+    uniform_buffer_init(&camera_ubo, sizeof(struct camera_uniforms), SHADER_CAMERA_BINDING);
+
+    struct camera_uniforms camera_uniforms;
 
     struct vec3 camera;
-    vec3_init(&camera, 0.0f, 1.0f, -5.0f);
+    vec3_init(&camera, 0.0f, -40.0f, 25.0f);
     struct vec3 object;
     vec3_init(&object, 0.0f, 0.0f, 0.0f);
     struct vec3 up;
-    vec3_init(&up, 0.0f, 1.0f, 0.0f);
-    
-    struct mat4 view = mat4_look_at(camera, object, up);
-    //mat4_mul(&view, &look_at_mat);
-    struct vec3 rot_angle;
-    vec3_init(&rot_angle, 0.0f, 0.0f, 0.0f);
-    mat4_rotation(&view, &rot_angle);
-
-    shader_set_mat4(&shader, "u_View", &identity);
-
-    glClearColor(0.2f, 0.3f, 0.8f, 1.0f);
+    vec3_init(&up, 0.0f, 0.0f, 1.0f);
+
+    /* Rendering is camera-relative: the view only rotates, and model matrices
+     * get positions minus the eye, subtracted in double before rounding */
+    const double camera_origin[3] = {camera.x, camera.y, camera.z};
+    struct vec3 eye;
+    vec3_init(&eye, 0.0f, 0.0f, 0.0f);
+    struct vec3 direction = object;
+    vec3_sub(&direction, &camera);
+    camera_uniforms.view = mat4_look_at(eye, direction, up);
+    vec4_init(&camera_uniforms.position, camera.x, camera.y, camera.z, 1.0f);
+
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+    struct instance_buffer instances;
+    instance_buffer_init(&instances, sim.bodies.capacity);
+    float* scales = NULL;
+    double* positions = NULL;
+    uint32_t scale_capacity = 0;
+
+    struct cull_params cull;
+    struct draw_list draw_list;
+    draw_list_init(&draw_list, sim.bodies.capacity);
+
+    struct trails trails;
+    trails_init(&trails, sim.bodies.count, TRAIL_LENGTH);
+    bool show_trails = true;
+    bool trails_held = false;
+
+    /* Ephemeris bodies are evaluated on the frame's own clock so they glide
+     * between published steps; everything else shows the last step */
+    const double DAYS_PER_SECOND = 30.0;
+    const double step = sim.dt;
+    double render_time = sim.time;
+    double last_frame = glfwGetTime();
+
+    /* Physics runs on its own thread; the renderer only ever sees published frames */
+    struct sim_thread sim_thread;
+    sim_thread_start(&sim_thread, &sim, DAYS_PER_SECOND);
+    bool paused = false;
+    bool pause_held = false;
 
     while (!glfwWindowShouldClose(window))
     {
+        glfwGetFramebufferSize(window, &framebuffer_width, &framebuffer_height);
+        framebuffer_resize(&framebuffer, (uint32_t)framebuffer_width, (uint32_t)framebuffer_height);
+        framebuffer_bind(&framebuffer);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+        texture_manager_update(&textures);
+        texture_bind(texture_manager_get(&textures, wall_texture), 0);
+
+        /* One upload per frame serves every program that declares the Camera block */
+        const float aspect_ratio = (float)framebuffer.width / (float)framebuffer.height;
+        camera_uniforms.projection = mat4_perspective_reversed(45.0f, aspect_ratio, 1e-6f);
+        camera_uniforms.view_projection = camera_uniforms.projection;
+        mat4_mul(&camera_uniforms.view_projection, &camera_uniforms.view);
+        uniform_buffer_update(&camera_ubo, &camera_uniforms);
+
+        const struct body_frame* bodies = sim_thread_acquire(&sim_thread);
+        if (bodies->count > scale_capacity) {
+            scale_capacity = bodies->count;
+            scales = util_reallocate(scales, scale_capacity * sizeof(float), "the per-body render data");
+            positions = util_reallocate(positions, 3 * scale_capacity * sizeof(double), "the per-body render data");
+        }
 
-        struct mat4 transform;
-        mat4_identity(&transform);
-        
-        struct vec3 axis;
-        const float time = glfwGetTime() * 100.0f;
-        vec3_init(&axis, 0.0f, 0.0f, time);
-        mat4_rotation(&transform, &axis);
+        const double now = glfwGetTime();
+        const double* x = bodies->x;
+        const double* y = bodies->y;
+        const double* z = bodies->z;
+        if (options.ephemeris && ephemeris_covers(&eph, bodies->time)) {
+            render_time += paused ? 0.0 : (now - last_frame) * DAYS_PER_SECOND;
+            /* Stay within the step the simulation thread is working on */
+            render_time = render_time < bodies->time ? bodies->time : render_time;
+            render_time = render_time > bodies->time + step ? bodies->time + step : render_time;
+
+            double* render_x = positions;
+            double* render_y = positions + scale_capacity;
+            double* render_z = positions + 2 * scale_capacity;
+            memcpy(render_x, bodies->x, bodies->count * sizeof(double));
+            memcpy(render_y, bodies->y, bodies->count * sizeof(double));
+            memcpy(render_z, bodies->z, bodies->count * sizeof(double));
+            ephemeris_evaluate(&eph, render_time, bodies->count, render_x, render_y, render_z, NULL, NULL, NULL);
+            x = render_x;
+            y = render_y;
+            z = render_z;
+        } else {
+            render_time = bodies->time;
+        }
+        last_frame = now;
+        for (uint32_t i = 0; i < bodies->count; ++i) {
+            /* Bodies are far too small to see at true scale */
+            scales[i] = 0.05f + 0.6f * cbrtf((float)bodies->mass[i]);
+        }
 
-        struct vec3 scale;
-        vec3_init(&scale, 0.5f, 0.5f, 0.5f);
-        mat4_scale(&transform, &scale);
+        cull_params_init(&cull, &camera_uniforms.projection, &camera_uniforms.view_projection, &camera, framebuffer.height);
+        cull_spheres(&draw_list, &cull, x, y, z, scales, bodies->count);
 
-        struct vec3 translation;
-        vec3_init(&translation, 0.0f, 0.0f, 0.0f);
-        mat4_translation(&transform, &translation);
+        /* Instances are laid out level by level; bodies carry no orientation yet, so no rotations */
+        uint32_t bases[LOD_COUNT];
+        uint32_t visible = 0;
+        for (uint32_t level = 0; level < LOD_COUNT; ++level) {
+            bases[level] = visible;
+            visible += draw_list.counts[level];
+        }
+        instance_buffer_reserve(&instances, visible);
+        struct mat4* transforms = instance_buffer_begin(&instances);
+        for (uint32_t level = 0; level < LOD_COUNT; ++level) {
+            mat4_from_trs_gather(transforms + bases[level], x, y, z, camera_origin, NULL, scales,
+                                 draw_list.indices[level], draw_list.counts[level]);
+        }
+        instances.count = visible;
+        instance_buffer_bind(&instances, STORAGE_BINDING_INSTANCES);
+
+        /* Page tables for the mesh instances, in the same order */
+        if (tiled) {
+            tile_cache_begin_frame(&tile_cache);
+            tile_pages_begin(&tile_pages, bases[LOD_POINT]);
+            for (uint32_t level = 0; level < LOD_POINT; ++level) {
+                for (uint32_t k = 0; k < draw_list.counts[level]; ++k)
+                {
+                    const uint32_t i = draw_list.indices[level][k];
+                    const double offset[3] = {camera_origin[0] - x[i], camera_origin[1] - y[i], camera_origin[2] - z[i]};
+                    const double distance = sqrt(offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2]);
+                    /* Bodies carry no orientation yet, so their texture frame is the world's */
+                    const float view[3] = {(float)(offset[0] / distance), (float)(offset[1] / distance), (float)(offset[2] / distance)};
+                    const float diameter = 2.0f * scales[i] * cull.pixel_scale / (float)distance;
+                    tile_pages_add(&tile_pages, &tile_cache, (uint32_t)tile_source, diameter, view, scales[i] / (float)distance);
+                }
+            }
+            tile_pages_bind(&tile_pages, STORAGE_BINDING_TILE_PAGES);
+            texture_bind(tile_cache.atlas, 1);
+        }
 
-        shader_set_mat4(&shader, "u_Transform", &transform);
+        shader_bind(&shader);
+        for (uint32_t level = 0; level < LOD_POINT; ++level)
+        {
+            if (draw_list.counts[level] == 0) {
+                continue;
+            }
+            vertex_array_bind(&spheres[level].vao);
+            shader_set_location_1i(base_instance, (int)bases[level]);
+            glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)spheres[level].index_count, GL_UNSIGNED_INT, 0, (GLsizei)draw_list.counts[level]);
+        }
+        /* Points read no attributes, so whichever vertex array is bound will do */
+        if (draw_list.counts[LOD_POINT] > 0) {
+            shader_bind(&point_shader);
+            shader_set_location_1i(point_base_instance, (int)bases[LOD_POINT]);
+            glDrawArraysInstanced(GL_POINTS, 0, 1, (GLsizei)draw_list.counts[LOD_POINT]);
+        }
+        instance_buffer_end(&instances);
+        if (tiled) {
+            tile_pages_end(&tile_pages);
+        }
 
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        /* Trails advance even while hidden so they are whole when shown again */
+        trails_update(&trails, x, y, z, bodies->count, camera_origin);
+        if (show_trails) {
+            /* Drawn after the bodies, tested against their depth but never written */
+            glEnable(GL_BLEND);
+            glDepthMask(GL_FALSE);
+            shader_bind(&trail_shader);
+            trails_bind(&trails, STORAGE_BINDING_TRAIL_POINTS, STORAGE_BINDING_TRAIL_HEADS);
+            glDrawArraysInstanced(GL_LINE_STRIP, 0, (GLsizei)trails.length, (GLsizei)trails.body_count);
+            glDepthMask(GL_TRUE);
+            glDisable(GL_BLEND);
+        }
+        trails_end(&trails);
 
         if (glfwGetKey(window, GLFW_KEY_Q)) {
             glfwSetWindowShouldClose(window, true);
         }
 
+        const bool pause_down = glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS;
+        if (pause_down && !pause_held) {
+            paused = !paused;
+            sim_thread_set_paused(&sim_thread, paused);
+        }
+        pause_held = pause_down;
+
+        const bool trails_down = glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS;
+        if (trails_down && !trails_held) {
+            show_trails = !show_trails;
+        }
+        trails_held = trails_down;
+
+        framebuffer_present(&framebuffer);
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
-    texture_free(texture);
+    sim_thread_stop(&sim_thread);
+
+    if (sim.integrator.type == INTEGRATOR_BLOCK_LEAPFROG) {
+        block_timestep_report(&sim.integrator.block, stdout, sim.dt);
+    }
+    if (tiled) {
+        tile_cache_report(&tile_cache, stdout);
+    }
+
+    simulation_free(&sim);
+    thread_pool_free(&pool);
+    ephemeris_close(&eph);
+    instance_buffer_free(&instances);
+    free(scales);
+    free(positions);
+    draw_list_free(&draw_list);
+    trails_free(&trails);
+    uniform_buffer_free(&camera_ubo);
+    framebuffer_free(&framebuffer);
+    texture_manager_free(&textures);
+    if (tiles_path) {
+        tile_pages_free(&tile_pages);
+        tile_cache_free(&tile_cache);
+    }
     shader_free(&shader);
-    vertex_array_free(&vao);
-    buffers_free(2, buffers);
+    shader_free(&point_shader);
+    shader_free(&trail_shader);
+    for (uint32_t level = 0; level < LOD_POINT; ++level) {
+        mesh_lod_free(&spheres[level]);
+    }
 
     glfwDestroyWindow(window);
     glfwTerminate();
@@ -172,6 +454,35 @@ int main(int argc, char** argv)
     return EXIT_SUCCESS;
 }
 
+static void mesh_lod_init(struct mesh_lod* lod, uint32_t subdivisions)
+{
+    struct mesh mesh;
+    sphere_mesh_load(&mesh, subdivisions, SPHERE_MESH_CACHE_DIRECTORY);
+
+    size_t sizes[2] = {mesh.vertex_count * sizeof(struct mesh_vertex), mesh.index_count * sizeof(uint32_t)};
+    void* data[2] = {mesh.vertices, mesh.indices};
+    buffers_init(2, lod->buffers, sizes, data);
+    lod->index_count = mesh.index_count;
+    mesh_free(&mesh);
+
+    vertex_array_init(&lod->vao);
+    vertex_layout_init(&lod->layout);
+    vertex_layout_add(&lod->layout, 3, GL_FLOAT, false, offsetof(struct mesh_vertex, pos));
+    vertex_layout_add(&lod->layout, 2, GL_FLOAT, false, offsetof(struct mesh_vertex, uv));
+    vertex_layout_add(&lod->layout, 3, GL_FLOAT, false, offsetof(struct mesh_vertex, normal));
+    /* Tangent and handedness are adjacent, so they load as one vec4 */
+    vertex_layout_add(&lod->layout, 4, GL_FLOAT, false, offsetof(struct mesh_vertex, tangent));
+
+    vertex_array_add(&lod->vao, &lod->layout);
+    vertex_array_set(&lod->vao, sizeof(struct mesh_vertex), lod->buffers[BUFFER_ID_VBO], lod->buffers[BUFFER_ID_IBO]);
+}
+
+static void mesh_lod_free(struct mesh_lod* lod)
+{
+    vertex_array_free(&lod->vao);
+    buffers_free(2, lod->buffers);
+}
+
 static void message_callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, GLchar const* message, void const* user_param)
 {
     (void) id;
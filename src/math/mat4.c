@@ -2,12 +2,19 @@
 
 #include <inttypes.h>
 #include <string.h>
+#include <stdatomic.h>
 
 #include <math.h>
 
-/* Shame */
-#define M_PI 3.14159265358979323846
-#define M_TAU 6.283185307179586
+#include "../util/cpu.h"
+#include "../util/util.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MAT4_HAS_X86 1
+#include <immintrin.h>
+#else
+#define MAT4_HAS_X86 0
+#endif
 
 static float to_radians(float degrees);
 
@@ -26,23 +33,203 @@ void mat4_identity(struct mat4* matrix)
     mat4_init(matrix, 1.0f);
 }
 
-void mat4_mul(struct mat4* left, const struct mat4* right)
+typedef void (*mat4_mul_fn)(const struct mat4* left, const struct mat4* rights, struct mat4* results, uint32_t count);
+typedef void (*mat4_transform_fn)(const struct mat4* matrix, const struct vec4* vectors, struct vec4* results, uint32_t count);
+
+static void mul_scalar(const struct mat4* left, const struct mat4* rights, struct mat4* results, uint32_t count)
 {
-    /* TODO: Vectorize (SIMD) */
-    float data[16];
-    for (uint32_t row = 0; row < 4; ++row)
+    for (uint32_t i = 0; i < count; ++i)
     {
-        for (uint32_t col = 0; col < 4; ++col)
+        float data[16];
+        for (uint32_t row = 0; row < 4; ++row)
         {
-            float sum = 0.0f;
-            for (uint32_t e = 0; e < 4; ++e)
+            for (uint32_t col = 0; col < 4; ++col)
             {
-                sum += left->elements[e + row * 4] * right->elements[col + e * 4];
+                float sum = 0.0f;
+                for (uint32_t e = 0; e < 4; ++e)
+                {
+                    sum += left->elements[e + row * 4] * rights[i].elements[col + e * 4];
+                }
+                data[col + row * 4] = sum;
             }
-            data[col + row * 4] = sum;
         }
+        memcpy(results[i].elements, data, sizeof(data));
     }
-    memcpy(left->elements, data, sizeof(data));
+}
+
+static void transform_scalar(const struct mat4* matrix, const struct vec4* vectors, struct vec4* results, uint32_t count)
+{
+    const float* m = matrix->elements;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const struct vec4 v = vectors[i];
+        results[i].x = m[0] * v.x + m[1] * v.y + m[2] * v.z + m[3] * v.w;
+        results[i].y = m[4] * v.x + m[5] * v.y + m[6] * v.z + m[7] * v.w;
+        results[i].z = m[8] * v.x + m[9] * v.y + m[10] * v.z + m[11] * v.w;
+        results[i].w = m[12] * v.x + m[13] * v.y + m[14] * v.z + m[15] * v.w;
+    }
+}
+
+#if MAT4_HAS_X86
+/*
+ * Row r of left * right is the sum over k of left[r][k] * (row k of right),
+ * so each output row is four broadcasts and four multiply-adds. Everything
+ * read is loaded before anything is stored, so results may alias either input.
+ */
+__attribute__((target("sse2")))
+static void mul_sse2(const struct mat4* left, const struct mat4* rights, struct mat4* results, uint32_t count)
+{
+    const float* l = left->elements;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const __m128 r0 = _mm_load_ps(&rights[i].elements[0]);
+        const __m128 r1 = _mm_load_ps(&rights[i].elements[4]);
+        const __m128 r2 = _mm_load_ps(&rights[i].elements[8]);
+        const __m128 r3 = _mm_load_ps(&rights[i].elements[12]);
+        __m128 rows[4];
+        for (uint32_t row = 0; row < 4; ++row) {
+            __m128 sum = _mm_mul_ps(_mm_set1_ps(l[row * 4 + 0]), r0);
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(l[row * 4 + 1]), r1));
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(l[row * 4 + 2]), r2));
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(l[row * 4 + 3]), r3));
+            rows[row] = sum;
+        }
+        for (uint32_t row = 0; row < 4; ++row) {
+            _mm_store_ps(&results[i].elements[row * 4], rows[row]);
+        }
+    }
+}
+
+__attribute__((target("sse2")))
+static void transform_sse2(const struct mat4* matrix, const struct vec4* vectors, struct vec4* results, uint32_t count)
+{
+    /* Columns of the row-major matrix, so each vector is four broadcasts and multiply-adds */
+    __m128 c0 = _mm_load_ps(&matrix->elements[0]);
+    __m128 c1 = _mm_load_ps(&matrix->elements[4]);
+    __m128 c2 = _mm_load_ps(&matrix->elements[8]);
+    __m128 c3 = _mm_load_ps(&matrix->elements[12]);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const __m128 v = _mm_load_ps(&vectors[i].x);
+        __m128 sum = _mm_mul_ps(c0, _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)));
+        sum = _mm_add_ps(sum, _mm_mul_ps(c1, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+        sum = _mm_add_ps(sum, _mm_mul_ps(c2, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))));
+        sum = _mm_add_ps(sum, _mm_mul_ps(c3, _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))));
+        _mm_store_ps(&results[i].x, sum);
+    }
+}
+
+/* Two output rows, or two vectors, per 256-bit register: one in each 128-bit lane */
+__attribute__((target("avx2,fma")))
+static void mul_avx2(const struct mat4* left, const struct mat4* rights, struct mat4* results, uint32_t count)
+{
+    const __m256 l01 = _mm256_loadu_ps(&left->elements[0]);
+    const __m256 l23 = _mm256_loadu_ps(&left->elements[8]);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const float* r = rights[i].elements;
+        const __m256 r0 = _mm256_broadcast_ps((const __m128*)&r[0]);
+        const __m256 r1 = _mm256_broadcast_ps((const __m128*)&r[4]);
+        const __m256 r2 = _mm256_broadcast_ps((const __m128*)&r[8]);
+        const __m256 r3 = _mm256_broadcast_ps((const __m128*)&r[12]);
+
+        __m256 a = _mm256_mul_ps(_mm256_permute_ps(l01, 0x00), r0);
+        __m256 b = _mm256_mul_ps(_mm256_permute_ps(l23, 0x00), r0);
+        a = _mm256_fmadd_ps(_mm256_permute_ps(l01, 0x55), r1, a);
+        b = _mm256_fmadd_ps(_mm256_permute_ps(l23, 0x55), r1, b);
+        a = _mm256_fmadd_ps(_mm256_permute_ps(l01, 0xAA), r2, a);
+        b = _mm256_fmadd_ps(_mm256_permute_ps(l23, 0xAA), r2, b);
+        a = _mm256_fmadd_ps(_mm256_permute_ps(l01, 0xFF), r3, a);
+        b = _mm256_fmadd_ps(_mm256_permute_ps(l23, 0xFF), r3, b);
+
+        _mm256_storeu_ps(&results[i].elements[0], a);
+        _mm256_storeu_ps(&results[i].elements[8], b);
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static void transform_avx2(const struct mat4* matrix, const struct vec4* vectors, struct vec4* results, uint32_t count)
+{
+    __m128 c0 = _mm_load_ps(&matrix->elements[0]);
+    __m128 c1 = _mm_load_ps(&matrix->elements[4]);
+    __m128 c2 = _mm_load_ps(&matrix->elements[8]);
+    __m128 c3 = _mm_load_ps(&matrix->elements[12]);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    const __m256 cc0 = _mm256_set_m128(c0, c0);
+    const __m256 cc1 = _mm256_set_m128(c1, c1);
+    const __m256 cc2 = _mm256_set_m128(c2, c2);
+    const __m256 cc3 = _mm256_set_m128(c3, c3);
+
+    uint32_t i = 0;
+    for (; i + 2 <= count; i += 2)
+    {
+        const __m256 v = _mm256_loadu_ps(&vectors[i].x);
+        __m256 sum = _mm256_mul_ps(cc0, _mm256_permute_ps(v, 0x00));
+        sum = _mm256_fmadd_ps(cc1, _mm256_permute_ps(v, 0x55), sum);
+        sum = _mm256_fmadd_ps(cc2, _mm256_permute_ps(v, 0xAA), sum);
+        sum = _mm256_fmadd_ps(cc3, _mm256_permute_ps(v, 0xFF), sum);
+        _mm256_storeu_ps(&results[i].x, sum);
+    }
+    if (i < count) {
+        transform_sse2(matrix, &vectors[i], &results[i], count - i);
+    }
+}
+#endif
+
+struct mat4_kernels
+{
+    mat4_mul_fn mul;
+    mat4_transform_fn transform;
+};
+
+static const struct mat4_kernels scalar_kernels = {mul_scalar, transform_scalar};
+#if MAT4_HAS_X86
+static const struct mat4_kernels sse2_kernels = {mul_sse2, transform_sse2};
+static const struct mat4_kernels avx2_kernels = {mul_avx2, transform_avx2};
+#endif
+
+/* Picked on first use and published once; the tables themselves never change */
+static _Atomic(const struct mat4_kernels*) active_kernels = NULL;
+
+static const struct mat4_kernels* select_kernels(void)
+{
+#if MAT4_HAS_X86
+    const uint32_t features = cpu_features();
+    if ((features & CPU_FEATURE_AVX2) && (features & CPU_FEATURE_FMA)) {
+        return &avx2_kernels;
+    }
+    if (features & CPU_FEATURE_SSE2) {
+        return &sse2_kernels;
+    }
+#endif
+    return &scalar_kernels;
+}
+
+static inline const struct mat4_kernels* kernels(void)
+{
+    const struct mat4_kernels* result = atomic_load_explicit(&active_kernels, memory_order_acquire);
+    if (!result) {
+        result = select_kernels();
+        atomic_store_explicit(&active_kernels, result, memory_order_release);
+    }
+    return result;
+}
+
+void mat4_mul(struct mat4* left, const struct mat4* right)
+{
+    kernels()->mul(left, right, left, 1);
+}
+
+void mat4_mul_batch(const struct mat4* left, const struct mat4* rights, struct mat4* results, uint32_t count)
+{
+    kernels()->mul(left, rights, results, count);
+}
+
+void mat4_transform_batch(const struct mat4* matrix, const struct vec4* vectors, struct vec4* results, uint32_t count)
+{
+    kernels()->transform(matrix, vectors, results, count);
 }
 
 struct mat4 mat4_orthographic(float left, float right, float bottom, float top, float near, float far)
@@ -81,6 +268,22 @@ struct mat4 mat4_perspective(float fov, float aspect_ratio, float near, float fa
     return result;
 }
 
+struct mat4 mat4_perspective_reversed(float fov, float aspect_ratio, float near)
+{
+    struct mat4 result;
+    mat4_init(&result, 0.0f);
+
+    const float q = 1.0f / tanf(to_radians(0.5f * fov));
+
+    /* z_clip = near and w_clip = -z_view, so depth = near / distance */
+    result.elements[0 + 0 * 4] = q / aspect_ratio;
+    result.elements[1 + 1 * 4] = q;
+    result.elements[3 + 2 * 4] = near;
+    result.elements[2 + 3 * 4] = -1.0f;
+
+    return result;
+}
+
 struct mat4 mat4_look_at(struct vec3 camera, struct vec3 object, struct vec3 up)
 {
     struct mat4 result;
@@ -117,14 +320,12 @@ struct mat4 mat4_look_at(struct vec3 camera, struct vec3 object, struct vec3 up)
 
 void mat4_translation(struct mat4* matrix, const struct vec3* translation)
 {
-    struct mat4 result;
-    mat4_identity(&result);
-
-    result.elements[3 + 0 * 4] = translation->x;
-    result.elements[3 + 1 * 4] = translation->y;
-    result.elements[3 + 2 * 4] = translation->z;
-
-    mat4_mul(matrix, &result);
+    /* matrix * T only changes the last column */
+    for (uint32_t row = 0; row < 4; ++row)
+    {
+        float* m = &matrix->elements[row * 4];
+        m[3] += m[0] * translation->x + m[1] * translation->y + m[2] * translation->z;
+    }
 }
 
 void mat4_rotation(struct mat4* matrix, const struct vec3* angles)
@@ -161,16 +362,91 @@ void mat4_rotation(struct mat4* matrix, const struct vec3* angles)
 
 void mat4_scale(struct mat4* matrix, const struct vec3* scale)
 {
-    struct mat4 result;
-    mat4_identity(&result);
+    /* matrix * S scales the first three columns */
+    for (uint32_t row = 0; row < 4; ++row)
+    {
+        float* m = &matrix->elements[row * 4];
+        m[0] *= scale->x;
+        m[1] *= scale->y;
+        m[2] *= scale->z;
+    }
+}
 
-    result.elements[0 + 0 * 4] = scale->x;
-    result.elements[1 + 1 * 4] = scale->y;
-    result.elements[2 + 2 * 4] = scale->z;
-    
-    mat4_mul(matrix, &result);
+static inline void write_trs(float* m, float tx, float ty, float tz, const struct quat* q, float sx, float sy, float sz)
+{
+    const float xx = q->x * q->x;
+    const float yy = q->y * q->y;
+    const float zz = q->z * q->z;
+    const float xy = q->x * q->y;
+    const float xz = q->x * q->z;
+    const float yz = q->y * q->z;
+    const float wx = q->w * q->x;
+    const float wy = q->w * q->y;
+    const float wz = q->w * q->z;
+
+    m[0 + 0 * 4] = (1.0f - 2.0f * (yy + zz)) * sx;
+    m[1 + 0 * 4] = 2.0f * (xy - wz) * sy;
+    m[2 + 0 * 4] = 2.0f * (xz + wy) * sz;
+    m[3 + 0 * 4] = tx;
+
+    m[0 + 1 * 4] = 2.0f * (xy + wz) * sx;
+    m[1 + 1 * 4] = (1.0f - 2.0f * (xx + zz)) * sy;
+    m[2 + 1 * 4] = 2.0f * (yz - wx) * sz;
+    m[3 + 1 * 4] = ty;
+
+    m[0 + 2 * 4] = 2.0f * (xz - wy) * sx;
+    m[1 + 2 * 4] = 2.0f * (yz + wx) * sy;
+    m[2 + 2 * 4] = (1.0f - 2.0f * (xx + yy)) * sz;
+    m[3 + 2 * 4] = tz;
+
+    m[0 + 3 * 4] = 0.0f;
+    m[1 + 3 * 4] = 0.0f;
+    m[2 + 3 * 4] = 0.0f;
+    m[3 + 3 * 4] = 1.0f;
+}
+
+void mat4_from_trs(struct mat4* matrix, const struct vec3* translation, const struct quat* rotation, const struct vec3* scale)
+{
+    write_trs(matrix->elements, translation->x, translation->y, translation->z, rotation, scale->x, scale->y, scale->z);
+}
+
+void mat4_from_trs_batch(struct mat4* results, const double* x, const double* y, const double* z, const double* origin,
+                         const struct quat* rotations, const float* scales, uint32_t count)
+{
+    const double ox = origin ? origin[0] : 0.0;
+    const double oy = origin ? origin[1] : 0.0;
+    const double oz = origin ? origin[2] : 0.0;
+
+    if (!rotations) {
+        /* Constant folded once write_trs is inlined: only scale and translation remain */
+        const struct quat identity = {0.0f, 0.0f, 0.0f, 1.0f};
+        for (uint32_t i = 0; i < count; ++i) {
+            write_trs(results[i].elements, (float)(x[i] - ox), (float)(y[i] - oy), (float)(z[i] - oz), &identity, scales[i], scales[i],
+                      scales[i]);
+        }
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        write_trs(results[i].elements, (float)(x[i] - ox), (float)(y[i] - oy), (float)(z[i] - oz), &rotations[i], scales[i], scales[i],
+                  scales[i]);
+    }
 }
 
+void mat4_from_trs_gather(struct mat4* results, const double* x, const double* y, const double* z, const double* origin,
+                          const struct quat* rotations, const float* scales, const uint32_t* indices, uint32_t count)
+{
+    const double ox = origin ? origin[0] : 0.0;
+    const double oy = origin ? origin[1] : 0.0;
+    const double oz = origin ? origin[2] : 0.0;
+    const struct quat identity = {0.0f, 0.0f, 0.0f, 1.0f};
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const uint32_t j = indices[i];
+        const struct quat* rotation = rotations ? &rotations[j] : &identity;
+        write_trs(results[i].elements, (float)(x[j] - ox), (float)(y[j] - oy), (float)(z[j] - oz), rotation, scales[j], scales[j], scales[j]);
+    }
+}
 static float to_radians(float degrees)
 {
     return degrees * (M_PI / 180.0f);
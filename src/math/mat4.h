@@ -1,8 +1,11 @@
 #ifndef MAT4_H
 #define MAT4_H
 
+#include <inttypes.h>
+
 #include "vec3.h"
 #include "vec4.h"
+#include "quat.h"
 
 struct mat4
 {
@@ -17,8 +20,18 @@ void mat4_init(struct mat4* matrix, float diagonal);
 void mat4_identity(struct mat4* matrix);
 void mat4_mul(struct mat4* left, const struct mat4* right);
 
+/* results[i] = left * rights[i]; results may alias rights */
+void mat4_mul_batch(const struct mat4* left, const struct mat4* rights, struct mat4* results, uint32_t count);
+/* results[i] = matrix * vectors[i]; results may alias vectors */
+void mat4_transform_batch(const struct mat4* matrix, const struct vec4* vectors, struct vec4* results, uint32_t count);
+
 struct mat4 mat4_orthographic(float left, float right, float bottom, float top, float near, float far);
 struct mat4 mat4_perspective(float fov, float aspect_ratio, float near, float far);
+/* Infinite far plane with depth reversed into [0, 1]: near maps to 1 and
+ * infinity to 0. Needs glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE), a depth
+ * clear of 0 and GL_GREATER; with a float depth buffer precision is then
+ * nearly uniform in log distance */
+struct mat4 mat4_perspective_reversed(float fov, float aspect_ratio, float near);
 
 struct mat4 mat4_look_at(struct vec3 camera, struct vec3 object, struct vec3 up);
 
@@ -26,4 +39,17 @@ void mat4_translation(struct mat4* matrix, const struct vec3* translation);
 void mat4_rotation(struct mat4* matrix, const struct vec3* angles);
 void mat4_scale(struct mat4* matrix, const struct vec3* scale);
 
+/* translation * rotation * scale, written directly without any multiplies */
+void mat4_from_trs(struct mat4* matrix, const struct vec3* translation, const struct quat* rotation, const struct vec3* scale);
+/* The same over structure-of-arrays body data with a uniform scale per body.
+ * Positions are made relative to origin in double before rounding to float, so
+ * with the camera as origin nearby bodies keep full precision at any distance
+ * from the Sun; origin and rotations may be NULL. Only writes to results, so it
+ * may target a mapped buffer directly */
+void mat4_from_trs_batch(struct mat4* results, const double* x, const double* y, const double* z, const double* origin,
+                         const struct quat* rotations, const float* scales, uint32_t count);
+/* results[i] is built from body indices[i], for drawing a culled subset */
+void mat4_from_trs_gather(struct mat4* results, const double* x, const double* y, const double* z, const double* origin,
+                          const struct quat* rotations, const float* scales, const uint32_t* indices, uint32_t count);
+
 #endif
\ No newline at end of file
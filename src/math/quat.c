@@ -0,0 +1,74 @@
+#include "quat.h"
+
+#include <math.h>
+
+#include "../util/util.h"
+
+void quat_identity(struct quat* quat)
+{
+    quat->x = 0.0f;
+    quat->y = 0.0f;
+    quat->z = 0.0f;
+    quat->w = 1.0f;
+}
+
+void quat_from_axis_angle(struct quat* quat, const struct vec3* axis, float angle)
+{
+    const float length = vec3_magnitude(axis);
+    if (length == 0.0f) {
+        quat_identity(quat);
+        return;
+    }
+
+    const float half = 0.5f * angle * (float)(M_PI / 180.0);
+    const float s = sinf(half) / length;
+    quat->x = axis->x * s;
+    quat->y = axis->y * s;
+    quat->z = axis->z * s;
+    quat->w = cosf(half);
+}
+
+void quat_from_angles(struct quat* quat, const struct vec3* angles)
+{
+    quat_from_axis_angle(quat, angles, vec3_magnitude(angles));
+}
+
+void quat_mul(struct quat* quat, const struct quat* other)
+{
+    const struct quat a = *quat;
+    const struct quat* b = other;
+
+    quat->x = a.w * b->x + a.x * b->w + a.y * b->z - a.z * b->y;
+    quat->y = a.w * b->y - a.x * b->z + a.y * b->w + a.z * b->x;
+    quat->z = a.w * b->z + a.x * b->y - a.y * b->x + a.z * b->w;
+    quat->w = a.w * b->w - a.x * b->x - a.y * b->y - a.z * b->z;
+}
+
+void quat_normalize(struct quat* quat)
+{
+    const float length2 = quat->x * quat->x + quat->y * quat->y + quat->z * quat->z + quat->w * quat->w;
+    if (length2 == 0.0f) {
+        quat_identity(quat);
+        return;
+    }
+
+    const float inverse = 1.0f / sqrtf(length2);
+    quat->x *= inverse;
+    quat->y *= inverse;
+    quat->z *= inverse;
+    quat->w *= inverse;
+}
+
+struct vec3 quat_rotate(const struct quat* quat, const struct vec3* vec)
+{
+    /* v' = v + w * t + q x t with t = 2 * (q x v) */
+    const float tx = 2.0f * (quat->y * vec->z - quat->z * vec->y);
+    const float ty = 2.0f * (quat->z * vec->x - quat->x * vec->z);
+    const float tz = 2.0f * (quat->x * vec->y - quat->y * vec->x);
+
+    struct vec3 result;
+    result.x = vec->x + quat->w * tx + quat->y * tz - quat->z * ty;
+    result.y = vec->y + quat->w * ty + quat->z * tx - quat->x * tz;
+    result.z = vec->z + quat->w * tz + quat->x * ty - quat->y * tx;
+    return result;
+}
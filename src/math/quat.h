@@ -0,0 +1,26 @@
+#ifndef QUAT_H
+#define QUAT_H
+
+#include "vec3.h"
+
+/* Unit quaternion; w is the scalar part */
+struct quat
+{
+    float x;
+    float y;
+    float z;
+    float w;
+};
+
+void quat_identity(struct quat* quat);
+/* Angles in degrees, like mat4_rotation; the axis need not be normalized */
+void quat_from_axis_angle(struct quat* quat, const struct vec3* axis, float angle);
+/* Same convention as mat4_rotation: the direction is the axis, the length the angle */
+void quat_from_angles(struct quat* quat, const struct vec3* angles);
+
+/* quat = quat * other, i.e. other is applied first */
+void quat_mul(struct quat* quat, const struct quat* other);
+void quat_normalize(struct quat* quat);
+struct vec3 quat_rotate(const struct quat* quat, const struct vec3* vec);
+
+#endif
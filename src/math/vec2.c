@@ -4,6 +4,19 @@
 #include <immintrin.h>
 #endif
 
+#if VEC2_USE_SIMD
+/* Exactly 8 bytes each way; a full 16-byte access would run past the struct */
+static __m128 load_vec2(const struct vec2* vec)
+{
+    return _mm_castpd_ps(_mm_load_sd((const double*)vec));
+}
+
+static void store_vec2(struct vec2* vec, __m128 value)
+{
+    _mm_store_sd((double*)vec, _mm_castps_pd(value));
+}
+#endif
+
 void vec2_init(struct vec2* vec, float x, float y)
 {
     vec->x = x;
@@ -13,10 +26,10 @@ void vec2_init(struct vec2* vec, float x, float y)
 void vec2_add(struct vec2* vec, struct vec2* other)
 {
 #if VEC2_USE_SIMD
-    __m128 a = _mm_loadu_ps((const float*)vec);
-    __m128 b = _mm_loadu_ps((const float*)other);
+    __m128 a = load_vec2(vec);
+    __m128 b = load_vec2(other);
     __m128 res = _mm_add_ps(a, b);
-    _mm_storeu_ps((float*)vec, res);
+    store_vec2(vec, res);
 #else
     vec->x += other->x;
     vec->y += other->y;
@@ -26,10 +39,10 @@ void vec2_add(struct vec2* vec, struct vec2* other)
 void vec2_sub(struct vec2* vec, struct vec2* other)
 {
 #if VEC2_USE_SIMD
-    __m128 a = _mm_loadu_ps((const float*)vec);
-    __m128 b = _mm_loadu_ps((const float*)other);
+    __m128 a = load_vec2(vec);
+    __m128 b = load_vec2(other);
     __m128 res = _mm_sub_ps(a, b);
-    _mm_storeu_ps((float*)vec, res);
+    store_vec2(vec, res);
 #else
     vec->x -= other->x;
     vec->y -= other->y;
@@ -39,10 +52,10 @@ void vec2_sub(struct vec2* vec, struct vec2* other)
 void vec2_mul(struct vec2* vec, struct vec2* other)
 {
 #if VEC2_USE_SIMD
-    __m128 a = _mm_loadu_ps((const float*)vec);
-    __m128 b = _mm_loadu_ps((const float*)other);
+    __m128 a = load_vec2(vec);
+    __m128 b = load_vec2(other);
     __m128 res = _mm_mul_ps(a, b);
-    _mm_storeu_ps((float*)vec, res);
+    store_vec2(vec, res);
 #else
     vec->x *= other->x;
     vec->y *= other->y;
@@ -52,10 +65,10 @@ void vec2_mul(struct vec2* vec, struct vec2* other)
 void vec2_div(struct vec2* vec, struct vec2* other)
 {
 #if VEC2_USE_SIMD
-    __m128 a = _mm_loadu_ps((const float*)vec);
-    __m128 b = _mm_loadu_ps((const float*)other);
+    __m128 a = load_vec2(vec);
+    __m128 b = load_vec2(other);
     __m128 res = _mm_div_ps(a, b);
-    _mm_storeu_ps((float*)vec, res);
+    store_vec2(vec, res);
 #else
     vec->x /= other->x;
     vec->y /= other->y;
@@ -6,6 +6,22 @@
 
 #include <math.h>
 
+#if VEC3_USE_SIMD
+/* Exactly 12 bytes each way; a full 16-byte access would run past the struct */
+static __m128 load_vec3(const struct vec3* vec)
+{
+    const __m128 xy = _mm_castpd_ps(_mm_load_sd((const double*)vec));
+    const __m128 z = _mm_load_ss(&vec->z);
+    return _mm_movelh_ps(xy, z);
+}
+
+static void store_vec3(struct vec3* vec, __m128 value)
+{
+    _mm_store_sd((double*)vec, _mm_castps_pd(value));
+    _mm_store_ss(&vec->z, _mm_movehl_ps(value, value));
+}
+#endif
+
 void vec3_init(struct vec3* vec, float x, float y, float z)
 {
     vec->x = x;
@@ -16,10 +32,10 @@ void vec3_init(struct vec3* vec, float x, float y, float z)
 void vec3_add(struct vec3* vec, struct vec3* other)
 {
 #if VEC3_USE_SIMD
-    __m128 a = _mm_loadu_ps((const float*)vec);
-    __m128 b = _mm_loadu_ps((const float*)other);
+    __m128 a = load_vec3(vec);
+    __m128 b = load_vec3(other);
     __m128 res = _mm_add_ps(a, b);
-    _mm_storeu_ps((float*)vec, res);
+    store_vec3(vec, res);
 #else
     vec->x += other->x;
     vec->y += other->y;
@@ -30,10 +46,10 @@ void vec3_add(struct vec3* vec, struct vec3* other)
 void vec3_sub(struct vec3* vec, struct vec3* other)
 {
 #if VEC3_USE_SIMD
-    __m128 a = _mm_loadu_ps((const float*)vec);
-    __m128 b = _mm_loadu_ps((const float*)other);
+    __m128 a = load_vec3(vec);
+    __m128 b = load_vec3(other);
     __m128 res = _mm_sub_ps(a, b);
-    _mm_storeu_ps((float*)vec, res);
+    store_vec3(vec, res);
 #else
     vec->x -= other->x;
     vec->y -= other->y;
@@ -44,10 +60,10 @@ void vec3_sub(struct vec3* vec, struct vec3* other)
 void vec3_mul(struct vec3* vec, struct vec3* other)
 {
 #if VEC3_USE_SIMD
-    __m128 a = _mm_loadu_ps((const float*)vec);
-    __m128 b = _mm_loadu_ps((const float*)other);
+    __m128 a = load_vec3(vec);
+    __m128 b = load_vec3(other);
     __m128 res = _mm_mul_ps(a, b);
-    _mm_storeu_ps((float*)vec, res);
+    store_vec3(vec, res);
 #else
     vec->x *= other->x;
     vec->y *= other->y;
@@ -58,10 +74,10 @@ void vec3_mul(struct vec3* vec, struct vec3* other)
 void vec3_div(struct vec3* vec, struct vec3* other)
 {
 #if VEC3_USE_SIMD
-    __m128 a = _mm_loadu_ps((const float*)vec);
-    __m128 b = _mm_loadu_ps((const float*)other);
+    __m128 a = load_vec3(vec);
+    __m128 b = load_vec3(other);
     __m128 res = _mm_div_ps(a, b);
-    _mm_storeu_ps((float*)vec, res);
+    store_vec3(vec, res);
 #else
     vec->x /= other->x;
     vec->y /= other->y;
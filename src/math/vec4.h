@@ -3,9 +3,10 @@
 
 #include "../config.h"
 
+/* 16-byte aligned so SIMD code may use aligned loads and stores */
 struct vec4
 {
-    float x;
+    _Alignas(16) float x;
     float y;
     float z;
     float w;
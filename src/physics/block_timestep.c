@@ -0,0 +1,230 @@
+#include "block_timestep.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../util/thread_pool.h"
+#include "../util/util.h"
+
+#define BLOCK_TIMESTEP_GRAIN 1024
+
+struct block_task
+{
+    struct block_timestep* block;
+    struct bodies* bodies;
+    double dt;
+    uint64_t tick;
+};
+
+static uint64_t bin_period(const struct block_timestep* block, uint32_t bin)
+{
+    return (uint64_t)1 << (block->bin_count - 1 - bin);
+}
+
+static double bin_dt(uint32_t bin, double dt)
+{
+    return ldexp(dt, -(int)bin);
+}
+
+static void block_reserve(struct block_timestep* block, uint32_t count)
+{
+    if (count <= block->capacity) {
+        return;
+    }
+    block->bins = util_reallocate(block->bins, count * sizeof(uint8_t), "block timestep bins");
+    block->active = util_reallocate(block->active, count * sizeof(uint32_t), "block timestep bins");
+    block->capacity = count;
+}
+
+/* Finest bin whose step fits the body's own timestep criterion eta * |v| / |a| */
+static uint32_t desired_bin(const struct block_timestep* block, const struct bodies* bodies, uint32_t i, double dt)
+{
+    const double a = sqrt(bodies->ax[i] * bodies->ax[i] + bodies->ay[i] * bodies->ay[i] + bodies->az[i] * bodies->az[i]);
+    const double v = sqrt(bodies->vx[i] * bodies->vx[i] + bodies->vy[i] * bodies->vy[i] + bodies->vz[i] * bodies->vz[i]);
+    if (a == 0.0 || v == 0.0) {
+        return 0;
+    }
+
+    const double own = block->eta * v / a;
+    if (own >= dt) {
+        return 0;
+    }
+    const double bin = ceil(log2(dt / own));
+    return bin >= block->bin_count - 1 ? block->bin_count - 1 : (uint32_t)bin;
+}
+
+static void opening_kick_task(void* context, uint32_t begin, uint32_t end, uint32_t worker)
+{
+    (void) worker;
+    const struct block_task* task = context;
+    const struct block_timestep* block = task->block;
+    struct bodies* b = task->bodies;
+    for (uint32_t i = begin; i < end; ++i) {
+        const uint32_t bin = block->bins[i];
+        if (task->tick % bin_period(block, bin) != 0) {
+            continue;
+        }
+        const double h = 0.5 * bin_dt(bin, task->dt);
+        b->vx[i] += h * b->ax[i];
+        b->vy[i] += h * b->ay[i];
+        b->vz[i] += h * b->az[i];
+    }
+}
+
+static void drift_task(void* context, uint32_t begin, uint32_t end, uint32_t worker)
+{
+    (void) worker;
+    const struct block_task* task = context;
+    struct bodies* b = task->bodies;
+    for (uint32_t i = begin; i < end; ++i) {
+        b->x[i] += task->dt * b->vx[i];
+        b->y[i] += task->dt * b->vy[i];
+        b->z[i] += task->dt * b->vz[i];
+    }
+}
+
+static void closing_kick_task(void* context, uint32_t begin, uint32_t end, uint32_t worker)
+{
+    (void) worker;
+    const struct block_task* task = context;
+    struct block_timestep* block = task->block;
+    struct bodies* b = task->bodies;
+    for (uint32_t k = begin; k < end; ++k)
+    {
+        const uint32_t i = block->active[k];
+        const uint32_t bin = block->bins[i];
+        const double h = 0.5 * bin_dt(bin, task->dt);
+        b->vx[i] += h * b->ax[i];
+        b->vy[i] += h * b->ay[i];
+        b->vz[i] += h * b->az[i];
+
+        /* Refine freely; coarsen by one bin at a time and only when that
+         * bin is synchronized at this tick */
+        uint32_t next = desired_bin(block, b, i, task->dt);
+        if (next < bin) {
+            next = bin - 1;
+            if (task->tick % bin_period(block, next) != 0) {
+                next = bin;
+            }
+        }
+        block->bins[i] = (uint8_t)next;
+    }
+}
+
+void block_timestep_init(struct block_timestep* block, uint32_t bin_count, double eta)
+{
+    memset(block, 0, sizeof(*block));
+    block->bin_count = bin_count < 1 ? 1 : bin_count > BLOCK_TIMESTEP_MAX_BINS ? BLOCK_TIMESTEP_MAX_BINS : bin_count;
+    block->eta = eta;
+}
+
+void block_timestep_free(struct block_timestep* block)
+{
+    free(block->bins);
+    free(block->active);
+    block->bins = NULL;
+    block->active = NULL;
+    block->capacity = 0;
+}
+
+void block_timestep_begin(struct block_timestep* block, struct bodies* bodies, struct gravity* gravity, double dt)
+{
+    block_reserve(block, bodies->count);
+    gravity_accelerations(gravity, bodies);
+    block->force_evaluations += bodies->count;
+
+    memset(block->population, 0, sizeof(block->population));
+    for (uint32_t i = 0; i < bodies->count; ++i) {
+        block->bins[i] = (uint8_t)desired_bin(block, bodies, i, dt);
+        block->population[block->bins[i]]++;
+    }
+}
+
+void block_timestep_restore(struct block_timestep* block, const uint8_t* bins, uint32_t count)
+{
+    block_reserve(block, count);
+    memcpy(block->bins, bins, count * sizeof(uint8_t));
+
+    memset(block->population, 0, sizeof(block->population));
+    for (uint32_t i = 0; i < count; ++i) {
+        block->population[block->bins[i]]++;
+    }
+}
+
+void block_timestep_step(struct block_timestep* block, struct bodies* bodies, struct gravity* gravity, struct thread_pool* pool, double dt)
+{
+    const uint32_t n = bodies->count;
+    const uint64_t ticks = bin_period(block, 0);
+    const double h = bin_dt(block->bin_count - 1, dt);
+
+    uint64_t tick = 0;
+    while (tick < ticks)
+    {
+        struct block_task task = {block, bodies, dt, tick};
+        thread_pool_parallel_for(pool, n, BLOCK_TIMESTEP_GRAIN, opening_kick_task, &task);
+
+        /* Skip straight to the next tick where some populated bin ends its step */
+        uint64_t next = ticks;
+        for (uint32_t bin = 0; bin < block->bin_count; ++bin) {
+            if (block->population[bin] > 0) {
+                const uint64_t period = bin_period(block, bin);
+                const uint64_t end = (tick / period + 1) * period;
+                next = end < next ? end : next;
+            }
+        }
+
+        struct block_task drift = {block, bodies, (double)(next - tick) * h, tick};
+        thread_pool_parallel_for(pool, n, BLOCK_TIMESTEP_GRAIN, drift_task, &drift);
+        tick = next;
+
+        uint32_t active = 0;
+        for (uint32_t i = 0; i < n; ++i) {
+            if (tick % bin_period(block, block->bins[i]) == 0) {
+                block->active[active++] = i;
+            }
+        }
+
+        gravity_prepare(gravity, bodies);
+        gravity_accelerations_subset(gravity, bodies, block->active, active);
+        block->force_evaluations += active;
+        block->substeps++;
+
+        for (uint32_t k = 0; k < active; ++k) {
+            block->steps[block->bins[block->active[k]]]++;
+        }
+
+        struct block_task closing = {block, bodies, dt, tick};
+        thread_pool_parallel_for(pool, active, BLOCK_TIMESTEP_GRAIN, closing_kick_task, &closing);
+
+        memset(block->population, 0, sizeof(block->population));
+        for (uint32_t i = 0; i < n; ++i) {
+            block->population[block->bins[i]]++;
+        }
+    }
+}
+
+void block_timestep_reset_stats(struct block_timestep* block)
+{
+    memset(block->steps, 0, sizeof(block->steps));
+    block->substeps = 0;
+    block->force_evaluations = 0;
+}
+
+void block_timestep_report(const struct block_timestep* block, FILE* out, double dt)
+{
+    uint64_t total = 0;
+    for (uint32_t bin = 0; bin < block->bin_count; ++bin) {
+        total += block->steps[bin];
+    }
+
+    fprintf(out, "Block timesteps: %" PRIu64 " substeps, %" PRIu64 " force evaluations\n", block->substeps, block->force_evaluations);
+    fprintf(out, "%4s %14s %10s %14s %8s\n", "bin", "dt", "bodies", "steps", "share");
+    for (uint32_t bin = 0; bin < block->bin_count; ++bin) {
+        if (block->population[bin] == 0 && block->steps[bin] == 0) {
+            continue;
+        }
+        fprintf(out, "%4" PRIu32 " %14.6g %10" PRIu32 " %14" PRIu64 " %7.2f%%\n", bin, bin_dt(bin, dt),
+                block->population[bin], block->steps[bin], total ? 100.0 * block->steps[bin] / total : 0.0);
+    }
+}
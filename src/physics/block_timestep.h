@@ -0,0 +1,46 @@
+#ifndef BLOCK_TIMESTEP_H
+#define BLOCK_TIMESTEP_H
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include "bodies.h"
+#include "gravity.h"
+
+#define BLOCK_TIMESTEP_MAX_BINS 24
+
+struct thread_pool;
+
+/* Power-of-two block timesteps: bin k steps with dt / 2^k. Each body is a
+ * kick-drift-kick leapfrog on its own bin, and only bodies whose step ends
+ * at a substep get their forces evaluated there. */
+struct block_timestep
+{
+    uint32_t bin_count;
+    double eta;
+
+    uint32_t capacity;
+    uint8_t* bins;
+    uint32_t* active;
+
+    /* Profiling counters, cleared by block_timestep_reset_stats */
+    uint32_t population[BLOCK_TIMESTEP_MAX_BINS];
+    uint64_t steps[BLOCK_TIMESTEP_MAX_BINS];
+    uint64_t substeps;
+    uint64_t force_evaluations;
+};
+
+void block_timestep_init(struct block_timestep* block, uint32_t bin_count, double eta);
+void block_timestep_free(struct block_timestep* block);
+
+/* Assigns every body its bin from fresh accelerations */
+void block_timestep_begin(struct block_timestep* block, struct bodies* bodies, struct gravity* gravity, double dt);
+/* Resumes from saved bins instead of assigning fresh ones */
+void block_timestep_restore(struct block_timestep* block, const uint8_t* bins, uint32_t count);
+void block_timestep_step(struct block_timestep* block, struct bodies* bodies, struct gravity* gravity, struct thread_pool* pool, double dt);
+
+void block_timestep_reset_stats(struct block_timestep* block);
+void block_timestep_report(const struct block_timestep* block, FILE* out, double dt);
+
+#endif
@@ -0,0 +1,164 @@
+#include "bodies.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../util/util.h"
+
+void bodies_arrays(struct bodies* bodies, double** arrays[BODIES_ARRAY_COUNT])
+{
+    arrays[0] = &bodies->x;
+    arrays[1] = &bodies->y;
+    arrays[2] = &bodies->z;
+    arrays[3] = &bodies->vx;
+    arrays[4] = &bodies->vy;
+    arrays[5] = &bodies->vz;
+    arrays[6] = &bodies->ax;
+    arrays[7] = &bodies->ay;
+    arrays[8] = &bodies->az;
+    arrays[9] = &bodies->mass;
+    arrays[10] = &bodies->radius;
+}
+
+static uint32_t round_up_lanes(uint32_t count)
+{
+    return (count + BODIES_LANES - 1) / BODIES_LANES * BODIES_LANES;
+}
+
+static void bodies_reallocate(struct bodies* bodies, uint32_t new_capacity)
+{
+    double** arrays[BODIES_ARRAY_COUNT];
+    bodies_arrays(bodies, arrays);
+
+    const size_t size = (size_t)new_capacity * sizeof(double);
+    for (uint32_t i = 0; i < BODIES_ARRAY_COUNT; ++i) {
+        double* data = util_allocate_aligned(BODIES_ALIGNMENT, size, "body storage");
+        memset(data, 0, size);
+        if (*arrays[i]) {
+            memcpy(data, *arrays[i], (size_t)bodies->count * sizeof(double));
+            free(*arrays[i]);
+        }
+        *arrays[i] = data;
+    }
+    bodies->capacity = new_capacity;
+}
+
+void bodies_init(struct bodies* bodies, uint32_t capacity)
+{
+    memset(bodies, 0, sizeof(*bodies));
+    bodies_reallocate(bodies, round_up_lanes(capacity > 0 ? capacity : BODIES_LANES));
+}
+
+void bodies_free(struct bodies* bodies)
+{
+    double** arrays[BODIES_ARRAY_COUNT];
+    bodies_arrays(bodies, arrays);
+    for (uint32_t i = 0; i < BODIES_ARRAY_COUNT; ++i) {
+        free(*arrays[i]);
+        *arrays[i] = NULL;
+    }
+    bodies->count = 0;
+    bodies->capacity = 0;
+}
+
+void bodies_clear(struct bodies* bodies)
+{
+    double** arrays[BODIES_ARRAY_COUNT];
+    bodies_arrays(bodies, arrays);
+    for (uint32_t i = 0; i < BODIES_ARRAY_COUNT; ++i) {
+        memset(*arrays[i], 0, (size_t)bodies->count * sizeof(double));
+    }
+    bodies->count = 0;
+}
+
+void bodies_reserve(struct bodies* bodies, uint32_t capacity)
+{
+    capacity = round_up_lanes(capacity);
+    if (capacity > bodies->capacity) {
+        bodies_reallocate(bodies, capacity);
+    }
+}
+
+uint32_t bodies_add(struct bodies* bodies, const double position[3], const double velocity[3], double mass, double radius)
+{
+    if (bodies->count >= bodies->capacity) {
+        /* A freed set has no capacity left to double */
+        bodies_reallocate(bodies, round_up_lanes(bodies->capacity ? 2 * bodies->capacity : BODIES_LANES));
+    }
+
+    const uint32_t i = bodies->count++;
+    bodies->x[i] = position[0];
+    bodies->y[i] = position[1];
+    bodies->z[i] = position[2];
+    bodies->vx[i] = velocity[0];
+    bodies->vy[i] = velocity[1];
+    bodies->vz[i] = velocity[2];
+    bodies->ax[i] = 0.0;
+    bodies->ay[i] = 0.0;
+    bodies->az[i] = 0.0;
+    bodies->mass[i] = mass;
+    bodies->radius[i] = radius;
+    return i;
+}
+
+uint32_t bodies_padded_count(const struct bodies* bodies)
+{
+    return round_up_lanes(bodies->count);
+}
+
+double bodies_total_mass(const struct bodies* bodies)
+{
+    double total = 0.0;
+    for (uint32_t i = 0; i < bodies->count; ++i) {
+        total += bodies->mass[i];
+    }
+    return total;
+}
+
+double bodies_kinetic_energy(const struct bodies* bodies)
+{
+    double energy = 0.0;
+    for (uint32_t i = 0; i < bodies->count; ++i) {
+        const double v2 = bodies->vx[i] * bodies->vx[i] + bodies->vy[i] * bodies->vy[i] + bodies->vz[i] * bodies->vz[i];
+        energy += 0.5 * bodies->mass[i] * v2;
+    }
+    return energy;
+}
+
+void bodies_center_of_mass(const struct bodies* bodies, double position[3], double velocity[3])
+{
+    double p[3] = {0.0, 0.0, 0.0};
+    double v[3] = {0.0, 0.0, 0.0};
+    double total = 0.0;
+    for (uint32_t i = 0; i < bodies->count; ++i) {
+        const double m = bodies->mass[i];
+        p[0] += m * bodies->x[i];
+        p[1] += m * bodies->y[i];
+        p[2] += m * bodies->z[i];
+        v[0] += m * bodies->vx[i];
+        v[1] += m * bodies->vy[i];
+        v[2] += m * bodies->vz[i];
+        total += m;
+    }
+
+    const double inv = total > 0.0 ? 1.0 / total : 0.0;
+    for (uint32_t k = 0; k < 3; ++k) {
+        if (position) position[k] = p[k] * inv;
+        if (velocity) velocity[k] = v[k] * inv;
+    }
+}
+
+void bodies_to_barycentric(struct bodies* bodies)
+{
+    double p[3], v[3];
+    bodies_center_of_mass(bodies, p, v);
+    for (uint32_t i = 0; i < bodies->count; ++i) {
+        bodies->x[i] -= p[0];
+        bodies->y[i] -= p[1];
+        bodies->z[i] -= p[2];
+        bodies->vx[i] -= v[0];
+        bodies->vy[i] -= v[1];
+        bodies->vz[i] -= v[2];
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef BODIES_H
+#define BODIES_H
+
+#include <inttypes.h>
+
+/* Arrays are aligned to BODIES_ALIGNMENT and padded to a multiple of
+ * BODIES_LANES entries; padding slots stay zeroed (massless) so SIMD kernels
+ * can run over the padded count without a scalar tail. */
+#define BODIES_ALIGNMENT 64
+#define BODIES_LANES 8
+#define BODIES_ARRAY_COUNT 11
+
+struct bodies
+{
+    uint32_t count;
+    uint32_t capacity;
+
+    double* x;
+    double* y;
+    double* z;
+
+    double* vx;
+    double* vy;
+    double* vz;
+
+    double* ax;
+    double* ay;
+    double* az;
+
+    double* mass;
+    double* radius;
+};
+
+void bodies_init(struct bodies* bodies, uint32_t capacity);
+void bodies_free(struct bodies* bodies);
+void bodies_clear(struct bodies* bodies);
+void bodies_reserve(struct bodies* bodies, uint32_t capacity);
+uint32_t bodies_add(struct bodies* bodies, const double position[3], const double velocity[3], double mass, double radius);
+uint32_t bodies_padded_count(const struct bodies* bodies);
+/* Every per-body array, x through radius, in declaration order */
+void bodies_arrays(struct bodies* bodies, double** arrays[BODIES_ARRAY_COUNT]);
+
+double bodies_total_mass(const struct bodies* bodies);
+double bodies_kinetic_energy(const struct bodies* bodies);
+void bodies_center_of_mass(const struct bodies* bodies, double position[3], double velocity[3]);
+void bodies_to_barycentric(struct bodies* bodies);
+
+#endif
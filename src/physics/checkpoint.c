@@ -0,0 +1,478 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "checkpoint.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "../util/util.h"
+
+/* The full snapshot's arrays start at the first 64 byte boundary after the header */
+#define CHECKPOINT_HEADER_SPACE ((sizeof(struct checkpoint_header) + 63) & ~(size_t)63)
+#define CHECKPOINT_MAX_ARRAYS (2 * BODIES_ARRAY_COUNT)
+
+static uint64_t checksum_update(uint64_t hash, const void* data, size_t size)
+{
+    /* Word-wise FNV-1a; every section is a multiple of 8 bytes */
+    const uint8_t* bytes = data;
+    for (size_t i = 0; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        hash = (hash ^ word) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+static uint32_t state_flags(const struct simulation* sim)
+{
+    const struct integrator* integrator = &sim->integrator;
+    if (!integrator->initialized) {
+        return 0;
+    }
+    uint32_t flags = CHECKPOINT_INITIALIZED;
+    if (integrator->type == INTEGRATOR_WISDOM_HOLMAN) {
+        flags |= CHECKPOINT_HELIO;
+    } else if (integrator->type == INTEGRATOR_BLOCK_LEAPFROG) {
+        flags |= CHECKPOINT_BINS;
+    }
+    return flags;
+}
+
+/* Every double array the flags say is saved, bodies first */
+static uint32_t state_arrays(struct bodies* bodies, struct bodies* helio, uint32_t flags, double* arrays[CHECKPOINT_MAX_ARRAYS])
+{
+    double** fields[BODIES_ARRAY_COUNT];
+    uint32_t count = 0;
+    bodies_arrays(bodies, fields);
+    for (uint32_t i = 0; i < BODIES_ARRAY_COUNT; ++i) {
+        arrays[count++] = *fields[i];
+    }
+    if (flags & CHECKPOINT_HELIO) {
+        bodies_arrays(helio, fields);
+        for (uint32_t i = 0; i < BODIES_ARRAY_COUNT; ++i) {
+            arrays[count++] = *fields[i];
+        }
+    }
+    return count;
+}
+
+static void fill_header(struct checkpoint_header* header, const struct simulation* sim, enum checkpoint_kind kind, uint32_t flags)
+{
+    memset(header, 0, sizeof(*header));
+    header->magic = CHECKPOINT_MAGIC;
+    header->version = CHECKPOINT_VERSION;
+    header->kind = kind;
+    header->flags = flags;
+    header->body_count = sim->bodies.count;
+    header->padded_count = bodies_padded_count(&sim->bodies);
+    header->integrator = sim->integrator.type;
+    header->solver = sim->gravity.solver;
+    header->steps = sim->steps;
+    header->time = sim->time;
+    header->dt = sim->dt;
+    header->g = sim->gravity.g;
+    header->softening = sim->gravity.softening;
+    header->theta = sim->gravity.octree.theta;
+    memcpy(header->com_position, sim->integrator.com_position, sizeof(header->com_position));
+    memcpy(header->com_velocity, sim->integrator.com_velocity, sizeof(header->com_velocity));
+}
+
+static void apply_header(struct simulation* sim, const struct checkpoint_header* header)
+{
+    sim->time = header->time;
+    sim->dt = header->dt;
+    sim->steps = header->steps;
+    sim->gravity.g = header->g;
+    sim->gravity.softening = header->softening;
+    gravity_set_solver(&sim->gravity, (enum gravity_solver)header->solver, header->theta);
+    sim->integrator.type = (enum integrator_type)header->integrator;
+    sim->integrator.initialized = (header->flags & CHECKPOINT_INITIALIZED) != 0;
+    memcpy(sim->integrator.com_position, header->com_position, sizeof(header->com_position));
+    memcpy(sim->integrator.com_velocity, header->com_velocity, sizeof(header->com_velocity));
+}
+
+static void reserve_buffer(struct checkpoint* checkpoint, size_t size)
+{
+    if (size <= checkpoint->buffer_capacity) {
+        return;
+    }
+    free(checkpoint->buffer);
+    checkpoint->buffer = util_allocate(size, "the checkpoint buffer");
+    checkpoint->buffer_capacity = size;
+}
+
+static bool write_vectors(int fd, struct iovec* vectors, int count)
+{
+    size_t total = 0;
+    for (int i = 0; i < count; ++i) {
+        total += vectors[i].iov_len;
+    }
+    /* Regular files only write short when the disk is full */
+    const ssize_t written = writev(fd, vectors, count);
+    return written >= 0 && (size_t)written == total;
+}
+
+struct vector_list
+{
+    struct iovec* vectors;
+    int count;
+};
+
+/* Nothing goes through the stream's buffer, so the descriptor is written directly */
+static bool write_snapshot(FILE* file, void* context)
+{
+    const struct vector_list* list = context;
+    return write_vectors(fileno(file), list->vectors, list->count);
+}
+
+void checkpoint_init(struct checkpoint* checkpoint, const char* path, uint32_t full_interval)
+{
+    memset(checkpoint, 0, sizeof(*checkpoint));
+    if ((size_t)snprintf(checkpoint->path, sizeof(checkpoint->path), "%s", path) >= sizeof(checkpoint->path)) {
+        fputs("Checkpoint path is too long!\n", stderr);
+        abort();
+    }
+    snprintf(checkpoint->delta_path, sizeof(checkpoint->delta_path), "%s.delta", path);
+    checkpoint->full_interval = full_interval;
+    bodies_init(&checkpoint->reference, 0);
+    bodies_init(&checkpoint->reference_helio, 0);
+}
+
+void checkpoint_free(struct checkpoint* checkpoint)
+{
+    bodies_free(&checkpoint->reference);
+    bodies_free(&checkpoint->reference_helio);
+    free(checkpoint->buffer);
+    checkpoint->buffer = NULL;
+    checkpoint->buffer_capacity = 0;
+}
+
+static void copy_state(struct bodies* target, struct bodies* target_helio, struct bodies* bodies, struct bodies* helio, uint32_t flags)
+{
+    const uint32_t padded = bodies_padded_count(bodies);
+    bodies_clear(target);
+    bodies_clear(target_helio);
+    bodies_reserve(target, padded);
+    target->count = bodies->count;
+    if (flags & CHECKPOINT_HELIO) {
+        bodies_reserve(target_helio, padded);
+        target_helio->count = bodies->count;
+    }
+
+    double* from[CHECKPOINT_MAX_ARRAYS];
+    double* to[CHECKPOINT_MAX_ARRAYS];
+    const uint32_t count = state_arrays(bodies, helio, flags, from);
+    state_arrays(target, target_helio, flags, to);
+    for (uint32_t i = 0; i < count; ++i) {
+        memcpy(to[i], from[i], padded * sizeof(double));
+    }
+}
+
+static bool write_full(struct checkpoint* checkpoint, struct simulation* sim, uint32_t flags)
+{
+    /* Realtime nanoseconds, so deltas left over from an older snapshot never match */
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    const uint64_t id = (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+    checkpoint->id = id > checkpoint->id ? id : checkpoint->id + 1;
+
+    double* arrays[CHECKPOINT_MAX_ARRAYS];
+    const uint32_t array_count = state_arrays(&sim->bodies, &sim->integrator.helio, flags, arrays);
+    const uint32_t padded = bodies_padded_count(&sim->bodies);
+
+    uint8_t head[CHECKPOINT_HEADER_SPACE];
+    memset(head, 0, sizeof(head));
+    struct checkpoint_header header;
+    fill_header(&header, sim, CHECKPOINT_FULL, flags);
+    header.id = checkpoint->id;
+    header.sequence = 0;
+
+    struct iovec vectors[CHECKPOINT_MAX_ARRAYS + 2];
+    int vector_count = 0;
+    vectors[vector_count++] = (struct iovec){head, sizeof(head)};
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (uint32_t i = 0; i < array_count; ++i) {
+        vectors[vector_count++] = (struct iovec){arrays[i], padded * sizeof(double)};
+        hash = checksum_update(hash, arrays[i], padded * sizeof(double));
+    }
+    if (flags & CHECKPOINT_BINS) {
+        /* Bins past the body count are never read, but the section is padded */
+        reserve_buffer(checkpoint, padded);
+        memset(checkpoint->buffer, 0, padded);
+        memcpy(checkpoint->buffer, sim->integrator.block.bins, sim->bodies.count);
+        vectors[vector_count++] = (struct iovec){checkpoint->buffer, padded};
+        hash = checksum_update(hash, checkpoint->buffer, padded);
+    }
+    header.payload_size = (uint64_t)array_count * padded * sizeof(double) + ((flags & CHECKPOINT_BINS) ? padded : 0);
+    header.checksum = hash;
+    memcpy(head, &header, sizeof(header));
+
+    /* A kill mid-write keeps the previous snapshot */
+    struct vector_list list = {vectors, vector_count};
+    if (!util_write_file(checkpoint->path, write_snapshot, &list)) {
+        return false;
+    }
+    /* The old deltas belong to the snapshot just replaced */
+    unlink(checkpoint->delta_path);
+
+    copy_state(&checkpoint->reference, &checkpoint->reference_helio, &sim->bodies, &sim->integrator.helio, flags);
+    checkpoint->sequence = 0;
+    checkpoint->last_bytes = sizeof(head) + header.payload_size;
+    return true;
+}
+
+static bool write_delta(struct checkpoint* checkpoint, struct simulation* sim, uint32_t flags)
+{
+    double* arrays[CHECKPOINT_MAX_ARRAYS];
+    double* references[CHECKPOINT_MAX_ARRAYS];
+    const uint32_t array_count = state_arrays(&sim->bodies, &sim->integrator.helio, flags, arrays);
+    state_arrays(&checkpoint->reference, &checkpoint->reference_helio, flags, references);
+    const uint32_t padded = bodies_padded_count(&sim->bodies);
+
+    const size_t bins_size = (flags & CHECKPOINT_BINS) ? padded : 0;
+    const size_t value_count = (size_t)array_count * padded;
+    const size_t control_size = (value_count + 1) / 2;
+    /* Worst case every byte is kept; 8 bytes of slack for the unaligned stores */
+    reserve_buffer(checkpoint, bins_size + control_size + value_count * 8 + 16);
+
+    uint8_t* bins = checkpoint->buffer;
+    uint8_t* control = bins + bins_size;
+    uint8_t* data = control + control_size;
+    memset(bins, 0, bins_size + control_size);
+    if (bins_size > 0) {
+        memcpy(bins, sim->integrator.block.bins, sim->bodies.count);
+    }
+
+    /* The reference becomes the state just written as it is encoded */
+    uint8_t* out = data;
+    size_t value = 0;
+    for (uint32_t a = 0; a < array_count; ++a)
+    {
+        const double* current = arrays[a];
+        double* reference = references[a];
+        for (uint32_t i = 0; i < padded; ++i, ++value) {
+            uint64_t bits, previous;
+            memcpy(&bits, &current[i], sizeof(bits));
+            memcpy(&previous, &reference[i], sizeof(previous));
+            reference[i] = current[i];
+
+            const uint64_t difference = bits ^ previous;
+            const uint32_t kept = difference ? 8 - (uint32_t)(__builtin_clzll(difference) >> 3) : 0;
+            control[value >> 1] |= (uint8_t)(kept << ((value & 1) * 4));
+            memcpy(out, &difference, sizeof(difference));
+            out += kept;
+        }
+    }
+
+    size_t payload_size = (size_t)(out - checkpoint->buffer);
+    const size_t padding = (8 - payload_size % 8) % 8;
+    memset(out, 0, padding);
+    payload_size += padding;
+
+    struct checkpoint_header header;
+    fill_header(&header, sim, CHECKPOINT_DELTA, flags);
+    header.id = checkpoint->id;
+    header.sequence = checkpoint->sequence + 1;
+    header.payload_size = payload_size;
+    header.control_size = control_size;
+    header.checksum = checksum_update(0xCBF29CE484222325ull, checkpoint->buffer, payload_size);
+
+    struct iovec vectors[2] = {{&header, sizeof(header)}, {checkpoint->buffer, payload_size}};
+    const int fd = open(checkpoint->delta_path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    const bool written = write_vectors(fd, vectors, 2);
+    if (close(fd) != 0 || !written) {
+        return false;
+    }
+
+    checkpoint->sequence = header.sequence;
+    checkpoint->last_bytes = sizeof(header) + payload_size;
+    return true;
+}
+
+bool checkpoint_write(struct checkpoint* checkpoint, struct simulation* sim)
+{
+    const uint32_t flags = state_flags(sim);
+    const bool full = !checkpoint->has_reference || checkpoint->sequence >= checkpoint->full_interval ||
+                      flags != checkpoint->reference_flags || sim->bodies.count != checkpoint->reference.count;
+
+    const bool written = full ? write_full(checkpoint, sim, flags) : write_delta(checkpoint, sim, flags);
+    /* After a failure the file and the reference may disagree, so start over */
+    checkpoint->has_reference = written;
+    checkpoint->reference_flags = flags;
+    checkpoint->last_kind = full ? CHECKPOINT_FULL : CHECKPOINT_DELTA;
+    return written;
+}
+
+static const uint8_t* map_file(const char* path, size_t* size)
+{
+    const int fd = open(path, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0 || info.st_size == 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+    *size = (size_t)info.st_size;
+    const uint8_t* mapping = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    return mapping == MAP_FAILED ? NULL : mapping;
+}
+
+static bool header_matches(const struct checkpoint_header* header, enum checkpoint_kind kind)
+{
+    const uint32_t padded = (header->body_count + BODIES_LANES - 1) / BODIES_LANES * BODIES_LANES;
+    return header->magic == CHECKPOINT_MAGIC && header->version == CHECKPOINT_VERSION && header->kind == kind &&
+           header->padded_count == padded && header->body_count > 0 && header->payload_size % 8 == 0 &&
+           header->integrator < INTEGRATOR_COUNT && header->solver < GRAVITY_SOLVER_COUNT;
+}
+
+/* The bins index the block timestep's per-bin tables */
+static bool bins_valid(const uint8_t* bins, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; ++i) {
+        if (bins[i] >= BLOCK_TIMESTEP_MAX_BINS) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Applies the deltas after a full snapshot; a torn or foreign record ends the chain */
+static uint64_t restore_deltas(struct simulation* sim, const char* path, const struct checkpoint_header* full)
+{
+    size_t size = 0;
+    const uint8_t* mapping = map_file(path, &size);
+    if (!mapping) {
+        return 0;
+    }
+
+    double* arrays[CHECKPOINT_MAX_ARRAYS];
+    const uint32_t array_count = state_arrays(&sim->bodies, &sim->integrator.helio, full->flags, arrays);
+    const uint32_t padded = full->padded_count;
+    const size_t bins_size = (full->flags & CHECKPOINT_BINS) ? padded : 0;
+    const size_t value_count = (size_t)array_count * padded;
+
+    uint64_t sequence = 0;
+    size_t offset = 0;
+    while (size - offset >= sizeof(struct checkpoint_header))
+    {
+        struct checkpoint_header header;
+        memcpy(&header, mapping + offset, sizeof(header));
+        const uint8_t* payload = mapping + offset + sizeof(header);
+        if (!header_matches(&header, CHECKPOINT_DELTA) || header.id != full->id || header.sequence != sequence + 1 ||
+            header.body_count != full->body_count || header.flags != full->flags ||
+            header.payload_size > size - offset - sizeof(header) ||
+            header.control_size != (value_count + 1) / 2 || bins_size + header.control_size > header.payload_size ||
+            checksum_update(0xCBF29CE484222325ull, payload, header.payload_size) != header.checksum ||
+            (bins_size > 0 && !bins_valid(payload, header.body_count)))
+        {
+            break;
+        }
+
+        const uint8_t* control = payload + bins_size;
+        const uint8_t* data = control + header.control_size;
+        const uint8_t* end = payload + header.payload_size;
+        bool intact = true;
+        size_t value = 0;
+        for (uint32_t a = 0; intact && a < array_count; ++a) {
+            for (uint32_t i = 0; i < padded; ++i, ++value) {
+                const uint32_t kept = (control[value >> 1] >> ((value & 1) * 4)) & 15;
+                if (kept > 8 || kept > (size_t)(end - data)) {
+                    intact = false;
+                    break;
+                }
+                uint64_t difference = 0, bits;
+                memcpy(&difference, data, kept);
+                data += kept;
+                memcpy(&bits, &arrays[a][i], sizeof(bits));
+                bits ^= difference;
+                memcpy(&arrays[a][i], &bits, sizeof(bits));
+            }
+        }
+        if (!intact) {
+            /* The checksum matched, so this is a writer bug rather than a torn tail */
+            fprintf(stderr, "Checkpoint delta %" PRIu64 " in '%s' does not decode!\n", header.sequence, path);
+            break;
+        }
+
+        if (bins_size > 0) {
+            block_timestep_restore(&sim->integrator.block, payload, header.body_count);
+        }
+        apply_header(sim, &header);
+        sequence = header.sequence;
+        offset += sizeof(header) + header.payload_size;
+    }
+
+    munmap((void*)mapping, size);
+    return sequence;
+}
+
+bool checkpoint_restore(struct simulation* sim, const char* path, uint64_t* deltas)
+{
+    size_t size = 0;
+    const uint8_t* mapping = map_file(path, &size);
+    if (!mapping) {
+        fprintf(stderr, "Failed to open the checkpoint '%s'!\n", path);
+        return false;
+    }
+
+    struct checkpoint_header header;
+    const bool large_enough = size >= CHECKPOINT_HEADER_SPACE;
+    if (large_enough) {
+        memcpy(&header, mapping, sizeof(header));
+    }
+    const uint32_t arrays = BODIES_ARRAY_COUNT * ((large_enough && (header.flags & CHECKPOINT_HELIO)) ? 2 : 1);
+    const bool valid = large_enough && header_matches(&header, CHECKPOINT_FULL) &&
+                       header.payload_size == (uint64_t)arrays * header.padded_count * sizeof(double) +
+                                              ((header.flags & CHECKPOINT_BINS) ? header.padded_count : 0) &&
+                       header.payload_size <= size - CHECKPOINT_HEADER_SPACE &&
+                       checksum_update(0xCBF29CE484222325ull, mapping + CHECKPOINT_HEADER_SPACE, header.payload_size) == header.checksum &&
+                       (!(header.flags & CHECKPOINT_BINS) ||
+                        bins_valid(mapping + CHECKPOINT_HEADER_SPACE + header.payload_size - header.padded_count, header.body_count));
+    if (!valid) {
+        fprintf(stderr, "Checkpoint '%s' is corrupt or from another version!\n", path);
+        munmap((void*)mapping, size);
+        return false;
+    }
+
+    /* Clearing first keeps every slot past the restored bodies zeroed */
+    struct bodies* bodies = &sim->bodies;
+    struct bodies* helio = &sim->integrator.helio;
+    bodies_clear(bodies);
+    bodies_clear(helio);
+    bodies_reserve(bodies, header.padded_count);
+    bodies->count = header.body_count;
+    if (header.flags & CHECKPOINT_HELIO) {
+        bodies_reserve(helio, header.padded_count);
+        helio->count = header.body_count;
+    }
+
+    double* targets[CHECKPOINT_MAX_ARRAYS];
+    const uint32_t count = state_arrays(bodies, helio, header.flags, targets);
+    const uint8_t* section = mapping + CHECKPOINT_HEADER_SPACE;
+    for (uint32_t i = 0; i < count; ++i) {
+        memcpy(targets[i], section, header.padded_count * sizeof(double));
+        section += header.padded_count * sizeof(double);
+    }
+    if (header.flags & CHECKPOINT_BINS) {
+        block_timestep_restore(&sim->integrator.block, section, header.body_count);
+    }
+    apply_header(sim, &header);
+    munmap((void*)mapping, size);
+
+    char delta_path[520];
+    snprintf(delta_path, sizeof(delta_path), "%s.delta", path);
+    *deltas = restore_deltas(sim, delta_path, &header);
+    return true;
+}
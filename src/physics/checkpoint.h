@@ -0,0 +1,108 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stddef.h>
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include "bodies.h"
+#include "simulation.h"
+
+/*
+ * Checkpoints of the whole simulation state: the body arrays, time and
+ * integrator state, so a restored run continues bit for bit. A full
+ * snapshot is the header followed by the padded SoA arrays at 64 byte
+ * offsets, written with a single writev and restored from a mapping with
+ * one memcpy per array. Between full snapshots, deltas are appended to
+ * <path>.delta: every value XOR the previous checkpoint, with its leading
+ * zero bytes dropped and the kept byte count in a nibble stream. Only the
+ * sign, exponent and top mantissa bits of a moving body stay the same
+ * between checkpoints, so its values keep about 6 bytes each and a delta
+ * is ~60% of a full snapshot; the rest is noise no byte coder shrinks.
+ */
+
+#define CHECKPOINT_MAGIC 0x4B435353u /* "SSCK" */
+#define CHECKPOINT_VERSION 1
+
+enum checkpoint_kind
+{
+    CHECKPOINT_FULL = 0,
+    CHECKPOINT_DELTA
+};
+
+enum checkpoint_flags
+{
+    CHECKPOINT_INITIALIZED = 1 << 0,
+    /* Wisdom-Holman heliocentric arrays follow the body arrays */
+    CHECKPOINT_HELIO = 1 << 1,
+    /* Block leapfrog bins, one byte per padded body */
+    CHECKPOINT_BINS = 1 << 2
+};
+
+struct checkpoint_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t kind;
+    uint32_t flags;
+
+    uint32_t body_count;
+    uint32_t padded_count;
+    uint32_t integrator;
+    uint32_t solver;
+
+    /* Identifies the full snapshot; its deltas carry the same id */
+    uint64_t id;
+    /* 0 for the full snapshot, then 1, 2, ... for each delta after it */
+    uint64_t sequence;
+    uint64_t steps;
+    /* Bytes after the header; deltas split them into bins, nibbles and XOR bytes */
+    uint64_t payload_size;
+    uint64_t control_size;
+    uint64_t checksum;
+
+    double time;
+    double dt;
+    double g;
+    double softening;
+    double theta;
+    double com_position[3];
+    double com_velocity[3];
+};
+
+struct checkpoint
+{
+    char path[512];
+    char delta_path[520];
+    /* Deltas written before the next full snapshot */
+    uint32_t full_interval;
+
+    uint64_t id;
+    uint64_t sequence;
+
+    /* The state as of the last checkpoint, which the next delta is taken against */
+    bool has_reference;
+    uint32_t reference_flags;
+    struct bodies reference;
+    struct bodies reference_helio;
+
+    uint8_t* buffer;
+    size_t buffer_capacity;
+
+    /* Of the last write */
+    enum checkpoint_kind last_kind;
+    size_t last_bytes;
+};
+
+void checkpoint_init(struct checkpoint* checkpoint, const char* path, uint32_t full_interval);
+void checkpoint_free(struct checkpoint* checkpoint);
+
+/* Writes a full snapshot or a delta, whichever is due */
+bool checkpoint_write(struct checkpoint* checkpoint, struct simulation* sim);
+
+/* Loads path and then every intact delta of it from path.delta into an
+ * initialized simulation, counting the deltas applied. Thread pool and
+ * ephemeris are left as they are. */
+bool checkpoint_restore(struct simulation* sim, const char* path, uint64_t* deltas);
+
+#endif
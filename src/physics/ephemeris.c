@@ -0,0 +1,242 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "ephemeris.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../util/cpu.h"
+#include "../util/util.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define EPHEMERIS_HAS_X86 1
+#include <immintrin.h>
+#else
+#define EPHEMERIS_HAS_X86 0
+#endif
+
+bool ephemeris_open(struct ephemeris* eph, const char* path)
+{
+    memset(eph, 0, sizeof(*eph));
+
+    int fd = open(path, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(struct ephemeris_header)) {
+        fprintf(stderr, "Failed to open the ephemeris '%s'!\n", path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+
+    const size_t size = (size_t)info.st_size;
+    const uint8_t* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        fprintf(stderr, "Failed to map the ephemeris '%s'!\n", path);
+        return false;
+    }
+
+    struct ephemeris_header header;
+    memcpy(&header, mapping, sizeof(header));
+    bool valid = header.magic == EPHEMERIS_MAGIC && header.version == EPHEMERIS_VERSION && header.body_count > 0 &&
+                 header.end > header.start && size >= sizeof(header) + header.body_count * sizeof(struct ephemeris_body);
+
+    const struct ephemeris_body* bodies = (const struct ephemeris_body*)(mapping + sizeof(header));
+    for (uint32_t i = 0; valid && i < header.body_count; ++i)
+    {
+        const struct ephemeris_body* body = &bodies[i];
+        const uint64_t bytes = (uint64_t)body->segment_count * body->coefficient_count * 4 * sizeof(double);
+        valid = body->coefficient_count > 0 && body->coefficient_count <= EPHEMERIS_MAX_COEFFICIENTS &&
+                body->segment_count > 0 && body->segment_days > 0.0 && body->offset % 32 == 0 &&
+                body->offset <= size && bytes <= size - body->offset &&
+                header.start + body->segment_count * body->segment_days >= header.end;
+    }
+    if (!valid) {
+        fprintf(stderr, "Ephemeris '%s' is corrupt or from another version!\n", path);
+        munmap((void*)mapping, size);
+        return false;
+    }
+
+    eph->mapping = mapping;
+    eph->size = size;
+    eph->body_count = header.body_count;
+    eph->start = header.start;
+    eph->end = header.end;
+    eph->bodies = bodies;
+    eph->avx2 = (cpu_features() & CPU_FEATURE_AVX2) && (cpu_features() & CPU_FEATURE_FMA);
+    return true;
+}
+
+void ephemeris_close(struct ephemeris* eph)
+{
+    if (eph->mapping) {
+        munmap((void*)eph->mapping, eph->size);
+    }
+    memset(eph, 0, sizeof(*eph));
+}
+
+bool ephemeris_covers(const struct ephemeris* eph, double time)
+{
+    return time >= eph->start && time <= eph->end;
+}
+
+/* Bodies are evaluated four at a time: the T and U recurrences are latency
+ * bound chains, so the four bodies' bases share one chain in lanes. T'_k is
+ * k U_(k-1), which keeps the derivative basis off the T chain. Inlined so
+ * the AVX2 path never calls into SSE code with dirty upper registers. */
+__attribute__((always_inline))
+static inline uint32_t group_basis(const struct ephemeris* eph, uint32_t first, uint32_t lanes, double elapsed,
+                                   double t[][4], double d[][4], const double** rows)
+{
+    double s2[4] = {0.0, 0.0, 0.0, 0.0};
+    uint32_t n = 2;
+    for (uint32_t lane = 0; lane < lanes; ++lane)
+    {
+        const struct ephemeris_body* body = &eph->bodies[first + lane];
+        uint32_t segment = (uint32_t)(elapsed / body->segment_days);
+        segment = segment < body->segment_count ? segment : body->segment_count - 1;
+        s2[lane] = 4.0 * (elapsed - segment * body->segment_days) / body->segment_days - 2.0;
+        rows[lane] = (const double*)(eph->mapping + body->offset + (size_t)segment * body->coefficient_count * 4 * sizeof(double));
+        n = body->coefficient_count > n ? body->coefficient_count : n;
+    }
+
+    double t1[4], t2[4], u1[4], u2[4];
+    for (uint32_t lane = 0; lane < 4; ++lane) {
+        t[0][lane] = t1[lane] = 1.0;
+        t[1][lane] = t2[lane] = 0.5 * s2[lane];
+        d[0][lane] = 0.0;
+        d[1][lane] = u1[lane] = 1.0;
+        u2[lane] = s2[lane];
+    }
+    for (uint32_t k = 2; k < n; ++k) {
+        for (uint32_t lane = 0; lane < 4; ++lane) {
+            d[k][lane] = k * u2[lane];
+            const double t3 = s2[lane] * t2[lane] - t1[lane];
+            const double u3 = s2[lane] * u2[lane] - u1[lane];
+            t[k][lane] = t3;
+            t1[lane] = t2[lane];
+            t2[lane] = t3;
+            u1[lane] = u2[lane];
+            u2[lane] = u3;
+        }
+    }
+    return n;
+}
+
+__attribute__((always_inline))
+static inline void store_state(const struct ephemeris_body* body, uint32_t i, const double* p, const double* q,
+                               double* x, double* y, double* z, double* vx, double* vy, double* vz)
+{
+    x[i] = p[0];
+    y[i] = p[1];
+    z[i] = p[2];
+    if (vx) {
+        /* ds/dt maps the segment onto [-1, 1] */
+        const double scale = 2.0 / body->segment_days;
+        vx[i] = q[0] * scale;
+        vy[i] = q[1] * scale;
+        vz[i] = q[2] * scale;
+    }
+}
+
+static void evaluate_scalar(const struct ephemeris* eph, double elapsed, uint32_t count, double* x, double* y, double* z,
+                            double* vx, double* vy, double* vz)
+{
+    for (uint32_t first = 0; first < count; first += 4)
+    {
+        const uint32_t lanes = count - first < 4 ? count - first : 4;
+        double t[EPHEMERIS_MAX_COEFFICIENTS][4];
+        double d[EPHEMERIS_MAX_COEFFICIENTS][4];
+        const double* rows[4];
+        group_basis(eph, first, lanes, elapsed, t, d, rows);
+
+        for (uint32_t lane = 0; lane < lanes; ++lane)
+        {
+            const struct ephemeris_body* body = &eph->bodies[first + lane];
+            const double* c = rows[lane];
+            double p[3] = {0.0, 0.0, 0.0};
+            double q[3] = {0.0, 0.0, 0.0};
+            for (uint32_t k = 0; k < body->coefficient_count; ++k, c += 4) {
+                for (uint32_t axis = 0; axis < 3; ++axis) {
+                    p[axis] += c[axis] * t[k][lane];
+                    q[axis] += c[axis] * d[k][lane];
+                }
+            }
+            store_state(body, first + lane, p, q, x, y, z, vx, vy, vz);
+        }
+    }
+}
+
+#if EPHEMERIS_HAS_X86
+/* One row per order is x, y, z and a pad lane: a single aligned load */
+__attribute__((target("avx2,fma")))
+static void evaluate_avx2(const struct ephemeris* eph, double elapsed, uint32_t count, double* x, double* y, double* z,
+                          double* vx, double* vy, double* vz)
+{
+    for (uint32_t first = 0; first < count; first += 4)
+    {
+        const uint32_t lanes = count - first < 4 ? count - first : 4;
+        double t[EPHEMERIS_MAX_COEFFICIENTS][4] __attribute__((aligned(32)));
+        double d[EPHEMERIS_MAX_COEFFICIENTS][4] __attribute__((aligned(32)));
+        const double* rows[4];
+        group_basis(eph, first, lanes, elapsed, t, d, rows);
+
+        for (uint32_t lane = 0; lane < lanes; ++lane)
+        {
+            const struct ephemeris_body* body = &eph->bodies[first + lane];
+            const double* c = rows[lane];
+            __m256d position = _mm256_setzero_pd();
+            __m256d velocity = _mm256_setzero_pd();
+            for (uint32_t k = 0; k < body->coefficient_count; ++k, c += 4) {
+                const __m256d row = _mm256_load_pd(c);
+                position = _mm256_fmadd_pd(row, _mm256_broadcast_sd(&t[k][lane]), position);
+                velocity = _mm256_fmadd_pd(row, _mm256_broadcast_sd(&d[k][lane]), velocity);
+            }
+
+            double p[4], q[4];
+            _mm256_storeu_pd(p, position);
+            _mm256_storeu_pd(q, velocity);
+            store_state(body, first + lane, p, q, x, y, z, vx, vy, vz);
+        }
+    }
+}
+#endif
+
+void ephemeris_evaluate(const struct ephemeris* eph, double time, uint32_t count, double* x, double* y, double* z,
+                        double* vx, double* vy, double* vz)
+{
+    count = count < eph->body_count ? count : eph->body_count;
+    time = time < eph->start ? eph->start : time > eph->end ? eph->end : time;
+    const double elapsed = time - eph->start;
+#if EPHEMERIS_HAS_X86
+    if (eph->avx2) {
+        evaluate_avx2(eph, elapsed, count, x, y, z, vx, vy, vz);
+        return;
+    }
+#endif
+    evaluate_scalar(eph, elapsed, count, x, y, z, vx, vy, vz);
+}
+
+double chebyshev_node(uint32_t index, uint32_t count)
+{
+    return cos(M_PI * (index + 0.5) / count);
+}
+
+void chebyshev_fit(const double* values, uint32_t count, double* coefficients)
+{
+    /* Interpolation at the nodes is a DCT-II; the series is near-minimax */
+    for (uint32_t k = 0; k < count; ++k)
+    {
+        double sum = 0.0;
+        for (uint32_t j = 0; j < count; ++j) {
+            sum += values[j] * cos(M_PI * k * (j + 0.5) / count);
+        }
+        coefficients[k] = (k == 0 ? 1.0 : 2.0) * sum / count;
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef EPHEMERIS_H
+#define EPHEMERIS_H
+
+#include <stddef.h>
+#include <inttypes.h>
+#include <stdbool.h>
+
+/*
+ * Precomputed body positions as piecewise Chebyshev series, in the spirit of
+ * JPL SPK type 2 files. Every body has its own uniform segment length; a
+ * segment stores coefficients for x, y and z interleaved per order (plus a
+ * pad lane) so one evaluation is four-wide. Files are mapped, not read.
+ */
+
+#define EPHEMERIS_MAGIC 0x50455353u /* "SSEP" */
+#define EPHEMERIS_VERSION 1
+#define EPHEMERIS_MAX_COEFFICIENTS 32
+
+struct ephemeris_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t body_count;
+    uint32_t reserved;
+    /* Days; every body covers [start, end] */
+    double start;
+    double end;
+};
+
+/* One per body, directly after the header */
+struct ephemeris_body
+{
+    double mass;
+    double radius;
+    double segment_days;
+    uint32_t segment_count;
+    uint32_t coefficient_count;
+    /* Byte offset of segment_count * coefficient_count * 4 doubles, 32 byte aligned */
+    uint64_t offset;
+};
+
+struct ephemeris
+{
+    const uint8_t* mapping;
+    size_t size;
+
+    uint32_t body_count;
+    double start;
+    double end;
+
+    const struct ephemeris_body* bodies;
+
+    /* Evaluate with AVX2/FMA, picked once from cpu_features */
+    bool avx2;
+};
+
+bool ephemeris_open(struct ephemeris* eph, const char* path);
+void ephemeris_close(struct ephemeris* eph);
+
+bool ephemeris_covers(const struct ephemeris* eph, double time);
+
+/* Barycentric positions [AU] and velocities [AU/day] of the first count
+ * bodies at time, clamped to the covered span; velocities may be NULL */
+void ephemeris_evaluate(const struct ephemeris* eph, double time, uint32_t count, double* x, double* y, double* z,
+                        double* vx, double* vy, double* vz);
+
+/* Chebyshev coefficients of the series through values sampled at the
+ * count Chebyshev nodes returned by chebyshev_node, in the same order */
+double chebyshev_node(uint32_t index, uint32_t count);
+void chebyshev_fit(const double* values, uint32_t count, double* coefficients);
+
+#endif
@@ -0,0 +1,75 @@
+#include "force_report.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../util/timer.h"
+#include "../util/util.h"
+
+static int compare_double(const void* a, const void* b)
+{
+    const double x = *(const double*)a;
+    const double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double time_accelerations(struct gravity* gravity, struct bodies* bodies)
+{
+    /* Repeat until the measurement is long enough to be meaningful */
+    uint32_t runs = 0;
+    const double start = timer_now();
+    double elapsed;
+    do {
+        gravity_accelerations(gravity, bodies);
+        runs++;
+        elapsed = timer_now() - start;
+    } while (elapsed < 0.2 && runs < 100);
+    return elapsed / runs;
+}
+
+void force_report(FILE* out, struct gravity* gravity, struct bodies* bodies, const double* thetas, uint32_t theta_count)
+{
+    const uint32_t n = bodies->count;
+    const enum gravity_solver solver = gravity->solver;
+    const double theta = gravity->octree.theta;
+
+    double* reference = util_allocate(3 * (size_t)n * sizeof(double), "force report buffers");
+    double* errors = util_allocate((size_t)n * sizeof(double), "force report buffers");
+
+    gravity_set_solver(gravity, GRAVITY_SOLVER_DIRECT, theta);
+    const double direct_time = time_accelerations(gravity, bodies);
+    memcpy(reference + 0 * (size_t)n, bodies->ax, n * sizeof(double));
+    memcpy(reference + 1 * (size_t)n, bodies->ay, n * sizeof(double));
+    memcpy(reference + 2 * (size_t)n, bodies->az, n * sizeof(double));
+
+    fprintf(out, "Force solver report: %" PRIu32 " bodies, direct kernel %s\n", n, gravity_kernel_name(gravity->kernel));
+    fprintf(out, "%-12s %8s %12s %10s %12s %12s %12s\n", "solver", "theta", "time [ms]", "speedup", "mean err", "p99 err", "max err");
+    fprintf(out, "%-12s %8s %12.3f %10.2f %12s %12s %12s\n", "direct", "-", 1e3 * direct_time, 1.0, "-", "-", "-");
+
+    for (uint32_t t = 0; t < theta_count; ++t)
+    {
+        gravity_set_solver(gravity, GRAVITY_SOLVER_BARNES_HUT, thetas[t]);
+        const double tree_time = time_accelerations(gravity, bodies);
+
+        double mean = 0.0;
+        for (uint32_t i = 0; i < n; ++i) {
+            const double rx = reference[i], ry = reference[n + i], rz = reference[2 * n + i];
+            const double dx = bodies->ax[i] - rx, dy = bodies->ay[i] - ry, dz = bodies->az[i] - rz;
+            const double magnitude = sqrt(rx * rx + ry * ry + rz * rz);
+            errors[i] = magnitude > 0.0 ? sqrt(dx * dx + dy * dy + dz * dz) / magnitude : 0.0;
+            mean += errors[i];
+        }
+        qsort(errors, n, sizeof(double), compare_double);
+
+        fprintf(out, "%-12s %8.2f %12.3f %10.2f %12.3e %12.3e %12.3e\n", "barnes-hut", thetas[t], 1e3 * tree_time, direct_time / tree_time,
+                n ? mean / n : 0.0, n ? errors[(uint32_t)(0.99 * (n - 1))] : 0.0, n ? errors[n - 1] : 0.0);
+    }
+
+    /* Leave the caller's solver selected with accelerations it expects */
+    gravity_set_solver(gravity, solver, theta);
+    gravity_accelerations(gravity, bodies);
+
+    free(errors);
+    free(reference);
+}
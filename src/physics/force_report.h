@@ -0,0 +1,14 @@
+#ifndef FORCE_REPORT_H
+#define FORCE_REPORT_H
+
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "bodies.h"
+#include "gravity.h"
+
+/* Compares Barnes-Hut at each opening angle against direct summation and
+ * prints timing and relative acceleration error per angle. */
+void force_report(FILE* out, struct gravity* gravity, struct bodies* bodies, const double* thetas, uint32_t theta_count);
+
+#endif
@@ -0,0 +1,306 @@
+#include "gravity.h"
+
+#include <math.h>
+
+#include "../util/cpu.h"
+#include "../util/thread_pool.h"
+
+#define GRAVITY_DIRECT_GRAIN 16
+#define GRAVITY_TREE_GRAIN 256
+
+#if defined(__x86_64__) || defined(__i386__)
+#define GRAVITY_HAS_X86 1
+#include <immintrin.h>
+#else
+#define GRAVITY_HAS_X86 0
+#endif
+
+typedef void (*gravity_kernel_fn)(const struct bodies* bodies, uint32_t begin, uint32_t end, double g, double softening2);
+
+static void kernel_scalar(const struct bodies* bodies, uint32_t begin, uint32_t end, double g, double softening2)
+{
+    const uint32_t n = bodies->count;
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        const double xi = bodies->x[i];
+        const double yi = bodies->y[i];
+        const double zi = bodies->z[i];
+        double ax = 0.0, ay = 0.0, az = 0.0;
+        for (uint32_t j = 0; j < n; ++j)
+        {
+            const double dx = bodies->x[j] - xi;
+            const double dy = bodies->y[j] - yi;
+            const double dz = bodies->z[j] - zi;
+            const double r2 = dx * dx + dy * dy + dz * dz + softening2;
+            if (r2 == 0.0) {
+                continue;
+            }
+            const double inv_r = 1.0 / sqrt(r2);
+            const double s = bodies->mass[j] * inv_r * inv_r * inv_r;
+            ax += s * dx;
+            ay += s * dy;
+            az += s * dz;
+        }
+        bodies->ax[i] = g * ax;
+        bodies->ay[i] = g * ay;
+        bodies->az[i] = g * az;
+    }
+}
+
+#if GRAVITY_HAS_X86
+__attribute__((target("sse2")))
+static void kernel_sse2(const struct bodies* bodies, uint32_t begin, uint32_t end, double g, double softening2)
+{
+    const uint32_t n = bodies_padded_count(bodies);
+    const __m128d eps2 = _mm_set1_pd(softening2);
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d one = _mm_set1_pd(1.0);
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        const __m128d xi = _mm_set1_pd(bodies->x[i]);
+        const __m128d yi = _mm_set1_pd(bodies->y[i]);
+        const __m128d zi = _mm_set1_pd(bodies->z[i]);
+        __m128d ax = zero, ay = zero, az = zero;
+        for (uint32_t j = 0; j < n; j += 2)
+        {
+            const __m128d dx = _mm_sub_pd(_mm_load_pd(bodies->x + j), xi);
+            const __m128d dy = _mm_sub_pd(_mm_load_pd(bodies->y + j), yi);
+            const __m128d dz = _mm_sub_pd(_mm_load_pd(bodies->z + j), zi);
+            __m128d r2 = _mm_add_pd(_mm_mul_pd(dx, dx), eps2);
+            r2 = _mm_add_pd(r2, _mm_mul_pd(dy, dy));
+            r2 = _mm_add_pd(r2, _mm_mul_pd(dz, dz));
+            const __m128d valid = _mm_cmpgt_pd(r2, zero);
+            const __m128d inv_r = _mm_div_pd(one, _mm_sqrt_pd(r2));
+            const __m128d inv_r3 = _mm_mul_pd(_mm_mul_pd(inv_r, inv_r), inv_r);
+            const __m128d s = _mm_and_pd(valid, _mm_mul_pd(_mm_load_pd(bodies->mass + j), inv_r3));
+            ax = _mm_add_pd(ax, _mm_mul_pd(s, dx));
+            ay = _mm_add_pd(ay, _mm_mul_pd(s, dy));
+            az = _mm_add_pd(az, _mm_mul_pd(s, dz));
+        }
+        bodies->ax[i] = g * (_mm_cvtsd_f64(ax) + _mm_cvtsd_f64(_mm_unpackhi_pd(ax, ax)));
+        bodies->ay[i] = g * (_mm_cvtsd_f64(ay) + _mm_cvtsd_f64(_mm_unpackhi_pd(ay, ay)));
+        bodies->az[i] = g * (_mm_cvtsd_f64(az) + _mm_cvtsd_f64(_mm_unpackhi_pd(az, az)));
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static double hsum_avx(__m256d v)
+{
+    const __m128d lo = _mm256_castpd256_pd128(v);
+    const __m128d hi = _mm256_extractf128_pd(v, 1);
+    const __m128d sum = _mm_add_pd(lo, hi);
+    return _mm_cvtsd_f64(sum) + _mm_cvtsd_f64(_mm_unpackhi_pd(sum, sum));
+}
+
+__attribute__((target("avx2,fma")))
+static void kernel_avx2(const struct bodies* bodies, uint32_t begin, uint32_t end, double g, double softening2)
+{
+    const uint32_t n = bodies_padded_count(bodies);
+    const __m256d eps2 = _mm256_set1_pd(softening2);
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d one = _mm256_set1_pd(1.0);
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        const __m256d xi = _mm256_set1_pd(bodies->x[i]);
+        const __m256d yi = _mm256_set1_pd(bodies->y[i]);
+        const __m256d zi = _mm256_set1_pd(bodies->z[i]);
+        __m256d ax = zero, ay = zero, az = zero;
+        for (uint32_t j = 0; j < n; j += 4)
+        {
+            const __m256d dx = _mm256_sub_pd(_mm256_load_pd(bodies->x + j), xi);
+            const __m256d dy = _mm256_sub_pd(_mm256_load_pd(bodies->y + j), yi);
+            const __m256d dz = _mm256_sub_pd(_mm256_load_pd(bodies->z + j), zi);
+            __m256d r2 = _mm256_fmadd_pd(dx, dx, eps2);
+            r2 = _mm256_fmadd_pd(dy, dy, r2);
+            r2 = _mm256_fmadd_pd(dz, dz, r2);
+            const __m256d valid = _mm256_cmp_pd(r2, zero, _CMP_GT_OQ);
+            const __m256d inv_r = _mm256_div_pd(one, _mm256_sqrt_pd(r2));
+            const __m256d inv_r3 = _mm256_mul_pd(_mm256_mul_pd(inv_r, inv_r), inv_r);
+            const __m256d s = _mm256_and_pd(valid, _mm256_mul_pd(_mm256_load_pd(bodies->mass + j), inv_r3));
+            ax = _mm256_fmadd_pd(s, dx, ax);
+            ay = _mm256_fmadd_pd(s, dy, ay);
+            az = _mm256_fmadd_pd(s, dz, az);
+        }
+        bodies->ax[i] = g * hsum_avx(ax);
+        bodies->ay[i] = g * hsum_avx(ay);
+        bodies->az[i] = g * hsum_avx(az);
+    }
+}
+#endif
+
+static gravity_kernel_fn kernel_function(enum gravity_kernel kernel)
+{
+    switch (kernel)
+    {
+#if GRAVITY_HAS_X86
+    case GRAVITY_KERNEL_SSE2: return kernel_sse2;
+    case GRAVITY_KERNEL_AVX2: return kernel_avx2;
+#endif
+    default: return kernel_scalar;
+    }
+}
+
+struct gravity_task
+{
+    struct gravity* gravity;
+    struct bodies* bodies;
+    gravity_kernel_fn kernel;
+    uint32_t offset;
+    double softening2;
+    const uint32_t* indices;
+};
+
+static void direct_task(void* context, uint32_t begin, uint32_t end, uint32_t worker)
+{
+    (void) worker;
+    struct gravity_task* task = context;
+    task->kernel(task->bodies, task->offset + begin, task->offset + end, task->gravity->g, task->softening2);
+}
+
+static void tree_sorted_task(void* context, uint32_t begin, uint32_t end, uint32_t worker)
+{
+    (void) worker;
+    struct gravity_task* task = context;
+    octree_accelerations_sorted(&task->gravity->octree, task->bodies, begin, end, task->gravity->g, task->softening2);
+}
+
+static void tree_task(void* context, uint32_t begin, uint32_t end, uint32_t worker)
+{
+    (void) worker;
+    struct gravity_task* task = context;
+    for (uint32_t i = task->offset + begin; i < task->offset + end; ++i) {
+        octree_acceleration(&task->gravity->octree, task->bodies, i, task->gravity->g, task->softening2);
+    }
+}
+
+static void subset_task(void* context, uint32_t begin, uint32_t end, uint32_t worker)
+{
+    (void) worker;
+    struct gravity_task* task = context;
+    const double softening2 = task->softening2;
+    for (uint32_t k = begin; k < end; ++k) {
+        const uint32_t i = task->indices[k];
+        if (task->gravity->solver == GRAVITY_SOLVER_BARNES_HUT) {
+            octree_acceleration(&task->gravity->octree, task->bodies, i, task->gravity->g, softening2);
+        } else {
+            task->kernel(task->bodies, i, i + 1, task->gravity->g, softening2);
+        }
+    }
+}
+
+void gravity_init(struct gravity* gravity, double g, double softening)
+{
+    gravity->g = g;
+    gravity->softening = softening;
+    gravity->solver = GRAVITY_SOLVER_DIRECT;
+    gravity->pool = NULL;
+    gravity_set_kernel(gravity, GRAVITY_KERNEL_AUTO);
+    octree_init(&gravity->octree, 0.5, 8);
+}
+
+void gravity_free(struct gravity* gravity)
+{
+    octree_free(&gravity->octree);
+}
+
+void gravity_set_kernel(struct gravity* gravity, enum gravity_kernel kernel)
+{
+    const uint32_t features = cpu_features();
+    const int has_avx2 = (features & CPU_FEATURE_AVX2) && (features & CPU_FEATURE_FMA);
+    const int has_sse2 = (features & CPU_FEATURE_SSE2) != 0;
+
+    if (kernel == GRAVITY_KERNEL_AUTO) {
+        kernel = has_avx2 ? GRAVITY_KERNEL_AVX2 : has_sse2 ? GRAVITY_KERNEL_SSE2 : GRAVITY_KERNEL_SCALAR;
+    }
+    if (kernel == GRAVITY_KERNEL_AVX2 && !has_avx2) {
+        kernel = has_sse2 ? GRAVITY_KERNEL_SSE2 : GRAVITY_KERNEL_SCALAR;
+    }
+    if (kernel == GRAVITY_KERNEL_SSE2 && !has_sse2) {
+        kernel = GRAVITY_KERNEL_SCALAR;
+    }
+    gravity->kernel = kernel;
+}
+
+const char* gravity_kernel_name(enum gravity_kernel kernel)
+{
+    switch (kernel)
+    {
+    case GRAVITY_KERNEL_AUTO: return "auto";
+    case GRAVITY_KERNEL_SCALAR: return "scalar";
+    case GRAVITY_KERNEL_SSE2: return "sse2";
+    case GRAVITY_KERNEL_AVX2: return "avx2";
+    default: return "unknown";
+    }
+}
+
+void gravity_set_solver(struct gravity* gravity, enum gravity_solver solver, double theta)
+{
+    gravity->solver = solver;
+    gravity->octree.theta = theta;
+}
+
+const char* gravity_solver_name(enum gravity_solver solver)
+{
+    switch (solver)
+    {
+    case GRAVITY_SOLVER_DIRECT: return "direct";
+    case GRAVITY_SOLVER_BARNES_HUT: return "barnes-hut";
+    default: return "unknown";
+    }
+}
+
+void gravity_accelerations(struct gravity* gravity, struct bodies* bodies)
+{
+    gravity_prepare(gravity, bodies);
+
+    struct gravity_task task = {gravity, bodies, kernel_function(gravity->kernel), 0, gravity->softening * gravity->softening, NULL};
+    if (gravity->solver == GRAVITY_SOLVER_BARNES_HUT) {
+        /* Walking targets in Morton order keeps consecutive traversals in cache */
+        thread_pool_parallel_for(gravity->pool, bodies->count, GRAVITY_TREE_GRAIN, tree_sorted_task, &task);
+    } else {
+        thread_pool_parallel_for(gravity->pool, bodies->count, GRAVITY_DIRECT_GRAIN, direct_task, &task);
+    }
+}
+
+void gravity_prepare(struct gravity* gravity, const struct bodies* bodies)
+{
+    if (gravity->solver == GRAVITY_SOLVER_BARNES_HUT) {
+        octree_build(&gravity->octree, bodies, gravity->pool);
+    }
+}
+
+void gravity_accelerations_range(struct gravity* gravity, struct bodies* bodies, uint32_t begin, uint32_t end)
+{
+    struct gravity_task task = {gravity, bodies, kernel_function(gravity->kernel), begin, gravity->softening * gravity->softening, NULL};
+    if (gravity->solver == GRAVITY_SOLVER_BARNES_HUT) {
+        thread_pool_parallel_for(gravity->pool, end - begin, GRAVITY_TREE_GRAIN, tree_task, &task);
+    } else {
+        thread_pool_parallel_for(gravity->pool, end - begin, GRAVITY_DIRECT_GRAIN, direct_task, &task);
+    }
+}
+
+void gravity_accelerations_subset(struct gravity* gravity, struct bodies* bodies, const uint32_t* indices, uint32_t count)
+{
+    struct gravity_task task = {gravity, bodies, kernel_function(gravity->kernel), 0, gravity->softening * gravity->softening, indices};
+    const uint32_t grain = gravity->solver == GRAVITY_SOLVER_BARNES_HUT ? GRAVITY_TREE_GRAIN : GRAVITY_DIRECT_GRAIN;
+    thread_pool_parallel_for(gravity->pool, count, grain, subset_task, &task);
+}
+
+double gravity_potential_energy(const struct gravity* gravity, const struct bodies* bodies)
+{
+    const double softening2 = gravity->softening * gravity->softening;
+    double energy = 0.0;
+    for (uint32_t i = 0; i < bodies->count; ++i)
+    {
+        double sum = 0.0;
+        for (uint32_t j = i + 1; j < bodies->count; ++j)
+        {
+            const double dx = bodies->x[j] - bodies->x[i];
+            const double dy = bodies->y[j] - bodies->y[i];
+            const double dz = bodies->z[j] - bodies->z[i];
+            sum += bodies->mass[j] / sqrt(dx * dx + dy * dy + dz * dz + softening2);
+        }
+        energy -= gravity->g * bodies->mass[i] * sum;
+    }
+    return energy;
+}
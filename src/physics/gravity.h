@@ -0,0 +1,57 @@
+#ifndef GRAVITY_H
+#define GRAVITY_H
+
+#include <inttypes.h>
+
+#include "bodies.h"
+#include "octree.h"
+
+/* Gaussian gravitational constant squared: AU^3 / (solar mass * day^2) */
+#define GRAVITY_G_AU_MSUN_DAY 2.959122082855911e-4
+
+enum gravity_kernel
+{
+    GRAVITY_KERNEL_AUTO = 0,
+    GRAVITY_KERNEL_SCALAR,
+    GRAVITY_KERNEL_SSE2,
+    GRAVITY_KERNEL_AVX2
+};
+
+enum gravity_solver
+{
+    GRAVITY_SOLVER_DIRECT = 0,
+    GRAVITY_SOLVER_BARNES_HUT,
+    GRAVITY_SOLVER_COUNT
+};
+
+struct thread_pool;
+
+struct gravity
+{
+    double g;
+    double softening;
+
+    enum gravity_kernel kernel;
+    enum gravity_solver solver;
+    struct octree octree;
+
+    /* Optional; NULL evaluates on the calling thread */
+    struct thread_pool* pool;
+};
+
+void gravity_init(struct gravity* gravity, double g, double softening);
+void gravity_free(struct gravity* gravity);
+void gravity_set_kernel(struct gravity* gravity, enum gravity_kernel kernel);
+const char* gravity_kernel_name(enum gravity_kernel kernel);
+void gravity_set_solver(struct gravity* gravity, enum gravity_solver solver, double theta);
+const char* gravity_solver_name(enum gravity_solver solver);
+
+void gravity_accelerations(struct gravity* gravity, struct bodies* bodies);
+
+/* gravity_prepare must be called after the positions change and before evaluating a range */
+void gravity_prepare(struct gravity* gravity, const struct bodies* bodies);
+void gravity_accelerations_range(struct gravity* gravity, struct bodies* bodies, uint32_t begin, uint32_t end);
+void gravity_accelerations_subset(struct gravity* gravity, struct bodies* bodies, const uint32_t* indices, uint32_t count);
+double gravity_potential_energy(const struct gravity* gravity, const struct bodies* bodies);
+
+#endif
@@ -0,0 +1,308 @@
+#include "integrator.h"
+
+#include <string.h>
+#include <math.h>
+
+#include "kepler.h"
+#include "../util/thread_pool.h"
+
+#define INTEGRATOR_GRAIN 1024
+#define INTEGRATOR_BLOCK_BINS 12
+#define INTEGRATOR_BLOCK_ETA 0.02
+
+struct step_task
+{
+    struct bodies* bodies;
+    double dt;
+    double mu;
+    double shift[3];
+};
+
+static void kick_task(void* context, uint32_t begin, uint32_t end, uint32_t worker)
+{
+    (void) worker;
+    const struct step_task* task = context;
+    struct bodies* b = task->bodies;
+    const double dt = task->dt;
+    for (uint32_t i = begin; i < end; ++i) {
+        b->vx[i] += dt * b->ax[i];
+        b->vy[i] += dt * b->ay[i];
+        b->vz[i] += dt * b->az[i];
+    }
+}
+
+static void drift_task(void* context, uint32_t begin, uint32_t end, uint32_t worker)
+{
+    (void) worker;
+    const struct step_task* task = context;
+    struct bodies* b = task->bodies;
+    const double dt = task->dt;
+    for (uint32_t i = begin; i < end; ++i) {
+        b->x[i] += dt * b->vx[i];
+        b->y[i] += dt * b->vy[i];
+        b->z[i] += dt * b->vz[i];
+    }
+}
+
+static void shift_task(void* context, uint32_t begin, uint32_t end, uint32_t worker)
+{
+    (void) worker;
+    const struct step_task* task = context;
+    struct bodies* b = task->bodies;
+    for (uint32_t i = begin; i < end; ++i) {
+        b->x[i] += task->shift[0];
+        b->y[i] += task->shift[1];
+        b->z[i] += task->shift[2];
+    }
+}
+
+static void kepler_task(void* context, uint32_t begin, uint32_t end, uint32_t worker)
+{
+    (void) worker;
+    const struct step_task* task = context;
+    struct bodies* b = task->bodies;
+    for (uint32_t i = begin; i < end; ++i) {
+        if (i == 0) {
+            continue;
+        }
+        double position[3] = {b->x[i], b->y[i], b->z[i]};
+        double velocity[3] = {b->vx[i], b->vy[i], b->vz[i]};
+        kepler_drift(task->mu, position, velocity, task->dt);
+        b->x[i] = position[0];
+        b->y[i] = position[1];
+        b->z[i] = position[2];
+        b->vx[i] = velocity[0];
+        b->vy[i] = velocity[1];
+        b->vz[i] = velocity[2];
+    }
+}
+
+static void kick(struct bodies* bodies, struct thread_pool* pool, double dt)
+{
+    struct step_task task = {bodies, dt, 0.0, {0.0, 0.0, 0.0}};
+    thread_pool_parallel_for(pool, bodies->count, INTEGRATOR_GRAIN, kick_task, &task);
+}
+
+static void drift(struct bodies* bodies, struct thread_pool* pool, double dt)
+{
+    struct step_task task = {bodies, dt, 0.0, {0.0, 0.0, 0.0}};
+    thread_pool_parallel_for(pool, bodies->count, INTEGRATOR_GRAIN, drift_task, &task);
+}
+
+static void leapfrog_step(struct integrator* integrator, struct bodies* bodies, struct gravity* gravity, struct thread_pool* pool, double dt)
+{
+    if (!integrator->initialized) {
+        gravity_accelerations(gravity, bodies);
+        integrator->initialized = true;
+    }
+
+    /* Kick-drift-kick; the closing accelerations are reused by the next step */
+    kick(bodies, pool, 0.5 * dt);
+    drift(bodies, pool, dt);
+    gravity_accelerations(gravity, bodies);
+    kick(bodies, pool, 0.5 * dt);
+}
+
+static void yoshida4_step(struct integrator* integrator, struct bodies* bodies, struct gravity* gravity, struct thread_pool* pool, double dt)
+{
+    /* Triple-jump composition of three leapfrog steps */
+    const double cbrt2 = cbrt(2.0);
+    const double w1 = 1.0 / (2.0 - cbrt2);
+    const double w0 = 1.0 - 2.0 * w1;
+
+    if (!integrator->initialized) {
+        gravity_accelerations(gravity, bodies);
+        integrator->initialized = true;
+    }
+
+    kick(bodies, pool, 0.5 * w1 * dt);
+    drift(bodies, pool, w1 * dt);
+    gravity_accelerations(gravity, bodies);
+    kick(bodies, pool, 0.5 * (w1 + w0) * dt);
+    drift(bodies, pool, w0 * dt);
+    gravity_accelerations(gravity, bodies);
+    kick(bodies, pool, 0.5 * (w0 + w1) * dt);
+    drift(bodies, pool, w1 * dt);
+    gravity_accelerations(gravity, bodies);
+    kick(bodies, pool, 0.5 * w1 * dt);
+}
+
+static void wisdom_holman_begin(struct integrator* integrator, const struct bodies* bodies)
+{
+    struct bodies* helio = &integrator->helio;
+    bodies_reserve(helio, bodies->count);
+    helio->count = bodies->count;
+    bodies_center_of_mass(bodies, integrator->com_position, integrator->com_velocity);
+
+    for (uint32_t i = 0; i < bodies->count; ++i) {
+        helio->x[i] = bodies->x[i] - bodies->x[0];
+        helio->y[i] = bodies->y[i] - bodies->y[0];
+        helio->z[i] = bodies->z[i] - bodies->z[0];
+        helio->vx[i] = bodies->vx[i] - integrator->com_velocity[0];
+        helio->vy[i] = bodies->vy[i] - integrator->com_velocity[1];
+        helio->vz[i] = bodies->vz[i] - integrator->com_velocity[2];
+        helio->mass[i] = bodies->mass[i];
+        helio->radius[i] = bodies->radius[i];
+    }
+
+    /* The central body only enters through the Kepler drift */
+    helio->mass[0] = 0.0;
+    helio->vx[0] = helio->vy[0] = helio->vz[0] = 0.0;
+}
+
+static void wisdom_holman_end(const struct integrator* integrator, struct bodies* bodies)
+{
+    const struct bodies* helio = &integrator->helio;
+    const double central_mass = bodies->mass[0];
+    const double total_mass = bodies_total_mass(bodies);
+
+    double mq[3] = {0.0, 0.0, 0.0};
+    double mp[3] = {0.0, 0.0, 0.0};
+    for (uint32_t i = 1; i < helio->count; ++i) {
+        mq[0] += helio->mass[i] * helio->x[i];
+        mq[1] += helio->mass[i] * helio->y[i];
+        mq[2] += helio->mass[i] * helio->z[i];
+        mp[0] += helio->mass[i] * helio->vx[i];
+        mp[1] += helio->mass[i] * helio->vy[i];
+        mp[2] += helio->mass[i] * helio->vz[i];
+    }
+
+    const double* r = integrator->com_position;
+    const double* v = integrator->com_velocity;
+    bodies->x[0] = r[0] - mq[0] / total_mass;
+    bodies->y[0] = r[1] - mq[1] / total_mass;
+    bodies->z[0] = r[2] - mq[2] / total_mass;
+    bodies->vx[0] = v[0] - mp[0] / central_mass;
+    bodies->vy[0] = v[1] - mp[1] / central_mass;
+    bodies->vz[0] = v[2] - mp[2] / central_mass;
+
+    for (uint32_t i = 1; i < helio->count; ++i) {
+        bodies->x[i] = helio->x[i] + bodies->x[0];
+        bodies->y[i] = helio->y[i] + bodies->y[0];
+        bodies->z[i] = helio->z[i] + bodies->z[0];
+        bodies->vx[i] = helio->vx[i] + v[0];
+        bodies->vy[i] = helio->vy[i] + v[1];
+        bodies->vz[i] = helio->vz[i] + v[2];
+    }
+}
+
+static void wisdom_holman_jump(struct integrator* integrator, struct thread_pool* pool, double central_mass, double dt)
+{
+    struct bodies* helio = &integrator->helio;
+    double p[3] = {0.0, 0.0, 0.0};
+    for (uint32_t i = 1; i < helio->count; ++i) {
+        p[0] += helio->mass[i] * helio->vx[i];
+        p[1] += helio->mass[i] * helio->vy[i];
+        p[2] += helio->mass[i] * helio->vz[i];
+    }
+
+    const double scale = dt / central_mass;
+    struct step_task task = {helio, dt, 0.0, {scale * p[0], scale * p[1], scale * p[2]}};
+    thread_pool_parallel_for(pool, helio->count, INTEGRATOR_GRAIN, shift_task, &task);
+    helio->x[0] = helio->y[0] = helio->z[0] = 0.0;
+}
+
+/* Democratic heliocentric splitting: interaction kick, jump, Kepler drift about body 0 */
+static void wisdom_holman_step(struct integrator* integrator, struct bodies* bodies, struct gravity* gravity, struct thread_pool* pool, double dt)
+{
+    struct bodies* helio = &integrator->helio;
+    const double central_mass = bodies->mass[0];
+
+    if (!integrator->initialized) {
+        wisdom_holman_begin(integrator, bodies);
+        gravity_accelerations(gravity, helio);
+        integrator->initialized = true;
+    }
+
+    kick(helio, pool, 0.5 * dt);
+    wisdom_holman_jump(integrator, pool, central_mass, 0.5 * dt);
+
+    struct step_task task = {helio, dt, gravity->g * central_mass, {0.0, 0.0, 0.0}};
+    thread_pool_parallel_for(pool, helio->count, INTEGRATOR_GRAIN, kepler_task, &task);
+
+    wisdom_holman_jump(integrator, pool, central_mass, 0.5 * dt);
+    gravity_accelerations(gravity, helio);
+    kick(helio, pool, 0.5 * dt);
+
+    for (uint32_t k = 0; k < 3; ++k) {
+        integrator->com_position[k] += dt * integrator->com_velocity[k];
+    }
+    wisdom_holman_end(integrator, bodies);
+}
+
+static void block_leapfrog_step(struct integrator* integrator, struct bodies* bodies, struct gravity* gravity, struct thread_pool* pool, double dt)
+{
+    if (!integrator->initialized) {
+        block_timestep_begin(&integrator->block, bodies, gravity, dt);
+        integrator->initialized = true;
+    }
+    block_timestep_step(&integrator->block, bodies, gravity, pool, dt);
+}
+
+void integrator_init(struct integrator* integrator, enum integrator_type type)
+{
+    memset(integrator, 0, sizeof(*integrator));
+    integrator->type = type;
+    integrator->initialized = false;
+    bodies_init(&integrator->helio, 0);
+    block_timestep_init(&integrator->block, INTEGRATOR_BLOCK_BINS, INTEGRATOR_BLOCK_ETA);
+}
+
+void integrator_free(struct integrator* integrator)
+{
+    bodies_free(&integrator->helio);
+    block_timestep_free(&integrator->block);
+}
+
+void integrator_reset(struct integrator* integrator)
+{
+    integrator->initialized = false;
+}
+
+void integrator_synchronize(struct integrator* integrator, const struct bodies* bodies)
+{
+    /* Only Wisdom-Holman keeps positions of its own between steps */
+    if (integrator->initialized && integrator->type == INTEGRATOR_WISDOM_HOLMAN) {
+        wisdom_holman_begin(integrator, bodies);
+    }
+}
+
+void integrator_step(struct integrator* integrator, struct bodies* bodies, struct gravity* gravity, struct thread_pool* pool, double dt)
+{
+    if (bodies->count == 0) {
+        return;
+    }
+
+    switch (integrator->type)
+    {
+    case INTEGRATOR_LEAPFROG: leapfrog_step(integrator, bodies, gravity, pool, dt); break;
+    case INTEGRATOR_YOSHIDA4: yoshida4_step(integrator, bodies, gravity, pool, dt); break;
+    case INTEGRATOR_WISDOM_HOLMAN: wisdom_holman_step(integrator, bodies, gravity, pool, dt); break;
+    case INTEGRATOR_BLOCK_LEAPFROG: block_leapfrog_step(integrator, bodies, gravity, pool, dt); break;
+    default: break;
+    }
+}
+
+const char* integrator_name(enum integrator_type type)
+{
+    switch (type)
+    {
+    case INTEGRATOR_LEAPFROG: return "leapfrog";
+    case INTEGRATOR_YOSHIDA4: return "yoshida4";
+    case INTEGRATOR_WISDOM_HOLMAN: return "wisdom-holman";
+    case INTEGRATOR_BLOCK_LEAPFROG: return "block-leapfrog";
+    default: return "unknown";
+    }
+}
+
+bool integrator_parse(const char* name, enum integrator_type* type)
+{
+    const enum integrator_type types[] = {INTEGRATOR_LEAPFROG, INTEGRATOR_YOSHIDA4, INTEGRATOR_WISDOM_HOLMAN, INTEGRATOR_BLOCK_LEAPFROG};
+    for (uint32_t i = 0; i < sizeof(types) / sizeof(types[0]); ++i) {
+        if (strcmp(name, integrator_name(types[i])) == 0) {
+            *type = types[i];
+            return true;
+        }
+    }
+    return false;
+}
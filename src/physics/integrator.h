@@ -0,0 +1,50 @@
+#ifndef INTEGRATOR_H
+#define INTEGRATOR_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include "bodies.h"
+#include "gravity.h"
+#include "block_timestep.h"
+
+struct thread_pool;
+
+enum integrator_type
+{
+    INTEGRATOR_LEAPFROG = 0,
+    INTEGRATOR_YOSHIDA4,
+    INTEGRATOR_WISDOM_HOLMAN,
+    INTEGRATOR_BLOCK_LEAPFROG,
+    INTEGRATOR_COUNT
+};
+
+struct integrator
+{
+    enum integrator_type type;
+
+    /* Cleared by integrator_reset when the bodies are changed from outside */
+    bool initialized;
+
+    /* Wisdom-Holman: democratic heliocentric positions and barycentric
+     * velocities around body 0, plus the drifting centre of mass */
+    struct bodies helio;
+    double com_position[3];
+    double com_velocity[3];
+
+    /* Block leapfrog: per-body power-of-two timestep bins below dt */
+    struct block_timestep block;
+};
+
+void integrator_init(struct integrator* integrator, enum integrator_type type);
+void integrator_free(struct integrator* integrator);
+void integrator_reset(struct integrator* integrator);
+/* Cheaper than a reset when some bodies were moved between steps: internal
+ * coordinates are re-derived but the last accelerations are kept */
+void integrator_synchronize(struct integrator* integrator, const struct bodies* bodies);
+void integrator_step(struct integrator* integrator, struct bodies* bodies, struct gravity* gravity, struct thread_pool* pool, double dt);
+
+const char* integrator_name(enum integrator_type type);
+bool integrator_parse(const char* name, enum integrator_type* type);
+
+#endif
@@ -0,0 +1,96 @@
+#include "kepler.h"
+
+#include <math.h>
+
+#include "../util/util.h"
+
+#define KEPLER_MAX_ITERATIONS 64
+
+/* Stumpff functions c0..c3 of z */
+static void stumpff(double z, double c[4])
+{
+    if (fabs(z) < 1.0)
+    {
+        /* Series: c_n(z) = sum_k (-z)^k / (2k + n)! */
+        double term2 = 0.5, term3 = 1.0 / 6.0;
+        double c2 = 0.0, c3 = 0.0;
+        for (int k = 0; k < 20 && (fabs(term2) > 1e-18 || fabs(term3) > 1e-18); ++k) {
+            c2 += term2;
+            c3 += term3;
+            term2 *= -z / ((2.0 * k + 3.0) * (2.0 * k + 4.0));
+            term3 *= -z / ((2.0 * k + 4.0) * (2.0 * k + 5.0));
+        }
+        c[2] = c2;
+        c[3] = c3;
+        c[1] = 1.0 - z * c3;
+        c[0] = 1.0 - z * c2;
+    }
+    else if (z > 0.0)
+    {
+        const double s = sqrt(z);
+        c[0] = cos(s);
+        c[1] = sin(s) / s;
+        c[2] = (1.0 - c[0]) / z;
+        c[3] = (1.0 - c[1]) / z;
+    }
+    else
+    {
+        const double s = sqrt(-z);
+        c[0] = cosh(s);
+        c[1] = sinh(s) / s;
+        c[2] = (1.0 - c[0]) / z;
+        c[3] = (1.0 - c[1]) / z;
+    }
+}
+
+void kepler_drift(double mu, double position[3], double velocity[3], double dt)
+{
+    const double r0 = sqrt(position[0] * position[0] + position[1] * position[1] + position[2] * position[2]);
+    const double v2 = velocity[0] * velocity[0] + velocity[1] * velocity[1] + velocity[2] * velocity[2];
+    const double eta = position[0] * velocity[0] + position[1] * velocity[1] + position[2] * velocity[2];
+    const double beta = 2.0 * mu / r0 - v2;
+
+    /* Bound orbits only need the remainder of dt modulo the period */
+    if (beta > 0.0) {
+        const double period = 2.0 * M_PI * mu / (beta * sqrt(beta));
+        dt = fmod(dt, period);
+    }
+
+    double s = dt / r0;
+    double c[4];
+    double g1 = 0.0, g2 = 0.0, g3 = 0.0, r = r0;
+    for (int i = 0; i < KEPLER_MAX_ITERATIONS; ++i)
+    {
+        stumpff(beta * s * s, c);
+        g1 = s * c[1];
+        g2 = s * s * c[2];
+        g3 = s * s * s * c[3];
+        r = r0 * c[0] + eta * g1 + mu * g2;
+        const double f = r0 * g1 + eta * g2 + mu * g3 - dt;
+
+        /* Halley step: f' = r, f'' = eta * G0 + zeta * G1 */
+        const double fpp = eta * c[0] + (mu - beta * r0) * g1;
+        const double step = f / (r - 0.5 * f * fpp / r);
+        s -= step;
+        if (fabs(step) <= 1e-15 * fabs(s)) {
+            stumpff(beta * s * s, c);
+            g1 = s * c[1];
+            g2 = s * s * c[2];
+            g3 = s * s * s * c[3];
+            r = r0 * c[0] + eta * g1 + mu * g2;
+            break;
+        }
+    }
+
+    const double f = 1.0 - mu * g2 / r0;
+    const double g = dt - mu * g3;
+    const double fdot = -mu * g1 / (r * r0);
+    const double gdot = 1.0 - mu * g2 / r;
+
+    for (int k = 0; k < 3; ++k) {
+        const double p = position[k];
+        const double v = velocity[k];
+        position[k] = f * p + g * v;
+        velocity[k] = fdot * p + gdot * v;
+    }
+}
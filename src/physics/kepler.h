@@ -0,0 +1,8 @@
+#ifndef KEPLER_H
+#define KEPLER_H
+
+/* Advances a two-body orbit with gravitational parameter mu by dt in place,
+ * using universal variables so elliptic and hyperbolic orbits both work. */
+void kepler_drift(double mu, double position[3], double velocity[3], double dt);
+
+#endif
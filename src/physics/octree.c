@@ -0,0 +1,526 @@
+#include "octree.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "../util/thread_pool.h"
+#include "../util/util.h"
+
+#define OCTREE_STACK_SIZE (8 * OCTREE_MAX_DEPTH + 8)
+#define OCTREE_CHUNK_SIZE 16384
+
+static void* allocate(size_t size)
+{
+    return util_allocate_aligned(BODIES_ALIGNMENT, size, "octree storage");
+}
+
+static void octree_reserve_bodies(struct octree* tree, uint32_t count)
+{
+    if (count > tree->body_capacity)
+    {
+        free(tree->keys);
+        free(tree->order);
+        free(tree->x);
+        free(tree->y);
+        free(tree->z);
+        free(tree->mass);
+        free(tree->scratch_keys);
+        free(tree->scratch_order);
+
+        const uint32_t capacity = count + count / 2;
+        tree->keys = allocate(capacity * sizeof(uint64_t));
+        tree->order = allocate(capacity * sizeof(uint32_t));
+        tree->x = allocate(capacity * sizeof(double));
+        tree->y = allocate(capacity * sizeof(double));
+        tree->z = allocate(capacity * sizeof(double));
+        tree->mass = allocate(capacity * sizeof(double));
+        tree->scratch_keys = allocate(capacity * sizeof(uint64_t));
+        tree->scratch_order = allocate(capacity * sizeof(uint32_t));
+        tree->body_capacity = capacity;
+    }
+
+    const uint32_t chunks = (count + OCTREE_CHUNK_SIZE - 1) / OCTREE_CHUNK_SIZE;
+    if (chunks > tree->chunk_capacity)
+    {
+        free(tree->histograms);
+        free(tree->chunk_bounds);
+        tree->histograms = allocate(chunks * 256 * sizeof(uint32_t));
+        tree->chunk_bounds = allocate(chunks * 6 * sizeof(double));
+        tree->chunk_capacity = chunks;
+    }
+}
+
+static uint32_t allocate_nodes(struct octree_node** nodes, uint32_t* node_count, uint32_t* node_capacity, uint32_t count)
+{
+    if (*node_count + count > *node_capacity) {
+        uint32_t capacity = *node_capacity ? *node_capacity : 64;
+        while (*node_count + count > capacity) {
+            capacity *= 2;
+        }
+        *nodes = util_reallocate(*nodes, capacity * sizeof(struct octree_node), "octree nodes");
+        *node_capacity = capacity;
+    }
+
+    const uint32_t first = *node_count;
+    *node_count += count;
+    return first;
+}
+
+static uint64_t expand_bits(uint64_t v)
+{
+    v &= 0x1fffff;
+    v = (v | v << 32) & 0x1f00000000ffffull;
+    v = (v | v << 16) & 0x1f0000ff0000ffull;
+    v = (v | v << 8) & 0x100f00f00f00f00full;
+    v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+    v = (v | v << 2) & 0x1249249249249249ull;
+    return v;
+}
+
+static uint64_t quantize(double value, double min, double scale)
+{
+    const double max = (double)((1u << OCTREE_MAX_DEPTH) - 1);
+    double q = (value - min) * scale;
+    q = q < 0.0 ? 0.0 : q > max ? max : q;
+    return (uint64_t)q;
+}
+
+struct build_context
+{
+    struct octree* tree;
+    const struct bodies* bodies;
+    uint32_t count;
+    uint32_t chunks;
+    uint32_t shift;
+    double scale;
+};
+
+static void bounds_task(void* context, uint32_t begin, uint32_t end, uint32_t worker)
+{
+    (void) worker;
+    struct build_context* ctx = context;
+    const struct bodies* bodies = ctx->bodies;
+    for (uint32_t chunk = begin; chunk < end; ++chunk)
+    {
+        const uint32_t first = chunk * OCTREE_CHUNK_SIZE;
+        const uint32_t last = first + OCTREE_CHUNK_SIZE < ctx->count ? first + OCTREE_CHUNK_SIZE : ctx->count;
+        double* b = ctx->tree->chunk_bounds + 6 * chunk;
+        b[0] = b[3] = bodies->x[first];
+        b[1] = b[4] = bodies->y[first];
+        b[2] = b[5] = bodies->z[first];
+        for (uint32_t i = first + 1; i < last; ++i) {
+            b[0] = fmin(b[0], bodies->x[i]); b[3] = fmax(b[3], bodies->x[i]);
+            b[1] = fmin(b[1], bodies->y[i]); b[4] = fmax(b[4], bodies->y[i]);
+            b[2] = fmin(b[2], bodies->z[i]); b[5] = fmax(b[5], bodies->z[i]);
+        }
+    }
+}
+
+static void keys_task(void* context, uint32_t begin, uint32_t end, uint32_t worker)
+{
+    (void) worker;
+    struct build_context* ctx = context;
+    struct octree* tree = ctx->tree;
+    const struct bodies* bodies = ctx->bodies;
+    const struct vec3 lo = tree->bounds_min;
+    for (uint32_t i = begin; i < end; ++i) {
+        tree->keys[i] = expand_bits(quantize(bodies->x[i], lo.x, ctx->scale))
+                      | expand_bits(quantize(bodies->y[i], lo.y, ctx->scale)) << 1
+                      | expand_bits(quantize(bodies->z[i], lo.z, ctx->scale)) << 2;
+        tree->order[i] = i;
+    }
+}
+
+static void histogram_task(void* context, uint32_t begin, uint32_t end, uint32_t worker)
+{
+    (void) worker;
+    struct build_context* ctx = context;
+    struct octree* tree = ctx->tree;
+    for (uint32_t chunk = begin; chunk < end; ++chunk)
+    {
+        const uint32_t first = chunk * OCTREE_CHUNK_SIZE;
+        const uint32_t last = first + OCTREE_CHUNK_SIZE < ctx->count ? first + OCTREE_CHUNK_SIZE : ctx->count;
+        uint32_t* histogram = tree->histograms + 256 * chunk;
+        memset(histogram, 0, 256 * sizeof(uint32_t));
+        for (uint32_t i = first; i < last; ++i) {
+            histogram[(tree->keys[i] >> ctx->shift) & 0xff]++;
+        }
+    }
+}
+
+static void scatter_task(void* context, uint32_t begin, uint32_t end, uint32_t worker)
+{
+    (void) worker;
+    struct build_context* ctx = context;
+    struct octree* tree = ctx->tree;
+    for (uint32_t chunk = begin; chunk < end; ++chunk)
+    {
+        const uint32_t first = chunk * OCTREE_CHUNK_SIZE;
+        const uint32_t last = first + OCTREE_CHUNK_SIZE < ctx->count ? first + OCTREE_CHUNK_SIZE : ctx->count;
+        uint32_t* offsets = tree->histograms + 256 * chunk;
+        for (uint32_t i = first; i < last; ++i) {
+            const uint32_t dst = offsets[(tree->keys[i] >> ctx->shift) & 0xff]++;
+            tree->scratch_keys[dst] = tree->keys[i];
+            tree->scratch_order[dst] = tree->order[i];
+        }
+    }
+}
+
+static void gather_task(void* context, uint32_t begin, uint32_t end, uint32_t worker)
+{
+    (void) worker;
+    struct build_context* ctx = context;
+    struct octree* tree = ctx->tree;
+    const struct bodies* bodies = ctx->bodies;
+    for (uint32_t k = begin; k < end; ++k) {
+        const uint32_t i = tree->order[k];
+        tree->x[k] = bodies->x[i];
+        tree->y[k] = bodies->y[i];
+        tree->z[k] = bodies->z[i];
+        tree->mass[k] = bodies->mass[i];
+    }
+}
+
+/* Stable LSD radix sort over per-chunk histograms, so the permutation does
+ * not depend on how chunks are spread over threads. */
+static void radix_sort(struct octree* tree, struct build_context* ctx, struct thread_pool* pool)
+{
+    const uint32_t n = ctx->count;
+    for (uint32_t shift = 0; shift < 64; shift += 8)
+    {
+        ctx->shift = shift;
+        thread_pool_parallel_for(pool, ctx->chunks, 1, histogram_task, ctx);
+
+        /* Skip passes where every key has the same digit */
+        const uint32_t digit = (tree->keys[0] >> shift) & 0xff;
+        uint32_t same = 0;
+        for (uint32_t chunk = 0; chunk < ctx->chunks; ++chunk) {
+            same += tree->histograms[256 * chunk + digit];
+        }
+        if (same == n) {
+            continue;
+        }
+
+        uint32_t offset = 0;
+        for (uint32_t d = 0; d < 256; ++d) {
+            for (uint32_t chunk = 0; chunk < ctx->chunks; ++chunk) {
+                uint32_t* h = &tree->histograms[256 * chunk + d];
+                const uint32_t c = *h;
+                *h = offset;
+                offset += c;
+            }
+        }
+        thread_pool_parallel_for(pool, ctx->chunks, 1, scatter_task, ctx);
+
+        uint64_t* k = tree->keys; tree->keys = tree->scratch_keys; tree->scratch_keys = k;
+        uint32_t* o = tree->order; tree->order = tree->scratch_order; tree->scratch_order = o;
+    }
+}
+
+static uint32_t upper_bound_octant(const uint64_t* keys, uint32_t begin, uint32_t end, uint32_t shift, uint32_t octant)
+{
+    while (begin < end) {
+        const uint32_t mid = begin + (end - begin) / 2;
+        if (((keys[mid] >> shift) & 7) <= octant) {
+            begin = mid + 1;
+        } else {
+            end = mid;
+        }
+    }
+    return begin;
+}
+
+static void update_mass(struct octree_node* nodes, uint32_t index)
+{
+    struct octree_node* node = &nodes[index];
+    double m = 0.0, mx = 0.0, my = 0.0, mz = 0.0;
+    for (uint32_t c = node->first_child; c < node->first_child + node->child_count; ++c) {
+        const struct octree_node* child = &nodes[c];
+        m += child->mass;
+        mx += child->mass * child->com_x;
+        my += child->mass * child->com_y;
+        mz += child->mass * child->com_z;
+    }
+    node->mass = m;
+    node->com_x = m > 0.0 ? mx / m : node->center.x;
+    node->com_y = m > 0.0 ? my / m : node->center.y;
+    node->com_z = m > 0.0 ? mz / m : node->center.z;
+}
+
+/* Builds the subtree rooted at nodes[index]. When subtrees is non-NULL, nodes
+ * reaching OCTREE_SPLIT_LEVEL are recorded there instead of being expanded. */
+static void build_node(struct octree* tree, struct octree_node** nodes, uint32_t* node_count, uint32_t* node_capacity,
+                       uint32_t index, uint32_t begin, uint32_t end, uint32_t level, bool split)
+{
+    struct octree_node* node = &(*nodes)[index];
+    node->begin = begin;
+    node->count = end - begin;
+    node->first_child = 0;
+    node->child_count = 0;
+
+    if (node->count <= tree->leaf_size || level == OCTREE_MAX_DEPTH)
+    {
+        double m = 0.0, mx = 0.0, my = 0.0, mz = 0.0;
+        for (uint32_t k = begin; k < end; ++k) {
+            m += tree->mass[k];
+            mx += tree->mass[k] * tree->x[k];
+            my += tree->mass[k] * tree->y[k];
+            mz += tree->mass[k] * tree->z[k];
+        }
+        node->mass = m;
+        node->com_x = m > 0.0 ? mx / m : node->center.x;
+        node->com_y = m > 0.0 ? my / m : node->center.y;
+        node->com_z = m > 0.0 ? mz / m : node->center.z;
+        return;
+    }
+
+    if (split && level == OCTREE_SPLIT_LEVEL)
+    {
+        struct octree_subtree* subtree = &tree->subtrees[tree->subtree_count++];
+        subtree->node = index;
+        subtree->begin = begin;
+        subtree->end = end;
+        return;
+    }
+
+    const uint32_t shift = 3 * (OCTREE_MAX_DEPTH - 1 - level);
+    uint32_t bounds[9];
+    uint32_t child_count = 0;
+    bounds[0] = begin;
+    for (uint32_t octant = 0; octant < 8; ++octant) {
+        bounds[octant + 1] = upper_bound_octant(tree->keys, bounds[octant], end, shift, octant);
+        child_count += bounds[octant + 1] > bounds[octant];
+    }
+
+    const struct vec3 center = node->center;
+    const float quarter = 0.5f * node->half_size;
+    const uint32_t first = allocate_nodes(nodes, node_count, node_capacity, child_count);
+
+    uint32_t child = first;
+    for (uint32_t octant = 0; octant < 8; ++octant)
+    {
+        if (bounds[octant + 1] == bounds[octant]) {
+            continue;
+        }
+        struct vec3 offset;
+        vec3_init(&offset, (octant & 1) ? quarter : -quarter, (octant & 2) ? quarter : -quarter, (octant & 4) ? quarter : -quarter);
+        (*nodes)[child].center = center;
+        vec3_add(&(*nodes)[child].center, &offset);
+        (*nodes)[child].half_size = quarter;
+        build_node(tree, nodes, node_count, node_capacity, child, bounds[octant], bounds[octant + 1], level + 1, split);
+        child++;
+    }
+
+    /* The node pool may have moved while building the children */
+    node = &(*nodes)[index];
+    node->first_child = first;
+    node->child_count = child_count;
+    if (!split) {
+        update_mass(*nodes, index);
+    }
+}
+
+static void subtree_task(void* context, uint32_t begin, uint32_t end, uint32_t worker)
+{
+    (void) worker;
+    struct octree* tree = ((struct build_context*)context)->tree;
+    for (uint32_t s = begin; s < end; ++s)
+    {
+        struct octree_subtree* subtree = &tree->subtrees[s];
+        subtree->node_count = 0;
+        const uint32_t root = allocate_nodes(&subtree->nodes, &subtree->node_count, &subtree->node_capacity, 1);
+        subtree->nodes[root].center = tree->nodes[subtree->node].center;
+        subtree->nodes[root].half_size = tree->nodes[subtree->node].half_size;
+        build_node(tree, &subtree->nodes, &subtree->node_count, &subtree->node_capacity, root, subtree->begin, subtree->end, OCTREE_SPLIT_LEVEL, false);
+    }
+}
+
+void octree_init(struct octree* tree, double theta, uint32_t leaf_size)
+{
+    memset(tree, 0, sizeof(*tree));
+    tree->theta = theta;
+    tree->leaf_size = leaf_size > 0 ? leaf_size : 1;
+}
+
+void octree_free(struct octree* tree)
+{
+    free(tree->nodes);
+    free(tree->keys);
+    free(tree->order);
+    free(tree->x);
+    free(tree->y);
+    free(tree->z);
+    free(tree->mass);
+    free(tree->scratch_keys);
+    free(tree->scratch_order);
+    free(tree->histograms);
+    free(tree->chunk_bounds);
+    for (uint32_t s = 0; s < OCTREE_MAX_SUBTREES; ++s) {
+        free(tree->subtrees[s].nodes);
+    }
+    memset(tree, 0, sizeof(*tree));
+}
+
+void octree_build(struct octree* tree, const struct bodies* bodies, struct thread_pool* pool)
+{
+    const uint32_t n = bodies->count;
+    tree->node_count = 0;
+    tree->subtree_count = 0;
+    tree->body_count = n;
+    if (n == 0) {
+        return;
+    }
+    octree_reserve_bodies(tree, n);
+
+    struct build_context ctx;
+    ctx.tree = tree;
+    ctx.bodies = bodies;
+    ctx.count = n;
+    ctx.chunks = (n + OCTREE_CHUNK_SIZE - 1) / OCTREE_CHUNK_SIZE;
+
+    thread_pool_parallel_for(pool, ctx.chunks, 1, bounds_task, &ctx);
+    double min[3], max[3];
+    for (uint32_t k = 0; k < 3; ++k) {
+        min[k] = tree->chunk_bounds[k];
+        max[k] = tree->chunk_bounds[3 + k];
+    }
+    for (uint32_t chunk = 1; chunk < ctx.chunks; ++chunk) {
+        for (uint32_t k = 0; k < 3; ++k) {
+            min[k] = fmin(min[k], tree->chunk_bounds[6 * chunk + k]);
+            max[k] = fmax(max[k], tree->chunk_bounds[6 * chunk + 3 + k]);
+        }
+    }
+
+    struct vec3 lo, extent;
+    vec3_init(&lo, (float)min[0], (float)min[1], (float)min[2]);
+    vec3_init(&extent, (float)max[0], (float)max[1], (float)max[2]);
+    vec3_sub(&extent, &lo);
+    const float size = 1.0001f * fmaxf(fmaxf(extent.x, extent.y), fmaxf(extent.z, 1e-12f));
+    tree->bounds_min = lo;
+    tree->bounds_size = size;
+    ctx.scale = (double)(1u << OCTREE_MAX_DEPTH) / size;
+
+    thread_pool_parallel_for(pool, n, OCTREE_CHUNK_SIZE / 4, keys_task, &ctx);
+    radix_sort(tree, &ctx, pool);
+    thread_pool_parallel_for(pool, n, OCTREE_CHUNK_SIZE / 4, gather_task, &ctx);
+
+    /* Top levels serially, then every subtree below the split level on its own */
+    const uint32_t root = allocate_nodes(&tree->nodes, &tree->node_count, &tree->node_capacity, 1);
+    struct vec3 half;
+    vec3_init(&half, 0.5f * size, 0.5f * size, 0.5f * size);
+    tree->nodes[root].center = lo;
+    vec3_add(&tree->nodes[root].center, &half);
+    tree->nodes[root].half_size = 0.5f * size;
+    build_node(tree, &tree->nodes, &tree->node_count, &tree->node_capacity, root, 0, n, 0, true);
+    const uint32_t top_count = tree->node_count;
+
+    thread_pool_parallel_for(pool, tree->subtree_count, 1, subtree_task, &ctx);
+
+    /* Splice the subtrees in order; their local root replaces the pending node */
+    for (uint32_t s = 0; s < tree->subtree_count; ++s)
+    {
+        const struct octree_subtree* subtree = &tree->subtrees[s];
+        const uint32_t offset = allocate_nodes(&tree->nodes, &tree->node_count, &tree->node_capacity, subtree->node_count - 1) - 1;
+        for (uint32_t i = 0; i < subtree->node_count; ++i) {
+            struct octree_node* dst = &tree->nodes[i == 0 ? subtree->node : offset + i];
+            *dst = subtree->nodes[i];
+            if (dst->child_count > 0) {
+                dst->first_child += offset;
+            }
+        }
+    }
+
+    /* Children of top-level nodes always have larger indices */
+    for (uint32_t i = top_count; i-- > 0;) {
+        if (tree->nodes[i].child_count > 0) {
+            update_mass(tree->nodes, i);
+        }
+    }
+}
+
+static void accumulate(const struct octree* tree, double px, double py, double pz, double softening2, double out[3])
+{
+    const double theta2 = tree->theta * tree->theta;
+    double ax = 0.0, ay = 0.0, az = 0.0;
+
+    uint32_t stack[OCTREE_STACK_SIZE];
+    uint32_t top = 0;
+    if (tree->node_count > 0) {
+        stack[top++] = 0;
+    }
+
+    while (top > 0)
+    {
+        const struct octree_node* node = &tree->nodes[stack[--top]];
+
+        if (node->child_count == 0)
+        {
+            for (uint32_t k = node->begin; k < node->begin + node->count; ++k) {
+                const double dx = tree->x[k] - px;
+                const double dy = tree->y[k] - py;
+                const double dz = tree->z[k] - pz;
+                const double r2 = dx * dx + dy * dy + dz * dz + softening2;
+                if (r2 == 0.0) {
+                    continue;
+                }
+                const double inv_r = 1.0 / sqrt(r2);
+                const double s = tree->mass[k] * inv_r * inv_r * inv_r;
+                ax += s * dx;
+                ay += s * dy;
+                az += s * dz;
+            }
+            continue;
+        }
+
+        const double dx = node->com_x - px;
+        const double dy = node->com_y - py;
+        const double dz = node->com_z - pz;
+        const double d2 = dx * dx + dy * dy + dz * dz;
+        const double size = 2.0 * node->half_size;
+        const double h = node->half_size;
+        const int inside = fabs(px - node->center.x) <= h && fabs(py - node->center.y) <= h && fabs(pz - node->center.z) <= h;
+
+        if (!inside && size * size < theta2 * d2)
+        {
+            const double r2 = d2 + softening2;
+            const double inv_r = 1.0 / sqrt(r2);
+            const double s = node->mass * inv_r * inv_r * inv_r;
+            ax += s * dx;
+            ay += s * dy;
+            az += s * dz;
+            continue;
+        }
+
+        for (uint32_t c = 0; c < node->child_count; ++c) {
+            stack[top++] = node->first_child + c;
+        }
+    }
+
+    out[0] = ax;
+    out[1] = ay;
+    out[2] = az;
+}
+
+void octree_accelerations_sorted(const struct octree* tree, struct bodies* bodies, uint32_t begin, uint32_t end, double g, double softening2)
+{
+    for (uint32_t k = begin; k < end; ++k) {
+        double a[3];
+        accumulate(tree, tree->x[k], tree->y[k], tree->z[k], softening2, a);
+        const uint32_t i = tree->order[k];
+        bodies->ax[i] = g * a[0];
+        bodies->ay[i] = g * a[1];
+        bodies->az[i] = g * a[2];
+    }
+}
+
+void octree_acceleration(const struct octree* tree, struct bodies* bodies, uint32_t index, double g, double softening2)
+{
+    double a[3];
+    accumulate(tree, bodies->x[index], bodies->y[index], bodies->z[index], softening2, a);
+    bodies->ax[index] = g * a[0];
+    bodies->ay[index] = g * a[1];
+    bodies->az[index] = g * a[2];
+}
@@ -0,0 +1,89 @@
+#ifndef OCTREE_H
+#define OCTREE_H
+
+#include <inttypes.h>
+
+#include "../math/vec3.h"
+#include "bodies.h"
+
+#define OCTREE_MAX_DEPTH 21
+
+/* Subtrees below this level are built independently (and in parallel) */
+#define OCTREE_SPLIT_LEVEL 2
+#define OCTREE_MAX_SUBTREES 64
+
+struct thread_pool;
+
+struct octree_node
+{
+    double com_x;
+    double com_y;
+    double com_z;
+    double mass;
+
+    struct vec3 center;
+    float half_size;
+
+    /* Children are stored contiguously; child_count == 0 marks a leaf */
+    uint32_t first_child;
+    uint32_t child_count;
+
+    /* Range of the node's bodies in Morton order */
+    uint32_t begin;
+    uint32_t count;
+};
+
+struct octree_subtree
+{
+    uint32_t node;
+    uint32_t begin;
+    uint32_t end;
+
+    struct octree_node* nodes;
+    uint32_t node_count;
+    uint32_t node_capacity;
+};
+
+struct octree
+{
+    double theta;
+    uint32_t leaf_size;
+
+    struct octree_node* nodes;
+    uint32_t node_count;
+    uint32_t node_capacity;
+
+    /* Bodies copied into Morton order; order[k] is the original index */
+    uint32_t body_count;
+    uint32_t body_capacity;
+    uint64_t* keys;
+    uint32_t* order;
+    double* x;
+    double* y;
+    double* z;
+    double* mass;
+
+    uint64_t* scratch_keys;
+    uint32_t* scratch_order;
+
+    uint32_t chunk_capacity;
+    uint32_t* histograms;
+    double* chunk_bounds;
+
+    struct octree_subtree subtrees[OCTREE_MAX_SUBTREES];
+    uint32_t subtree_count;
+
+    struct vec3 bounds_min;
+    float bounds_size;
+};
+
+void octree_init(struct octree* tree, double theta, uint32_t leaf_size);
+void octree_free(struct octree* tree);
+/* pool may be NULL; the resulting tree is identical either way */
+void octree_build(struct octree* tree, const struct bodies* bodies, struct thread_pool* pool);
+
+/* Evaluate accelerations for bodies [begin, end) in Morton order, writing to the original indices */
+void octree_accelerations_sorted(const struct octree* tree, struct bodies* bodies, uint32_t begin, uint32_t end, double g, double softening2);
+void octree_acceleration(const struct octree* tree, struct bodies* bodies, uint32_t index, double g, double softening2);
+
+#endif
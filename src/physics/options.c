@@ -0,0 +1,100 @@
+#include "options.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "scene.h"
+#include "ephemeris.h"
+
+void simulation_options_default(struct simulation_options* options)
+{
+    options->scene = "solar";
+    options->ephemeris = NULL;
+    options->asteroids = 2000;
+    options->seed = 1;
+    options->solver = GRAVITY_SOLVER_DIRECT;
+    options->theta = 0.5;
+    options->softening = 0.0;
+    options->integrator = INTEGRATOR_WISDOM_HOLMAN;
+    options->dt = 2.0;
+    options->threads = 0;
+}
+
+int simulation_options_parse(struct simulation_options* options, int argc, char** argv, int index)
+{
+    const char* arg = argv[index];
+    const char* value = index + 1 < argc ? argv[index + 1] : NULL;
+
+    if (strcmp(arg, "--barnes-hut") == 0) {
+        options->solver = GRAVITY_SOLVER_BARNES_HUT;
+        if (value && value[0] != '-') {
+            options->theta = strtod(value, NULL);
+            return 2;
+        }
+        return 1;
+    }
+
+    if (strcmp(arg, "--scene") != 0 && strcmp(arg, "--ephemeris") != 0 && strcmp(arg, "--asteroids") != 0 &&
+        strcmp(arg, "--seed") != 0 && strcmp(arg, "--softening") != 0 && strcmp(arg, "--integrator") != 0 &&
+        strcmp(arg, "--dt") != 0 && strcmp(arg, "--threads") != 0) {
+        return 0;
+    }
+    if (!value) {
+        fprintf(stderr, "Missing value for %s\n", arg);
+        return -1;
+    }
+
+    if (strcmp(arg, "--scene") == 0) {
+        options->scene = value;
+    } else if (strcmp(arg, "--ephemeris") == 0) {
+        options->ephemeris = value;
+    } else if (strcmp(arg, "--asteroids") == 0) {
+        options->asteroids = (uint32_t)strtoul(value, NULL, 10);
+    } else if (strcmp(arg, "--seed") == 0) {
+        options->seed = (uint32_t)strtoul(value, NULL, 10);
+    } else if (strcmp(arg, "--softening") == 0) {
+        options->softening = strtod(value, NULL);
+    } else if (strcmp(arg, "--integrator") == 0) {
+        if (!integrator_parse(value, &options->integrator)) {
+            fprintf(stderr, "Unknown integrator '%s' (leapfrog, yoshida4, wisdom-holman, block-leapfrog)\n", value);
+            return -1;
+        }
+    } else if (strcmp(arg, "--dt") == 0) {
+        options->dt = strtod(value, NULL);
+    } else if (strcmp(arg, "--threads") == 0) {
+        options->threads = (uint32_t)strtoul(value, NULL, 10);
+    }
+    return 2;
+}
+
+void simulation_options_usage(FILE* out)
+{
+    fputs("  --scene NAME          solar (Sun and planets) or sun (Sun only)\n"
+          "  --ephemeris FILE      move the major bodies along an ephemeris from ephemgen instead\n"
+          "  --asteroids N         asteroid belt size\n"
+          "  --seed N              asteroid belt random seed\n"
+          "  --barnes-hut [THETA]  Barnes-Hut gravity with opening angle THETA\n"
+          "  --softening EPS       gravitational softening length [AU]\n"
+          "  --integrator NAME     leapfrog, yoshida4, wisdom-holman or block-leapfrog\n"
+          "  --dt DAYS             step size (largest block step for block-leapfrog)\n"
+          "  --threads N           worker threads, 0 for every core\n", out);
+}
+
+bool simulation_options_apply(const struct simulation_options* options, struct simulation* sim, const struct ephemeris* eph)
+{
+    if (eph) {
+        scene_ephemeris(&sim->bodies, eph);
+        sim->time = eph->start;
+    } else if (!scene_load(&sim->bodies, options->scene)) {
+        fprintf(stderr, "Unknown scene '%s'\n", options->scene);
+        return false;
+    }
+    scene_asteroid_belt(&sim->bodies, options->asteroids, options->seed);
+
+    sim->dt = options->dt;
+    sim->gravity.softening = options->softening;
+    gravity_set_solver(&sim->gravity, options->solver, options->theta);
+    simulation_set_integrator(sim, options->integrator);
+    simulation_set_ephemeris(sim, eph);
+    return true;
+}
@@ -0,0 +1,45 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include "gravity.h"
+#include "integrator.h"
+#include "simulation.h"
+
+/* Command line settings shared by the windowed and headless front ends */
+struct simulation_options
+{
+    const char* scene;
+    /* Chebyshev ephemeris for the major bodies, replaces the scene; NULL integrates them */
+    const char* ephemeris;
+    uint32_t asteroids;
+    uint32_t seed;
+
+    enum gravity_solver solver;
+    double theta;
+    double softening;
+
+    enum integrator_type integrator;
+    double dt;
+
+    uint32_t threads;
+};
+
+void simulation_options_default(struct simulation_options* options);
+
+/* Returns the number of arguments consumed at argv[index], 0 if the option is
+ * not a simulation option and -1 if it is malformed */
+int simulation_options_parse(struct simulation_options* options, int argc, char** argv, int index);
+void simulation_options_usage(FILE* out);
+
+struct ephemeris;
+
+/* Loads the scene, or the bodies of eph when given, into an initialized
+ * simulation and applies the settings. The caller opens options->ephemeris
+ * as eph and keeps it open while the simulation runs. */
+bool simulation_options_apply(const struct simulation_options* options, struct simulation* sim, const struct ephemeris* eph);
+
+#endif
@@ -0,0 +1,164 @@
+#include "scene.h"
+
+#include <string.h>
+#include <math.h>
+
+#include "gravity.h"
+#include "ephemeris.h"
+#include "../util/util.h"
+
+struct planet
+{
+    /* a [AU], e, i [deg], node [deg], longitude of perihelion [deg], mean longitude [deg] */
+    double elements[6];
+    double mass;
+    double radius;
+};
+
+/* J2000 mean elements (Standish) and masses, radii in AU */
+static const struct planet planets[] = {
+    {{ 0.38709927, 0.20563593, 7.00497902,  48.33076593,  77.45779628, 252.25032350}, 1.660114e-7, 1.6308e-5},
+    {{ 0.72333566, 0.00677672, 3.39467605,  76.67984255, 131.60246718, 181.97909950}, 2.447838e-6, 4.0454e-5},
+    {{ 1.00000261, 0.01671123, 0.00001531,   0.0,        102.93768193, 100.46457166}, 3.040432e-6, 4.2635e-5},
+    {{ 1.52371034, 0.09339410, 1.84969142,  49.55953891, 336.05637041,  -4.55343205}, 3.227155e-7, 2.2657e-5},
+    {{ 5.20288700, 0.04838624, 1.30439695, 100.47390909,  14.72847983,  34.39644051}, 9.547919e-4, 4.6733e-4},
+    {{ 9.53667594, 0.05386179, 2.48599187, 113.66242448,  92.59887831,  49.95424423}, 2.858860e-4, 3.8926e-4},
+    {{19.18916464, 0.04725744, 0.77263783,  74.01692503, 170.95427630, 313.23810451}, 4.366244e-5, 1.6953e-4},
+    {{30.06992276, 0.00859048, 1.77004347, 131.78422574,  44.96476227, -55.12002969}, 5.151389e-5, 1.6459e-4}
+};
+
+static double to_radians(double degrees)
+{
+    return degrees * (M_PI / 180.0);
+}
+
+static double solve_kepler(double mean_anomaly, double e)
+{
+    double E = e < 0.8 ? mean_anomaly : M_PI;
+    for (uint32_t i = 0; i < 32; ++i) {
+        const double f = E - e * sin(E) - mean_anomaly;
+        const double step = f / (1.0 - e * cos(E));
+        E -= step;
+        if (fabs(step) < 1e-15) {
+            break;
+        }
+    }
+    return E;
+}
+
+static uint32_t next_random(uint32_t* state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static double random_range(uint32_t* state, double lo, double hi)
+{
+    return lo + (hi - lo) * (next_random(state) / 4294967296.0);
+}
+
+uint32_t scene_add_orbit(struct bodies* bodies, uint32_t central, double g, const double elements[6], double mass, double radius)
+{
+    const double a = elements[0];
+    const double e = elements[1];
+    const double inc = to_radians(elements[2]);
+    const double node = to_radians(elements[3]);
+    const double peri = to_radians(elements[4]) - node;
+    const double mean = to_radians(elements[5] - elements[4]);
+
+    const double E = solve_kepler(remainder(mean, 2.0 * M_PI), e);
+    const double mu = g * (bodies->mass[central] + mass);
+    const double b = a * sqrt(1.0 - e * e);
+    const double n = sqrt(mu / (a * a * a));
+    const double rdot = n / (1.0 - e * cos(E));
+
+    /* Position and velocity in the orbital plane */
+    const double px = a * (cos(E) - e);
+    const double py = b * sin(E);
+    const double vx = -a * sin(E) * rdot;
+    const double vy = b * cos(E) * rdot;
+
+    const double cw = cos(peri), sw = sin(peri);
+    const double cn = cos(node), sn = sin(node);
+    const double ci = cos(inc), si = sin(inc);
+
+    const double r[3][2] = {
+        {cw * cn - sw * sn * ci, -sw * cn - cw * sn * ci},
+        {cw * sn + sw * cn * ci, -sw * sn + cw * cn * ci},
+        {sw * si,                 cw * si}
+    };
+
+    double position[3], velocity[3];
+    position[0] = bodies->x[central] + r[0][0] * px + r[0][1] * py;
+    position[1] = bodies->y[central] + r[1][0] * px + r[1][1] * py;
+    position[2] = bodies->z[central] + r[2][0] * px + r[2][1] * py;
+    velocity[0] = bodies->vx[central] + r[0][0] * vx + r[0][1] * vy;
+    velocity[1] = bodies->vy[central] + r[1][0] * vx + r[1][1] * vy;
+    velocity[2] = bodies->vz[central] + r[2][0] * vx + r[2][1] * vy;
+
+    return bodies_add(bodies, position, velocity, mass, radius);
+}
+
+bool scene_load(struct bodies* bodies, const char* name)
+{
+    if (strcmp(name, "solar") == 0) {
+        scene_solar_system(bodies);
+    } else if (strcmp(name, "sun") == 0) {
+        scene_sun(bodies);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void scene_sun(struct bodies* bodies)
+{
+    const double origin[3] = {0.0, 0.0, 0.0};
+    bodies_clear(bodies);
+    bodies_add(bodies, origin, origin, 1.0, 4.6505e-3);
+}
+
+void scene_solar_system(struct bodies* bodies)
+{
+    scene_sun(bodies);
+
+    const uint32_t count = sizeof(planets) / sizeof(planets[0]);
+    bodies_reserve(bodies, count + 1);
+    for (uint32_t i = 0; i < count; ++i) {
+        scene_add_orbit(bodies, 0, GRAVITY_G_AU_MSUN_DAY, planets[i].elements, planets[i].mass, planets[i].radius);
+    }
+
+    bodies_to_barycentric(bodies);
+}
+
+void scene_ephemeris(struct bodies* bodies, const struct ephemeris* eph)
+{
+    bodies_clear(bodies);
+    bodies_reserve(bodies, eph->body_count);
+    for (uint32_t i = 0; i < eph->body_count; ++i) {
+        const double origin[3] = {0.0, 0.0, 0.0};
+        bodies_add(bodies, origin, origin, eph->bodies[i].mass, eph->bodies[i].radius);
+    }
+    ephemeris_evaluate(eph, eph->start, eph->body_count, bodies->x, bodies->y, bodies->z, bodies->vx, bodies->vy, bodies->vz);
+}
+
+void scene_asteroid_belt(struct bodies* bodies, uint32_t count, uint32_t seed)
+{
+    uint32_t state = seed ? seed : 0x9E3779B9u;
+    bodies_reserve(bodies, bodies->count + count);
+
+    for (uint32_t i = 0; i < count; ++i) {
+        double elements[6];
+        elements[0] = random_range(&state, 2.1, 3.3);
+        elements[1] = random_range(&state, 0.0, 0.2);
+        elements[2] = random_range(&state, 0.0, 15.0);
+        elements[3] = random_range(&state, 0.0, 360.0);
+        elements[4] = random_range(&state, 0.0, 360.0);
+        elements[5] = random_range(&state, 0.0, 360.0);
+        scene_add_orbit(bodies, 0, GRAVITY_G_AU_MSUN_DAY, elements, 1e-12, 1e-8);
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include "bodies.h"
+
+struct ephemeris;
+
+/* Scenes are in AU, days and solar masses; the Sun is always body 0. */
+
+bool scene_load(struct bodies* bodies, const char* name);
+void scene_sun(struct bodies* bodies);
+void scene_solar_system(struct bodies* bodies);
+/* The bodies of an ephemeris at its start time */
+void scene_ephemeris(struct bodies* bodies, const struct ephemeris* eph);
+void scene_asteroid_belt(struct bodies* bodies, uint32_t count, uint32_t seed);
+
+uint32_t scene_add_orbit(struct bodies* bodies, uint32_t central, double g, const double elements[6], double mass, double radius);
+
+#endif
@@ -0,0 +1,159 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "sim_thread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../util/timer.h"
+#include "../util/util.h"
+
+#define SIM_THREAD_PUBLISH_INTERVAL (1.0 / 240.0)
+#define SIM_THREAD_MAX_LAG 0.25
+
+static void frame_reserve(struct body_frame* frame, uint32_t count)
+{
+    if (count <= frame->capacity) {
+        return;
+    }
+    double** arrays[] = {&frame->x, &frame->y, &frame->z, &frame->mass, &frame->radius};
+    for (uint32_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); ++i) {
+        free(*arrays[i]);
+        *arrays[i] = util_allocate(count * sizeof(double), "a body frame");
+    }
+    frame->capacity = count;
+}
+
+static void frame_free(struct body_frame* frame)
+{
+    free(frame->x);
+    free(frame->y);
+    free(frame->z);
+    free(frame->mass);
+    free(frame->radius);
+    memset(frame, 0, sizeof(*frame));
+}
+
+static void publish(struct sim_thread* thread)
+{
+    const struct simulation* sim = thread->sim;
+    const uint32_t n = sim->bodies.count;
+    struct body_frame* frame = triple_buffer_back(&thread->buffer);
+
+    frame_reserve(frame, n);
+    frame->time = sim->time;
+    frame->steps = sim->steps;
+    frame->count = n;
+    memcpy(frame->x, sim->bodies.x, n * sizeof(double));
+    memcpy(frame->y, sim->bodies.y, n * sizeof(double));
+    memcpy(frame->z, sim->bodies.z, n * sizeof(double));
+    memcpy(frame->mass, sim->bodies.mass, n * sizeof(double));
+    memcpy(frame->radius, sim->bodies.radius, n * sizeof(double));
+
+    triple_buffer_publish(&thread->buffer);
+    atomic_fetch_add(&thread->published, 1);
+}
+
+static void sleep_seconds(double seconds)
+{
+    struct timespec ts;
+    ts.tv_sec = (time_t)seconds;
+    ts.tv_nsec = (long)((seconds - (double)ts.tv_sec) * 1e9);
+    nanosleep(&ts, NULL);
+}
+
+static void* sim_thread_main(void* argument)
+{
+    struct sim_thread* thread = argument;
+    struct simulation* sim = thread->sim;
+
+    double wall_start = timer_now();
+    double sim_start = sim->time;
+    double last_publish = wall_start;
+    bool dirty = false;
+
+    while (atomic_load(&thread->running))
+    {
+        const double now = timer_now();
+
+        if (atomic_load(&thread->paused)) {
+            wall_start = now;
+            sim_start = sim->time;
+            sleep_seconds(0.005);
+            continue;
+        }
+
+        const double target = sim_start + (now - wall_start) * thread->days_per_second;
+        if (sim->time + sim->dt > target) {
+            /* Ahead of real time: hand over what we have and wait */
+            if (dirty) {
+                publish(thread);
+                last_publish = now;
+                dirty = false;
+            }
+            sleep_seconds(0.001);
+            continue;
+        }
+
+        simulation_step(sim);
+        dirty = true;
+
+        if (now - last_publish >= SIM_THREAD_PUBLISH_INTERVAL) {
+            publish(thread);
+            last_publish = now;
+            dirty = false;
+        }
+
+        /* Too slow to keep up: let simulated time slip instead of spiralling */
+        if (target - sim->time > SIM_THREAD_MAX_LAG * thread->days_per_second) {
+            wall_start = now;
+            sim_start = sim->time;
+        }
+    }
+
+    if (dirty) {
+        publish(thread);
+    }
+    return NULL;
+}
+
+void sim_thread_start(struct sim_thread* thread, struct simulation* sim, double days_per_second)
+{
+    memset(thread->frames, 0, sizeof(thread->frames));
+    thread->sim = sim;
+    thread->days_per_second = days_per_second;
+    atomic_init(&thread->running, true);
+    atomic_init(&thread->paused, false);
+    atomic_init(&thread->published, 0);
+    triple_buffer_init(&thread->buffer, &thread->frames[0], &thread->frames[1], &thread->frames[2]);
+
+    /* The renderer gets the initial state before the first step completes */
+    publish(thread);
+
+    if (pthread_create(&thread->thread, NULL, sim_thread_main, thread) != 0) {
+        fputs("Failed to start the simulation thread!\n", stderr);
+        abort();
+    }
+}
+
+void sim_thread_stop(struct sim_thread* thread)
+{
+    atomic_store(&thread->running, false);
+    pthread_join(thread->thread, NULL);
+    for (uint32_t i = 0; i < 3; ++i) {
+        frame_free(&thread->frames[i]);
+    }
+}
+
+void sim_thread_set_paused(struct sim_thread* thread, bool paused)
+{
+    atomic_store(&thread->paused, paused);
+}
+
+const struct body_frame* sim_thread_acquire(struct sim_thread* thread)
+{
+    triple_buffer_acquire(&thread->buffer);
+    return triple_buffer_front(&thread->buffer);
+}
@@ -0,0 +1,52 @@
+#ifndef SIM_THREAD_H
+#define SIM_THREAD_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "simulation.h"
+#include "../util/triple_buffer.h"
+
+/* Read-only copy of the body state handed from the simulation thread to the renderer */
+struct body_frame
+{
+    double time;
+    uint64_t steps;
+
+    uint32_t count;
+    uint32_t capacity;
+    double* x;
+    double* y;
+    double* z;
+    double* mass;
+    double* radius;
+};
+
+/* Runs simulation_step on its own thread, paced to days_per_second of
+ * simulated time per wall-clock second, and publishes body frames. The
+ * simulation must not be touched by other threads until sim_thread_stop. */
+struct sim_thread
+{
+    struct simulation* sim;
+    double days_per_second;
+
+    pthread_t thread;
+    atomic_bool running;
+    atomic_bool paused;
+
+    struct body_frame frames[3];
+    struct triple_buffer buffer;
+
+    atomic_uint_fast64_t published;
+};
+
+void sim_thread_start(struct sim_thread* thread, struct simulation* sim, double days_per_second);
+void sim_thread_stop(struct sim_thread* thread);
+void sim_thread_set_paused(struct sim_thread* thread, bool paused);
+
+/* Latest published frame; stays valid until the next call from the same thread */
+const struct body_frame* sim_thread_acquire(struct sim_thread* thread);
+
+#endif
@@ -0,0 +1,86 @@
+#include "simulation.h"
+
+#include "ephemeris.h"
+#include "../util/thread_pool.h"
+
+void simulation_init(struct simulation* sim, uint32_t capacity, double dt)
+{
+    bodies_init(&sim->bodies, capacity);
+    gravity_init(&sim->gravity, GRAVITY_G_AU_MSUN_DAY, 0.0);
+    integrator_init(&sim->integrator, INTEGRATOR_WISDOM_HOLMAN);
+    sim->time = 0.0;
+    sim->dt = dt;
+    sim->steps = 0;
+    sim->pool = NULL;
+    sim->ephemeris = NULL;
+    sim->driven = 0;
+}
+
+void simulation_free(struct simulation* sim)
+{
+    integrator_free(&sim->integrator);
+    gravity_free(&sim->gravity);
+    bodies_free(&sim->bodies);
+}
+
+void simulation_set_thread_pool(struct simulation* sim, struct thread_pool* pool)
+{
+    sim->pool = pool;
+    sim->gravity.pool = pool;
+}
+
+void simulation_set_integrator(struct simulation* sim, enum integrator_type type)
+{
+    sim->integrator.type = type;
+    integrator_reset(&sim->integrator);
+}
+
+static void simulation_drive(struct simulation* sim)
+{
+    struct bodies* b = &sim->bodies;
+    ephemeris_evaluate(sim->ephemeris, sim->time, sim->driven, b->x, b->y, b->z, b->vx, b->vy, b->vz);
+}
+
+void simulation_set_ephemeris(struct simulation* sim, const struct ephemeris* eph)
+{
+    sim->ephemeris = eph;
+    sim->driven = 0;
+    if (eph) {
+        sim->driven = eph->body_count < sim->bodies.count ? eph->body_count : sim->bodies.count;
+        simulation_drive(sim);
+    }
+    integrator_reset(&sim->integrator);
+}
+
+void simulation_reset(struct simulation* sim)
+{
+    integrator_reset(&sim->integrator);
+}
+
+void simulation_step(struct simulation* sim)
+{
+    const double dt = sim->dt;
+    if (sim->ephemeris && !ephemeris_covers(sim->ephemeris, sim->time + dt)) {
+        /* The driven bodies already hold the last covered state, so integration just takes over */
+        simulation_set_ephemeris(sim, NULL);
+    }
+
+    /* Driven bodies are integrated along with the rest so the small bodies
+     * feel them mid-step, then snapped back onto the ephemeris */
+    if (!sim->ephemeris || sim->driven < sim->bodies.count) {
+        integrator_step(&sim->integrator, &sim->bodies, &sim->gravity, sim->pool, dt);
+    }
+
+    sim->time += dt;
+    sim->steps++;
+
+    if (sim->ephemeris) {
+        simulation_drive(sim);
+        integrator_synchronize(&sim->integrator, &sim->bodies);
+    }
+}
+
+double simulation_energy(struct simulation* sim)
+{
+    return bodies_kinetic_energy(&sim->bodies) + gravity_potential_energy(&sim->gravity, &sim->bodies);
+}
@@ -0,0 +1,45 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <inttypes.h>
+
+#include "bodies.h"
+#include "gravity.h"
+#include "integrator.h"
+
+struct thread_pool;
+struct ephemeris;
+
+struct simulation
+{
+    struct bodies bodies;
+    struct gravity gravity;
+    struct integrator integrator;
+
+    double time;
+    double dt;
+    uint64_t steps;
+
+    struct thread_pool* pool;
+
+    /* Bodies [0, driven) follow the ephemeris instead of being integrated */
+    const struct ephemeris* ephemeris;
+    uint32_t driven;
+};
+
+void simulation_init(struct simulation* sim, uint32_t capacity, double dt);
+void simulation_free(struct simulation* sim);
+void simulation_set_thread_pool(struct simulation* sim, struct thread_pool* pool);
+void simulation_set_integrator(struct simulation* sim, enum integrator_type type);
+
+/* Drives the leading bodies from eph, which must outlive the simulation, and
+ * moves them to its state at sim->time. Past the end of the ephemeris they
+ * carry on integrated. NULL integrates everything again. */
+void simulation_set_ephemeris(struct simulation* sim, const struct ephemeris* eph);
+
+/* Must be called after the bodies are edited outside of simulation_step */
+void simulation_reset(struct simulation* sim);
+void simulation_step(struct simulation* sim);
+double simulation_energy(struct simulation* sim);
+
+#endif
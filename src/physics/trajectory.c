@@ -0,0 +1,509 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "trajectory.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../util/util.h"
+
+#define TRAJECTORY_QUEUE_SLOTS 64
+/* A zigzag coded 64 bit value takes at most ten varint bytes */
+#define TRAJECTORY_MAX_VARINT 10
+
+/* A queue slot: the frame time, then body_count x, y and z */
+struct trajectory_frame
+{
+    double time;
+};
+
+static void sleep_seconds(double seconds)
+{
+    struct timespec ts;
+    ts.tv_sec = (time_t)seconds;
+    ts.tv_nsec = (long)((seconds - (double)ts.tv_sec) * 1e9);
+    nanosleep(&ts, NULL);
+}
+
+static bool write_all(int fd, const void* data, size_t size)
+{
+    const uint8_t* bytes = data;
+    while (size > 0)
+    {
+        const ssize_t written = write(fd, bytes, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        bytes += written;
+        size -= (size_t)written;
+    }
+    return true;
+}
+
+/* Extrapolates the next grid position from the last ones, newest first: a
+ * constant, then a line, then a parabola once three frames are known */
+static int64_t predict(const int64_t history[3], uint32_t known)
+{
+    switch (known) {
+    case 0:
+        return 0;
+    case 1:
+        return history[0];
+    case 2:
+        return 2 * history[0] - history[1];
+    default:
+        return 3 * history[0] - 3 * history[1] + history[2];
+    }
+}
+
+static void remember(int64_t history[3], int64_t value)
+{
+    history[2] = history[1];
+    history[1] = history[0];
+    history[0] = value;
+}
+
+static uint8_t* put_varint(uint8_t* out, int64_t value)
+{
+    uint64_t zigzag = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+    while (zigzag >= 0x80) {
+        *out++ = (uint8_t)(zigzag | 0x80);
+        zigzag >>= 7;
+    }
+    *out++ = (uint8_t)zigzag;
+    return out;
+}
+
+static const uint8_t* get_varint(const uint8_t* in, const uint8_t* end, int64_t* value)
+{
+    uint64_t zigzag = 0;
+    for (uint32_t shift = 0; in < end && shift < 64; shift += 7)
+    {
+        const uint8_t byte = *in++;
+        zigzag |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+            return in;
+        }
+    }
+    return NULL;
+}
+
+static void write_chunk(struct trajectory_writer* writer)
+{
+    const uint32_t frames = writer->frame_count;
+    const uint32_t bodies = writer->body_count;
+    if (frames == 0) {
+        return;
+    }
+
+    const size_t prefix = sizeof(struct trajectory_chunk_header) + frames * sizeof(double) + (bodies + 1) * sizeof(uint32_t);
+    uint8_t* out = writer->buffer + prefix;
+    uint32_t* offsets = (uint32_t*)(writer->buffer + sizeof(struct trajectory_chunk_header) + frames * sizeof(double));
+    for (uint32_t body = 0; body < bodies; ++body)
+    {
+        offsets[body] = (uint32_t)(out - (writer->buffer + prefix));
+        int64_t history[3][3] = {{0}};
+        for (uint32_t frame = 0; frame < frames; ++frame) {
+            const int64_t* position = writer->grid + ((size_t)frame * bodies + body) * 3;
+            for (uint32_t axis = 0; axis < 3; ++axis) {
+                out = put_varint(out, position[axis] - predict(history[axis], frame));
+                remember(history[axis], position[axis]);
+            }
+        }
+    }
+    offsets[bodies] = (uint32_t)(out - (writer->buffer + prefix));
+
+    /* Chunks stay 8 byte aligned so the frame times can be read in place */
+    while ((out - writer->buffer) % 8 != 0) {
+        *out++ = 0;
+    }
+    const size_t size = (size_t)(out - writer->buffer);
+
+    struct trajectory_chunk_header header = {
+        .magic = TRAJECTORY_CHUNK_MAGIC,
+        .frame_count = frames,
+        .size = size - sizeof(header),
+        .first_time = writer->times[0],
+        .last_time = writer->times[frames - 1],
+    };
+    memcpy(writer->buffer, &header, sizeof(header));
+    memcpy(writer->buffer + sizeof(header), writer->times, frames * sizeof(double));
+
+    if (!writer->failed && !write_all(writer->fd, writer->buffer, size)) {
+        writer->failed = true;
+    }
+
+    if (writer->chunk_count == writer->chunk_capacity) {
+        writer->chunk_capacity = writer->chunk_capacity ? 2 * writer->chunk_capacity : 64;
+        writer->chunks = util_reallocate(writer->chunks, writer->chunk_capacity * sizeof(struct trajectory_chunk), "the trajectory index");
+    }
+    writer->chunks[writer->chunk_count++] = (struct trajectory_chunk){
+        .offset = writer->offset,
+        .frame_count = frames,
+        .first_time = header.first_time,
+        .last_time = header.last_time,
+    };
+    writer->offset += size;
+    writer->frame_count = 0;
+}
+
+static void add_frame(struct trajectory_writer* writer, const struct trajectory_frame* frame)
+{
+    const uint32_t bodies = writer->body_count;
+    const double* x = (const double*)(frame + 1);
+    const double* y = x + bodies;
+    const double* z = y + bodies;
+    const double scale = 1.0 / writer->quantum;
+
+    int64_t* grid = writer->grid + (size_t)writer->frame_count * bodies * 3;
+    for (uint32_t i = 0; i < bodies; ++i) {
+        grid[3 * i + 0] = llround(x[i] * scale);
+        grid[3 * i + 1] = llround(y[i] * scale);
+        grid[3 * i + 2] = llround(z[i] * scale);
+    }
+    writer->times[writer->frame_count++] = frame->time;
+
+    if (writer->frame_count == writer->chunk_frames) {
+        write_chunk(writer);
+    }
+}
+
+static void* trajectory_writer_main(void* argument)
+{
+    struct trajectory_writer* writer = argument;
+    while (true)
+    {
+        /* Read the flag first: the producer's last push happens before it clears it */
+        const bool stopping = !atomic_load(&writer->running);
+        const struct trajectory_frame* frame = spsc_queue_peek(&writer->queue);
+        if (!frame) {
+            if (stopping) {
+                break;
+            }
+            sleep_seconds(0.0005);
+            continue;
+        }
+        add_frame(writer, frame);
+        spsc_queue_pop(&writer->queue);
+    }
+    write_chunk(writer);
+    return NULL;
+}
+
+bool trajectory_writer_open(struct trajectory_writer* writer, const char* path, uint32_t body_count, double tolerance,
+                            uint32_t chunk_frames)
+{
+    memset(writer, 0, sizeof(*writer));
+    writer->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (writer->fd < 0) {
+        fprintf(stderr, "Failed to create the trajectory '%s'!\n", path);
+        return false;
+    }
+
+    writer->body_count = body_count;
+    writer->chunk_frames = chunk_frames > 0 ? chunk_frames : 1;
+    /* Rounding to the nearest grid point errs by at most half a spacing */
+    writer->quantum = 2.0 * tolerance;
+
+    const struct trajectory_header header = {
+        .magic = TRAJECTORY_MAGIC,
+        .version = TRAJECTORY_VERSION,
+        .body_count = body_count,
+        .chunk_frames = writer->chunk_frames,
+        .quantum = writer->quantum,
+    };
+    if (!write_all(writer->fd, &header, sizeof(header))) {
+        fprintf(stderr, "Failed to write the trajectory '%s'!\n", path);
+        close(writer->fd);
+        return false;
+    }
+    writer->offset = sizeof(header);
+
+    const size_t frames = writer->chunk_frames;
+    writer->times = util_allocate(frames * sizeof(double), "the trajectory writer");
+    writer->grid = util_allocate(frames * body_count * 3 * sizeof(int64_t), "the trajectory writer");
+    writer->buffer_capacity = sizeof(struct trajectory_chunk_header) + frames * sizeof(double) + (body_count + 1) * sizeof(uint32_t) +
+                              frames * body_count * 3 * TRAJECTORY_MAX_VARINT + 8;
+    writer->buffer = util_allocate(writer->buffer_capacity, "the trajectory writer");
+
+    spsc_queue_init(&writer->queue, sizeof(struct trajectory_frame) + 3 * body_count * sizeof(double), TRAJECTORY_QUEUE_SLOTS);
+    atomic_init(&writer->running, true);
+    if (pthread_create(&writer->thread, NULL, trajectory_writer_main, writer) != 0) {
+        fputs("Failed to start the trajectory writer!\n", stderr);
+        abort();
+    }
+    return true;
+}
+
+void trajectory_writer_record(struct trajectory_writer* writer, const struct simulation* sim)
+{
+    struct trajectory_frame* frame = spsc_queue_reserve(&writer->queue);
+    if (!frame) {
+        /* The disk is behind; wait rather than drop frames */
+        ++writer->stalls;
+        while (!(frame = spsc_queue_reserve(&writer->queue))) {
+            sleep_seconds(0.0001);
+        }
+    }
+
+    const uint32_t n = writer->body_count;
+    double* x = (double*)(frame + 1);
+    frame->time = sim->time;
+    memcpy(x, sim->bodies.x, n * sizeof(double));
+    memcpy(x + n, sim->bodies.y, n * sizeof(double));
+    memcpy(x + 2 * n, sim->bodies.z, n * sizeof(double));
+
+    spsc_queue_push(&writer->queue);
+    ++writer->frames;
+}
+
+bool trajectory_writer_close(struct trajectory_writer* writer)
+{
+    atomic_store(&writer->running, false);
+    pthread_join(writer->thread, NULL);
+
+    const struct trajectory_trailer trailer = {
+        .index_offset = writer->offset,
+        .chunk_count = writer->chunk_count,
+        .magic = TRAJECTORY_INDEX_MAGIC,
+    };
+    bool written = !writer->failed && write_all(writer->fd, writer->chunks, writer->chunk_count * sizeof(struct trajectory_chunk)) &&
+                   write_all(writer->fd, &trailer, sizeof(trailer));
+    written = close(writer->fd) == 0 && written;
+
+    spsc_queue_free(&writer->queue);
+    free(writer->times);
+    free(writer->grid);
+    free(writer->buffer);
+    free(writer->chunks);
+    writer->fd = -1;
+    writer->times = NULL;
+    writer->grid = NULL;
+    writer->buffer = NULL;
+    writer->chunks = NULL;
+    return written;
+}
+
+/* A chunk header that fits in the file with a sane frame count, or NULL */
+static const struct trajectory_chunk_header* chunk_at(const struct trajectory_reader* reader, uint64_t offset)
+{
+    if (offset % 8 != 0 || offset > reader->size || reader->size - offset < sizeof(struct trajectory_chunk_header)) {
+        return NULL;
+    }
+    const struct trajectory_chunk_header* header = (const struct trajectory_chunk_header*)(reader->mapping + offset);
+    const uint64_t prefix = header->frame_count * sizeof(double) + (reader->header.body_count + 1) * (uint64_t)sizeof(uint32_t);
+    const bool valid = header->magic == TRAJECTORY_CHUNK_MAGIC && header->frame_count > 0 &&
+                       header->frame_count <= reader->header.chunk_frames && header->size >= prefix &&
+                       header->size <= reader->size - offset - sizeof(*header);
+    return valid ? header : NULL;
+}
+
+static bool read_index(struct trajectory_reader* reader)
+{
+    const size_t tail = sizeof(struct trajectory_header) + sizeof(struct trajectory_trailer);
+    if (reader->size < tail) {
+        return false;
+    }
+    struct trajectory_trailer trailer;
+    memcpy(&trailer, reader->mapping + reader->size - sizeof(trailer), sizeof(trailer));
+    const uint64_t index_size = (uint64_t)trailer.chunk_count * sizeof(struct trajectory_chunk);
+    if (trailer.magic != TRAJECTORY_INDEX_MAGIC || trailer.index_offset < sizeof(struct trajectory_header) ||
+        trailer.index_offset > reader->size - sizeof(trailer) || index_size != reader->size - sizeof(trailer) - trailer.index_offset) {
+        return false;
+    }
+
+    reader->chunks = util_allocate(index_size, "the trajectory index");
+    memcpy(reader->chunks, reader->mapping + trailer.index_offset, index_size);
+    reader->chunk_count = trailer.chunk_count;
+    return true;
+}
+
+/* Without an index, e.g. after a crash, every intact chunk up to the first torn one */
+static void recover_index(struct trajectory_reader* reader)
+{
+    uint32_t capacity = 64;
+    reader->chunks = util_allocate(capacity * sizeof(struct trajectory_chunk), "the trajectory index");
+
+    uint64_t offset = sizeof(struct trajectory_header);
+    const struct trajectory_chunk_header* header;
+    while ((header = chunk_at(reader, offset)))
+    {
+        if (reader->chunk_count == capacity) {
+            capacity *= 2;
+            reader->chunks = util_reallocate(reader->chunks, capacity * sizeof(struct trajectory_chunk), "the trajectory index");
+        }
+        reader->chunks[reader->chunk_count++] = (struct trajectory_chunk){
+            .offset = offset,
+            .frame_count = header->frame_count,
+            .first_time = header->first_time,
+            .last_time = header->last_time,
+        };
+        offset += sizeof(*header) + header->size;
+    }
+    reader->recovered = true;
+}
+
+bool trajectory_reader_open(struct trajectory_reader* reader, const char* path)
+{
+    memset(reader, 0, sizeof(*reader));
+
+    int fd = open(path, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(struct trajectory_header)) {
+        fprintf(stderr, "Failed to open the trajectory '%s'!\n", path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+
+    const size_t size = (size_t)info.st_size;
+    const uint8_t* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        fprintf(stderr, "Failed to map the trajectory '%s'!\n", path);
+        return false;
+    }
+
+    memcpy(&reader->header, mapping, sizeof(reader->header));
+    if (reader->header.magic != TRAJECTORY_MAGIC || reader->header.version != TRAJECTORY_VERSION ||
+        reader->header.chunk_frames == 0 || !(reader->header.quantum > 0.0)) {
+        fprintf(stderr, "Trajectory '%s' is corrupt or from another version!\n", path);
+        munmap((void*)mapping, size);
+        return false;
+    }
+
+    /* Stream offsets are read lazily, one chunk at a time */
+    posix_madvise((void*)mapping, size, POSIX_MADV_RANDOM);
+    reader->mapping = mapping;
+    reader->size = size;
+    if (!read_index(reader)) {
+        recover_index(reader);
+    }
+    return true;
+}
+
+void trajectory_reader_close(struct trajectory_reader* reader)
+{
+    if (reader->mapping) {
+        munmap((void*)reader->mapping, reader->size);
+    }
+    free(reader->chunks);
+    memset(reader, 0, sizeof(*reader));
+}
+
+uint32_t trajectory_reader_find(const struct trajectory_reader* reader, double time)
+{
+    /* The last chunk starting at or before time */
+    uint32_t low = 0;
+    uint32_t high = reader->chunk_count;
+    while (high - low > 1)
+    {
+        const uint32_t middle = low + (high - low) / 2;
+        if (reader->chunks[middle].first_time <= time) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+static bool enter_chunk(struct trajectory_track* track, uint32_t chunk)
+{
+    const struct trajectory_reader* reader = track->reader;
+    track->chunk = chunk;
+    track->frame = 0;
+    track->frame_count = 0;
+    if (chunk >= reader->chunk_count) {
+        return false;
+    }
+
+    const struct trajectory_chunk_header* header = chunk_at(reader, reader->chunks[chunk].offset);
+    if (!header) {
+        return false;
+    }
+    const uint32_t bodies = reader->header.body_count;
+    const uint8_t* times = (const uint8_t*)(header + 1);
+    const uint8_t* offsets = times + header->frame_count * sizeof(double);
+    const uint8_t* streams = offsets + (bodies + 1) * sizeof(uint32_t);
+    const uint64_t stream_space = header->size - (uint64_t)(streams - times);
+
+    uint32_t first, last;
+    memcpy(&first, offsets + track->body * sizeof(uint32_t), sizeof(first));
+    memcpy(&last, offsets + (track->body + 1) * sizeof(uint32_t), sizeof(last));
+    if (first > last || last > stream_space) {
+        return false;
+    }
+
+    track->times = times;
+    track->cursor = streams + first;
+    track->end = streams + last;
+    track->frame_count = header->frame_count;
+    memset(track->history, 0, sizeof(track->history));
+    return true;
+}
+
+void trajectory_track_begin(struct trajectory_track* track, const struct trajectory_reader* reader, uint32_t body, double start)
+{
+    memset(track, 0, sizeof(*track));
+    track->reader = reader;
+    track->body = body;
+    track->start = start;
+    if (body >= reader->header.body_count || !enter_chunk(track, trajectory_reader_find(reader, start))) {
+        track->chunk = reader->chunk_count;
+    }
+}
+
+bool trajectory_track_next(struct trajectory_track* track, double* time, double position[3])
+{
+    while (true)
+    {
+        if (track->frame == track->frame_count) {
+            /* A chunk that fails to open leaves frame_count at 0 and ends the track */
+            if (track->chunk >= track->reader->chunk_count || !enter_chunk(track, track->chunk + 1)) {
+                track->chunk = track->reader->chunk_count;
+                return false;
+            }
+        }
+
+        int64_t grid[3];
+        for (uint32_t axis = 0; axis < 3; ++axis) {
+            int64_t residual;
+            track->cursor = get_varint(track->cursor, track->end, &residual);
+            if (!track->cursor) {
+                track->frame_count = track->frame = 0;
+                track->chunk = track->reader->chunk_count;
+                return false;
+            }
+            grid[axis] = predict(track->history[axis], track->frame) + residual;
+            remember(track->history[axis], grid[axis]);
+        }
+
+        double frame_time;
+        memcpy(&frame_time, track->times + track->frame * sizeof(double), sizeof(frame_time));
+        ++track->frame;
+        if (frame_time < track->start) {
+            continue;
+        }
+
+        const double quantum = track->reader->header.quantum;
+        *time = frame_time;
+        position[0] = grid[0] * quantum;
+        position[1] = grid[1] * quantum;
+        position[2] = grid[2] * quantum;
+        return true;
+    }
+}
@@ -0,0 +1,143 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <stddef.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "simulation.h"
+#include "../util/spsc_queue.h"
+
+/*
+ * Compressed body trajectories. Positions are rounded to a grid of twice the
+ * tolerance and stored as the difference from a polynomial extrapolation of
+ * the previous frames, zigzag varint coded. Frames are grouped in chunks;
+ * within a chunk every body has its own byte stream, so one body's track is
+ * read without touching the others. An index of chunk times at the end of
+ * the file makes seeking a binary search; a file cut short without its index
+ * is recovered by walking the chunk headers.
+ */
+
+#define TRAJECTORY_MAGIC 0x52545353u       /* "SSTR" */
+#define TRAJECTORY_CHUNK_MAGIC 0x43545353u /* "SSTC" */
+#define TRAJECTORY_INDEX_MAGIC 0x49545353u /* "SSTI" */
+#define TRAJECTORY_VERSION 1
+/* Frames per chunk: seeking decodes at most this many frames of one body */
+#define TRAJECTORY_CHUNK_FRAMES 256
+
+struct trajectory_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t body_count;
+    uint32_t chunk_frames;
+    /* Grid spacing in AU; positions are within half of it */
+    double quantum;
+};
+
+/* Followed by the frame times, body_count + 1 stream offsets and the streams */
+struct trajectory_chunk_header
+{
+    uint32_t magic;
+    uint32_t frame_count;
+    /* Bytes after this header */
+    uint64_t size;
+    double first_time;
+    double last_time;
+};
+
+struct trajectory_chunk
+{
+    uint64_t offset;
+    uint32_t frame_count;
+    uint32_t reserved;
+    double first_time;
+    double last_time;
+};
+
+/* The last bytes of a complete file; the chunk index sits just before it */
+struct trajectory_trailer
+{
+    uint64_t index_offset;
+    uint32_t chunk_count;
+    uint32_t magic;
+};
+
+/* Copies frames into a lock-free queue; a dedicated thread quantizes,
+ * encodes and writes them, so recording costs the step three memcpys. */
+struct trajectory_writer
+{
+    int fd;
+    uint32_t body_count;
+    uint32_t chunk_frames;
+    double quantum;
+
+    struct spsc_queue queue;
+    pthread_t thread;
+    atomic_bool running;
+
+    /* I/O thread only: the open chunk, quantized, frame-major */
+    uint32_t frame_count;
+    double* times;
+    int64_t* grid;
+    uint8_t* buffer;
+    size_t buffer_capacity;
+    struct trajectory_chunk* chunks;
+    uint32_t chunk_count;
+    uint32_t chunk_capacity;
+    uint64_t offset;
+    bool failed;
+
+    /* Producer only: frames that waited for room in the queue */
+    uint64_t frames;
+    uint64_t stalls;
+};
+
+bool trajectory_writer_open(struct trajectory_writer* writer, const char* path, uint32_t body_count, double tolerance,
+                            uint32_t chunk_frames);
+/* Queues the positions of the first body_count bodies; blocks only while the queue is full */
+void trajectory_writer_record(struct trajectory_writer* writer, const struct simulation* sim);
+/* Drains the queue, writes the last chunk and the index; false if any write failed */
+bool trajectory_writer_close(struct trajectory_writer* writer);
+
+struct trajectory_reader
+{
+    const uint8_t* mapping;
+    size_t size;
+    struct trajectory_header header;
+
+    struct trajectory_chunk* chunks;
+    uint32_t chunk_count;
+    /* Chunks found by walking the headers because the index was missing */
+    bool recovered;
+};
+
+bool trajectory_reader_open(struct trajectory_reader* reader, const char* path);
+void trajectory_reader_close(struct trajectory_reader* reader);
+
+/* The chunk holding time, clamped to the first and last chunk */
+uint32_t trajectory_reader_find(const struct trajectory_reader* reader, double time);
+
+/* Streams one body's track from a start time, decoding only its bytes */
+struct trajectory_track
+{
+    const struct trajectory_reader* reader;
+    uint32_t body;
+    double start;
+    uint32_t chunk;
+    uint32_t frame;
+    uint32_t frame_count;
+
+    const uint8_t* times;
+    const uint8_t* cursor;
+    const uint8_t* end;
+    int64_t history[3][3];
+};
+
+void trajectory_track_begin(struct trajectory_track* track, const struct trajectory_reader* reader, uint32_t body, double start);
+/* The next frame at or after the start time; false at the end of the file or on a corrupt chunk */
+bool trajectory_track_next(struct trajectory_track* track, double* time, double position[3]);
+
+#endif
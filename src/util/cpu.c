@@ -0,0 +1,39 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "cpu.h"
+
+#include <pthread.h>
+
+static uint32_t features = 0;
+static pthread_once_t features_once = PTHREAD_ONCE_INIT;
+
+static void detect_features(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) features |= CPU_FEATURE_SSE2;
+    if (__builtin_cpu_supports("avx")) features |= CPU_FEATURE_AVX;
+    if (__builtin_cpu_supports("avx2")) features |= CPU_FEATURE_AVX2;
+    if (__builtin_cpu_supports("fma")) features |= CPU_FEATURE_FMA;
+#endif
+}
+
+uint32_t cpu_features(void)
+{
+    /* Called from the render, simulation and worker threads; pthread_once
+     * also orders the feature bits before any caller reads them */
+    pthread_once(&features_once, detect_features);
+    return features;
+}
+
+const char* cpu_feature_name(enum cpu_feature feature)
+{
+    switch (feature)
+    {
+    case CPU_FEATURE_SSE2: return "SSE2";
+    case CPU_FEATURE_AVX: return "AVX";
+    case CPU_FEATURE_AVX2: return "AVX2";
+    case CPU_FEATURE_FMA: return "FMA";
+    default: return "UNKNOWN";
+    }
+}
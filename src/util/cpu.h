@@ -0,0 +1,17 @@
+#ifndef CPU_H
+#define CPU_H
+
+#include <inttypes.h>
+
+enum cpu_feature
+{
+    CPU_FEATURE_SSE2 = 1 << 0,
+    CPU_FEATURE_AVX = 1 << 1,
+    CPU_FEATURE_AVX2 = 1 << 2,
+    CPU_FEATURE_FMA = 1 << 3
+};
+
+uint32_t cpu_features(void);
+const char* cpu_feature_name(enum cpu_feature feature);
+
+#endif
@@ -0,0 +1,66 @@
+#include "spsc_queue.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "util.h"
+
+void spsc_queue_init(struct spsc_queue* queue, size_t slot_size, uint32_t slot_count)
+{
+    uint32_t count = 2;
+    while (count < slot_count) {
+        count *= 2;
+    }
+
+    /* Slots start on their own cache lines */
+    queue->slot_size = (slot_size + 63) & ~(size_t)63;
+    queue->mask = count - 1;
+    queue->slots = util_allocate_aligned(64, queue->slot_size * count, "the queue");
+
+    atomic_init(&queue->pushed, 0);
+    queue->cached_popped = 0;
+    atomic_init(&queue->popped, 0);
+    queue->cached_pushed = 0;
+}
+
+void spsc_queue_free(struct spsc_queue* queue)
+{
+    free(queue->slots);
+    queue->slots = NULL;
+}
+
+void* spsc_queue_reserve(struct spsc_queue* queue)
+{
+    const uint32_t pushed = atomic_load_explicit(&queue->pushed, memory_order_relaxed);
+    if (pushed - queue->cached_popped > queue->mask) {
+        queue->cached_popped = atomic_load_explicit(&queue->popped, memory_order_acquire);
+        if (pushed - queue->cached_popped > queue->mask) {
+            return NULL;
+        }
+    }
+    return queue->slots + (pushed & queue->mask) * queue->slot_size;
+}
+
+void spsc_queue_push(struct spsc_queue* queue)
+{
+    const uint32_t pushed = atomic_load_explicit(&queue->pushed, memory_order_relaxed);
+    atomic_store_explicit(&queue->pushed, pushed + 1, memory_order_release);
+}
+
+void* spsc_queue_peek(struct spsc_queue* queue)
+{
+    const uint32_t popped = atomic_load_explicit(&queue->popped, memory_order_relaxed);
+    if (popped == queue->cached_pushed) {
+        queue->cached_pushed = atomic_load_explicit(&queue->pushed, memory_order_acquire);
+        if (popped == queue->cached_pushed) {
+            return NULL;
+        }
+    }
+    return queue->slots + (popped & queue->mask) * queue->slot_size;
+}
+
+void spsc_queue_pop(struct spsc_queue* queue)
+{
+    const uint32_t popped = atomic_load_explicit(&queue->popped, memory_order_relaxed);
+    atomic_store_explicit(&queue->popped, popped + 1, memory_order_release);
+}
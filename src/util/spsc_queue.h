@@ -0,0 +1,40 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stddef.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+
+/* Lock-free single-producer single-consumer ring of fixed-size slots. The
+ * producer fills a reserved slot in place and pushes it; the consumer peeks
+ * the oldest slot and pops it when done, so nothing is copied twice. Each
+ * side caches the other's counter and only reloads it when the ring looks
+ * full or empty, keeping the shared cache lines quiet. */
+struct spsc_queue
+{
+    uint8_t* slots;
+    size_t slot_size;
+    uint32_t mask;
+
+    /* Written by the producer */
+    _Alignas(64) atomic_uint pushed;
+    uint32_t cached_popped;
+
+    /* Written by the consumer */
+    _Alignas(64) atomic_uint popped;
+    uint32_t cached_pushed;
+};
+
+/* slot_count is rounded up to a power of two */
+void spsc_queue_init(struct spsc_queue* queue, size_t slot_size, uint32_t slot_count);
+void spsc_queue_free(struct spsc_queue* queue);
+
+/* Producer: a free slot, or NULL if the ring is full */
+void* spsc_queue_reserve(struct spsc_queue* queue);
+void spsc_queue_push(struct spsc_queue* queue);
+
+/* Consumer: the oldest pushed slot, or NULL if the ring is empty */
+void* spsc_queue_peek(struct spsc_queue* queue);
+void spsc_queue_pop(struct spsc_queue* queue);
+
+#endif
@@ -0,0 +1,231 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "thread_pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "util.h"
+
+struct worker_start
+{
+    struct thread_pool* pool;
+    uint32_t index;
+};
+
+static uint64_t pack_range(uint32_t begin, uint32_t end)
+{
+    return (uint64_t)begin | ((uint64_t)end << 32);
+}
+
+static void deque_reset(struct thread_pool_deque* deque)
+{
+    atomic_store(&deque->top, 0);
+    atomic_store(&deque->bottom, 0);
+}
+
+static void deque_push(struct thread_pool_deque* deque, uint64_t task)
+{
+    const int_fast64_t b = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    atomic_store_explicit(&deque->tasks[b % THREAD_POOL_DEQUE_SIZE], task, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+}
+
+static bool deque_pop(struct thread_pool_deque* deque, uint64_t* task)
+{
+    const int_fast64_t b = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&deque->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int_fast64_t t = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+    if (t > b) {
+        atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+        return false;
+    }
+
+    *task = atomic_load_explicit(&deque->tasks[b % THREAD_POOL_DEQUE_SIZE], memory_order_relaxed);
+    if (t == b) {
+        /* Last task: race against thieves for it */
+        const bool won = atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed);
+        atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+        return won;
+    }
+    return true;
+}
+
+static bool deque_steal(struct thread_pool_deque* deque, uint64_t* task)
+{
+    int_fast64_t t = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    const int_fast64_t b = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    if (t >= b) {
+        return false;
+    }
+
+    *task = atomic_load_explicit(&deque->tasks[t % THREAD_POOL_DEQUE_SIZE], memory_order_relaxed);
+    return atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed);
+}
+
+static bool find_task(struct thread_pool* pool, uint32_t worker, uint32_t* seed, uint64_t* task)
+{
+    if (deque_pop(&pool->deques[worker], task)) {
+        return true;
+    }
+
+    const uint32_t n = pool->thread_count;
+    *seed = *seed * 1664525u + 1013904223u;
+    const uint32_t start = (*seed >> 8) % n;
+    for (uint32_t k = 0; k < n; ++k) {
+        const uint32_t victim = (start + k) % n;
+        if (victim != worker && deque_steal(&pool->deques[victim], task)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void run_job(struct thread_pool* pool, uint32_t worker)
+{
+    uint32_t seed = 0x9E3779B9u * (worker + 1);
+    while (atomic_load(&pool->remaining) > 0)
+    {
+        uint64_t task;
+        if (!find_task(pool, worker, &seed, &task)) {
+            sched_yield();
+            continue;
+        }
+
+        const uint32_t begin = (uint32_t)task;
+        uint32_t end = (uint32_t)(task >> 32);
+
+        /* Split off the upper halves so idle workers have something to steal */
+        while (end - begin > pool->grain) {
+            const uint32_t mid = begin + (end - begin) / 2;
+            deque_push(&pool->deques[worker], pack_range(mid, end));
+            end = mid;
+        }
+
+        pool->fn(pool->context, begin, end, worker);
+        atomic_fetch_sub(&pool->remaining, end - begin);
+    }
+}
+
+static void* worker_main(void* argument)
+{
+    struct worker_start* start = argument;
+    struct thread_pool* pool = start->pool;
+    const uint32_t index = start->index;
+    free(start);
+
+    uint64_t seen = 0;
+    for (;;)
+    {
+        pthread_mutex_lock(&pool->mutex);
+        while (!pool->shutdown && pool->generation == seen) {
+            pthread_cond_wait(&pool->wake, &pool->mutex);
+        }
+        if (pool->shutdown) {
+            pthread_mutex_unlock(&pool->mutex);
+            break;
+        }
+        seen = pool->generation;
+        atomic_fetch_add(&pool->busy, 1);
+        pthread_mutex_unlock(&pool->mutex);
+
+        run_job(pool, index);
+        atomic_fetch_sub(&pool->busy, 1);
+    }
+    return NULL;
+}
+
+void thread_pool_init(struct thread_pool* pool, uint32_t thread_count)
+{
+    if (thread_count == 0) {
+        const long online = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = online > 0 ? (uint32_t)online : 1;
+    }
+
+    pool->thread_count = thread_count;
+    pool->generation = 0;
+    pool->shutdown = false;
+    pool->fn = NULL;
+    pool->context = NULL;
+    pool->grain = 1;
+    atomic_init(&pool->remaining, 0);
+    atomic_init(&pool->busy, 0);
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+
+    pool->deques = util_allocate_aligned(64, thread_count * sizeof(struct thread_pool_deque), "the thread pool");
+    pool->threads = util_allocate_zeroed(thread_count * sizeof(pthread_t), "the thread pool");
+    for (uint32_t i = 0; i < thread_count; ++i) {
+        deque_reset(&pool->deques[i]);
+    }
+
+    for (uint32_t i = 1; i < thread_count; ++i) {
+        struct worker_start* start = util_allocate(sizeof(*start), "a worker thread");
+        start->pool = pool;
+        start->index = i;
+        if (pthread_create(&pool->threads[i], NULL, worker_main, start) != 0) {
+            fputs("Failed to start a worker thread!\n", stderr);
+            abort();
+        }
+    }
+}
+
+void thread_pool_free(struct thread_pool* pool)
+{
+    pthread_mutex_lock(&pool->mutex);
+    pool->shutdown = true;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (uint32_t i = 1; i < pool->thread_count; ++i) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool->threads);
+    free(pool->deques);
+    pool->threads = NULL;
+    pool->deques = NULL;
+    pool->thread_count = 0;
+}
+
+void thread_pool_parallel_for(struct thread_pool* pool, uint32_t count, uint32_t grain, thread_pool_fn fn, void* context)
+{
+    if (count == 0) {
+        return;
+    }
+    grain = grain > 0 ? grain : 1;
+    if (!pool || pool->thread_count <= 1 || count <= grain) {
+        fn(context, 0, count, 0);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->fn = fn;
+    pool->context = context;
+    pool->grain = grain;
+    atomic_store(&pool->remaining, count);
+    deque_push(&pool->deques[0], pack_range(0, count));
+    pool->generation++;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->mutex);
+
+    run_job(pool, 0);
+
+    /* Workers may still be between their last range and noticing completion */
+    while (atomic_load(&pool->busy) > 0) {
+        sched_yield();
+    }
+}
+
+uint32_t thread_pool_thread_count(const struct thread_pool* pool)
+{
+    return pool ? pool->thread_count : 1;
+}
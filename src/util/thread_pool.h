@@ -0,0 +1,50 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#define THREAD_POOL_DEQUE_SIZE 64
+
+/* Called with a half-open index range; worker is in [0, thread_count) */
+typedef void (*thread_pool_fn)(void* context, uint32_t begin, uint32_t end, uint32_t worker);
+
+/* Chase-Lev work-stealing deque of packed [begin, end) ranges */
+struct thread_pool_deque
+{
+    _Alignas(64) atomic_int_fast64_t top;
+    _Alignas(64) atomic_int_fast64_t bottom;
+    atomic_uint_fast64_t tasks[THREAD_POOL_DEQUE_SIZE];
+};
+
+struct thread_pool
+{
+    uint32_t thread_count;
+    pthread_t* threads;
+    struct thread_pool_deque* deques;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t wake;
+    uint64_t generation;
+    bool shutdown;
+
+    thread_pool_fn fn;
+    void* context;
+    uint32_t grain;
+    atomic_uint remaining;
+    atomic_uint busy;
+};
+
+/* thread_count == 0 uses every online core; the calling thread counts as worker 0 */
+void thread_pool_init(struct thread_pool* pool, uint32_t thread_count);
+void thread_pool_free(struct thread_pool* pool);
+
+/* Runs fn over [0, count) split into ranges of at most grain items and
+ * returns once every range is done. A NULL pool runs fn inline. Results are
+ * independent of the thread count as long as fn writes per-index outputs. */
+void thread_pool_parallel_for(struct thread_pool* pool, uint32_t count, uint32_t grain, thread_pool_fn fn, void* context);
+uint32_t thread_pool_thread_count(const struct thread_pool* pool);
+
+#endif
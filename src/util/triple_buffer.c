@@ -0,0 +1,40 @@
+#include "triple_buffer.h"
+
+#define TRIPLE_BUFFER_FRESH 4u
+#define TRIPLE_BUFFER_INDEX 3u
+
+void triple_buffer_init(struct triple_buffer* buffer, void* first, void* second, void* third)
+{
+    buffer->slots[0] = first;
+    buffer->slots[1] = second;
+    buffer->slots[2] = third;
+    buffer->front = 0;
+    atomic_init(&buffer->middle, 1);
+    buffer->back = 2;
+}
+
+void* triple_buffer_back(struct triple_buffer* buffer)
+{
+    return buffer->slots[buffer->back];
+}
+
+void triple_buffer_publish(struct triple_buffer* buffer)
+{
+    const uint32_t old = atomic_exchange_explicit(&buffer->middle, buffer->back | TRIPLE_BUFFER_FRESH, memory_order_acq_rel);
+    buffer->back = old & TRIPLE_BUFFER_INDEX;
+}
+
+bool triple_buffer_acquire(struct triple_buffer* buffer)
+{
+    if (!(atomic_load_explicit(&buffer->middle, memory_order_relaxed) & TRIPLE_BUFFER_FRESH)) {
+        return false;
+    }
+    const uint32_t old = atomic_exchange_explicit(&buffer->middle, buffer->front, memory_order_acq_rel);
+    buffer->front = old & TRIPLE_BUFFER_INDEX;
+    return true;
+}
+
+void* triple_buffer_front(struct triple_buffer* buffer)
+{
+    return buffer->slots[buffer->front];
+}
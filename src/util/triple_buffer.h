@@ -0,0 +1,28 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+/* Single-producer single-consumer triple buffer. The producer always owns a
+ * back slot and the consumer a front slot; publishing and acquiring swap
+ * those with the shared middle slot atomically, so neither side ever waits. */
+struct triple_buffer
+{
+    void* slots[3];
+    atomic_uint middle;
+    uint32_t back;
+    uint32_t front;
+};
+
+void triple_buffer_init(struct triple_buffer* buffer, void* first, void* second, void* third);
+
+void* triple_buffer_back(struct triple_buffer* buffer);
+void triple_buffer_publish(struct triple_buffer* buffer);
+
+/* Returns true if a newer slot was published since the last acquire */
+bool triple_buffer_acquire(struct triple_buffer* buffer);
+void* triple_buffer_front(struct triple_buffer* buffer);
+
+#endif
@@ -0,0 +1,92 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "util.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+void* util_allocate(size_t size, const char* what)
+{
+    void* data = malloc(size > 0 ? size : 1);
+    if (!data) {
+        fprintf(stderr, "Failed to allocate %s!\n", what);
+        abort();
+    }
+    return data;
+}
+
+void* util_allocate_zeroed(size_t size, const char* what)
+{
+    void* data = calloc(1, size > 0 ? size : 1);
+    if (!data) {
+        fprintf(stderr, "Failed to allocate %s!\n", what);
+        abort();
+    }
+    return data;
+}
+
+void* util_reallocate(void* data, size_t size, const char* what)
+{
+    data = realloc(data, size > 0 ? size : 1);
+    if (!data) {
+        fprintf(stderr, "Failed to allocate %s!\n", what);
+        abort();
+    }
+    return data;
+}
+
+void* util_allocate_aligned(size_t alignment, size_t size, const char* what)
+{
+    size = (size + alignment - 1) / alignment * alignment;
+    void* data = aligned_alloc(alignment, size > 0 ? size : alignment);
+    if (!data) {
+        fprintf(stderr, "Failed to allocate %s!\n", what);
+        abort();
+    }
+    return data;
+}
+
+/* Makes a rename in the directory holding path durable */
+static bool sync_directory(const char* path)
+{
+    char directory[1024];
+    const char* slash = strrchr(path, '/');
+    if (!slash) {
+        snprintf(directory, sizeof(directory), ".");
+    } else if (slash == path) {
+        snprintf(directory, sizeof(directory), "/");
+    } else {
+        snprintf(directory, sizeof(directory), "%.*s", (int)(slash - path), path);
+    }
+
+    const int fd = open(directory, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    const bool synced = fsync(fd) == 0;
+    close(fd);
+    return synced;
+}
+
+bool util_write_file(const char* path, util_write_fn write, void* context)
+{
+    char temporary[1024];
+    if ((size_t)snprintf(temporary, sizeof(temporary), "%s.tmp", path) >= sizeof(temporary)) {
+        return false;
+    }
+
+    FILE* file = fopen(temporary, "wb");
+    if (!file) {
+        return false;
+    }
+    /* The data must be on disk before the rename is, or a crash can leave
+     * the new name pointing at an empty or partial file */
+    const bool written = write(file, context) && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    if (fclose(file) != 0 || !written || rename(temporary, path) != 0) {
+        remove(temporary);
+        return false;
+    }
+    return sync_directory(path);
+}
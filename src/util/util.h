@@ -0,0 +1,29 @@
+#ifndef UTIL_H
+#define UTIL_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Not in strict C11 */
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* Allocators that abort with "Failed to allocate <what>!" instead of
+ * returning NULL; a size of zero still returns a block that can be freed */
+void* util_allocate(size_t size, const char* what);
+void* util_allocate_zeroed(size_t size, const char* what);
+void* util_reallocate(void* data, size_t size, const char* what);
+/* Rounds size up to a multiple of alignment, as aligned_alloc requires */
+void* util_allocate_aligned(size_t alignment, size_t size, const char* what);
+
+/* Writes a file's contents into the open stream; false on any failed write */
+typedef bool (*util_write_fn)(FILE* file, void* context);
+
+/* Writes path.tmp, syncs it, renames it over path and syncs the directory,
+ * so a crash leaves either the old file or the complete new one; on
+ * failure the temporary is removed */
+bool util_write_file(const char* path, util_write_fn write, void* context);
+
+#endif
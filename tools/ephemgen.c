@@ -0,0 +1,301 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+
+#include "../src/physics/ephemeris.h"
+#include "../src/physics/integrator.h"
+#include "../src/physics/scene.h"
+#include "../src/physics/simulation.h"
+#include "../src/util/util.h"
+
+/*
+ * Offline ephemeris generator: integrates a scene with a small step, keeps
+ * every body's state at every step, and fits each body's track with
+ * Chebyshev series over uniform segments. Values at the Chebyshev nodes come
+ * from cubic Hermite interpolation between the stored steps.
+ */
+
+#define SEGMENTS_PER_ORBIT 16
+#define MIN_SEGMENT_DAYS 1.0
+#define MAX_SEGMENT_DAYS 64.0
+
+struct track
+{
+    uint32_t body_count;
+    uint32_t step_count;
+    double dt;
+    /* x, y, z, vx, vy, vz per body per step */
+    double* states;
+};
+
+static const double* track_state(const struct track* track, uint32_t step, uint32_t body)
+{
+    return track->states + ((size_t)step * track->body_count + body) * 6;
+}
+
+static void track_sample(const struct track* track, uint32_t body, double time, double position[3])
+{
+    uint32_t step = (uint32_t)(time / track->dt);
+    step = step < track->step_count - 1 ? step : track->step_count - 2;
+    const double h = track->dt;
+    const double u = time / h - step;
+
+    /* Cubic Hermite basis, velocities scaled to the unit interval */
+    const double u2 = u * u;
+    const double u3 = u2 * u;
+    const double h00 = 2.0 * u3 - 3.0 * u2 + 1.0;
+    const double h10 = u3 - 2.0 * u2 + u;
+    const double h01 = -2.0 * u3 + 3.0 * u2;
+    const double h11 = u3 - u2;
+
+    const double* a = track_state(track, step, body);
+    const double* b = track_state(track, step + 1, body);
+    for (uint32_t k = 0; k < 3; ++k) {
+        position[k] = h00 * a[k] + h10 * h * a[k + 3] + h01 * b[k] + h11 * h * b[k + 3];
+    }
+}
+
+/* Orbital period about body 0 from the osculating semi-major axis */
+static double orbital_period(const struct bodies* bodies, uint32_t body)
+{
+    const double dx = bodies->x[body] - bodies->x[0];
+    const double dy = bodies->y[body] - bodies->y[0];
+    const double dz = bodies->z[body] - bodies->z[0];
+    const double dvx = bodies->vx[body] - bodies->vx[0];
+    const double dvy = bodies->vy[body] - bodies->vy[0];
+    const double dvz = bodies->vz[body] - bodies->vz[0];
+    const double mu = GRAVITY_G_AU_MSUN_DAY * (bodies->mass[0] + bodies->mass[body]);
+    const double r = sqrt(dx * dx + dy * dy + dz * dz);
+    const double inverse_a = 2.0 / r - (dvx * dvx + dvy * dvy + dvz * dvz) / mu;
+    return inverse_a > 0.0 ? 2.0 * M_PI * sqrt(1.0 / (inverse_a * inverse_a * inverse_a) / mu) : INFINITY;
+}
+
+static double segment_length(double period, double dt)
+{
+    double days = period / SEGMENTS_PER_ORBIT;
+    days = days < MIN_SEGMENT_DAYS ? MIN_SEGMENT_DAYS : days > MAX_SEGMENT_DAYS ? MAX_SEGMENT_DAYS : days;
+    /* Whole steps keep segment boundaries on stored states */
+    days = floor(days / dt) * dt;
+    return days > dt ? days : dt;
+}
+
+struct ephemeris_file
+{
+    const struct ephemeris_header* header;
+    const struct ephemeris_body* bodies;
+    double* const* coefficients;
+};
+
+static bool write_ephemeris(FILE* file, void* context)
+{
+    const struct ephemeris_file* ephemeris = context;
+    const struct ephemeris_header* header = ephemeris->header;
+    const struct ephemeris_body* bodies = ephemeris->bodies;
+    double* const* coefficients = ephemeris->coefficients;
+
+    bool written = fwrite(header, sizeof(*header), 1, file) == 1 &&
+                   fwrite(bodies, sizeof(*bodies), header->body_count, file) == header->body_count;
+    const uint8_t padding[32] = {0};
+    for (uint32_t i = 0; written && i < header->body_count; ++i) {
+        const long position = ftell(file);
+        written = position >= 0 && (uint64_t)position <= bodies[i].offset &&
+                  fwrite(padding, 1, bodies[i].offset - (uint64_t)position, file) == bodies[i].offset - (uint64_t)position;
+        const size_t count = (size_t)bodies[i].segment_count * bodies[i].coefficient_count * 4;
+        written = written && fwrite(coefficients[i], sizeof(double), count, file) == count;
+    }
+    return written;
+}
+
+int main(int argc, char** argv)
+{
+    const char* scene = "solar";
+    enum integrator_type integrator = INTEGRATOR_WISDOM_HOLMAN;
+    double dt = 0.25;
+    double years = 100.0;
+    uint32_t coefficient_count = 12;
+
+    int arg = 1;
+    bool valid = true;
+    bool help = false;
+    for (; valid && arg < argc && strncmp(argv[arg], "--", 2) == 0; arg += 2) {
+        if (strcmp(argv[arg], "--help") == 0) {
+            help = true;
+            break;
+        }
+        if (arg + 1 == argc) {
+            valid = false;
+            break;
+        }
+        const char* value = argv[arg + 1];
+        if (strcmp(argv[arg], "--scene") == 0) {
+            scene = value;
+        } else if (strcmp(argv[arg], "--integrator") == 0) {
+            valid = integrator_parse(value, &integrator);
+        } else if (strcmp(argv[arg], "--dt") == 0) {
+            dt = strtod(value, NULL);
+        } else if (strcmp(argv[arg], "--years") == 0) {
+            years = strtod(value, NULL);
+        } else if (strcmp(argv[arg], "--coefficients") == 0) {
+            coefficient_count = (uint32_t)strtoul(value, NULL, 10);
+        } else {
+            valid = false;
+        }
+    }
+    /* An option name is never taken as the output path */
+    if (help || !valid || argc - arg != 1 || strncmp(argv[arg], "--", 2) == 0 || !(dt > 0.0) || !(years > 0.0) ||
+        coefficient_count < 2 || coefficient_count > EPHEMERIS_MAX_COEFFICIENTS)
+    {
+        fprintf(stderr, "Usage: %s [options] <output>\n", argv[0]);
+        fputs("  --scene NAME          solar (default) or sun\n"
+              "  --integrator NAME     leapfrog, yoshida4, wisdom-holman (default) or block-leapfrog\n"
+              "  --dt DAYS             integration step, also the interpolation step (default 0.25)\n"
+              "  --years N             span covered from t = 0 (default 100)\n"
+              "  --coefficients N      Chebyshev coefficients per segment, 2 to 32 (default 12)\n", stderr);
+        return help ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    const char* output = argv[arg];
+
+    struct simulation sim;
+    simulation_init(&sim, 16, dt);
+    if (!scene_load(&sim.bodies, scene)) {
+        fprintf(stderr, "Unknown scene '%s'\n", scene);
+        simulation_free(&sim);
+        return EXIT_FAILURE;
+    }
+    simulation_set_integrator(&sim, integrator);
+
+    /* Segments follow each orbit; the Sun's wobble is as fast as the fastest planet */
+    const uint32_t body_count = sim.bodies.count;
+    const double span = years * 365.25;
+    struct ephemeris_body* bodies = util_allocate_zeroed(body_count * sizeof(struct ephemeris_body), "the ephemeris");
+    double** coefficients = util_allocate_zeroed(body_count * sizeof(double*), "the ephemeris");
+    double fastest = INFINITY;
+    for (uint32_t i = 1; i < body_count; ++i) {
+        const double period = orbital_period(&sim.bodies, i);
+        fastest = period < fastest ? period : fastest;
+        bodies[i].segment_days = segment_length(period, dt);
+    }
+    bodies[0].segment_days = segment_length(fastest, dt);
+
+    double covered = span;
+    uint64_t offset = (sizeof(struct ephemeris_header) + body_count * sizeof(struct ephemeris_body) + 31) & ~(uint64_t)31;
+    for (uint32_t i = 0; i < body_count; ++i) {
+        struct ephemeris_body* body = &bodies[i];
+        body->mass = sim.bodies.mass[i];
+        body->radius = sim.bodies.radius[i];
+        body->segment_count = (uint32_t)ceil(span / body->segment_days - 1e-9);
+        body->coefficient_count = coefficient_count;
+        body->offset = offset;
+        offset += (uint64_t)body->segment_count * coefficient_count * 4 * sizeof(double);
+        const double end = body->segment_count * body->segment_days;
+        covered = end > covered ? end : covered;
+    }
+
+    struct track track;
+    track.body_count = body_count;
+    track.step_count = (uint32_t)ceil(covered / dt) + 2;
+    track.dt = dt;
+    track.states = util_allocate((size_t)track.step_count * body_count * 6 * sizeof(double), "the integrated track");
+
+    printf("Integrating %" PRIu32 " bodies for %.1f days with %s, dt = %g\n", body_count, covered, integrator_name(integrator), dt);
+    for (uint32_t step = 0; step < track.step_count; ++step)
+    {
+        if (step > 0) {
+            simulation_step(&sim);
+        }
+        for (uint32_t i = 0; i < body_count; ++i) {
+            double* state = track.states + ((size_t)step * body_count + i) * 6;
+            state[0] = sim.bodies.x[i];
+            state[1] = sim.bodies.y[i];
+            state[2] = sim.bodies.z[i];
+            state[3] = sim.bodies.vx[i];
+            state[4] = sim.bodies.vy[i];
+            state[5] = sim.bodies.vz[i];
+        }
+    }
+
+    for (uint32_t i = 0; i < body_count; ++i)
+    {
+        const struct ephemeris_body* body = &bodies[i];
+        const uint32_t n = body->coefficient_count;
+        coefficients[i] = util_allocate_zeroed((size_t)body->segment_count * n * 4 * sizeof(double), "the coefficients");
+
+        double worst = 0.0;
+        for (uint32_t segment = 0; segment < body->segment_count; ++segment)
+        {
+            const double begin = segment * body->segment_days;
+            const double half = 0.5 * body->segment_days;
+            double values[3][EPHEMERIS_MAX_COEFFICIENTS];
+            for (uint32_t j = 0; j < n; ++j) {
+                double position[3];
+                track_sample(&track, i, begin + half * (chebyshev_node(j, n) + 1.0), position);
+                for (uint32_t k = 0; k < 3; ++k) {
+                    values[k][j] = position[k];
+                }
+            }
+
+            double* rows = coefficients[i] + (size_t)segment * n * 4;
+            for (uint32_t k = 0; k < 3; ++k) {
+                double fitted[EPHEMERIS_MAX_COEFFICIENTS];
+                chebyshev_fit(values[k], n, fitted);
+                for (uint32_t j = 0; j < n; ++j) {
+                    rows[j * 4 + k] = fitted[j];
+                }
+            }
+
+            /* Fit error at the stored steps inside the segment */
+            const uint32_t first = (uint32_t)(begin / dt + 0.5);
+            const uint32_t steps = (uint32_t)(body->segment_days / dt + 0.5);
+            for (uint32_t step = first; step < first + steps; ++step)
+            {
+                const double s = (step * dt - begin) / half - 1.0;
+                double previous = 1.0, current = s;
+                double position[3] = {rows[0], rows[1], rows[2]};
+                for (uint32_t j = 1; j < n; ++j) {
+                    for (uint32_t k = 0; k < 3; ++k) {
+                        position[k] += rows[j * 4 + k] * current;
+                    }
+                    const double next = 2.0 * s * current - previous;
+                    previous = current;
+                    current = next;
+                }
+                const double* state = track_state(&track, step, i);
+                const double dx = position[0] - state[0];
+                const double dy = position[1] - state[1];
+                const double dz = position[2] - state[2];
+                const double error = sqrt(dx * dx + dy * dy + dz * dz);
+                worst = error > worst ? error : worst;
+            }
+        }
+        printf("Body %2" PRIu32 ": %6" PRIu32 " segments of %6.2f days, max fit error %.3e AU\n", i, body->segment_count,
+               body->segment_days, worst);
+    }
+
+    const struct ephemeris_header header = {
+        .magic = EPHEMERIS_MAGIC,
+        .version = EPHEMERIS_VERSION,
+        .body_count = body_count,
+        .reserved = 0,
+        .start = 0.0,
+        .end = span
+    };
+    struct ephemeris_file file = {&header, bodies, coefficients};
+    const bool written = util_write_file(output, write_ephemeris, &file);
+    if (!written) {
+        fprintf(stderr, "Failed to write '%s'!\n", output);
+    } else {
+        printf("Wrote %s (%.1f MiB)\n", output, offset / (1024.0 * 1024.0));
+    }
+
+    for (uint32_t i = 0; i < body_count; ++i) {
+        free(coefficients[i]);
+    }
+    free(coefficients);
+    free(bodies);
+    free(track.states);
+    simulation_free(&sim);
+    return written ? EXIT_SUCCESS : EXIT_FAILURE;
+}
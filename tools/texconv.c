@@ -0,0 +1,403 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../vendor/stb_image.h"
+
+#include "../src/graphics/ktx.h"
+#include "../src/graphics/tiles.h"
+#include "../src/util/util.h"
+
+/*
+ * Offline texture baker: decodes an image, builds the full box-filtered mip
+ * chain and writes it BC1 (DXT1) compressed into a KTX file that the viewer
+ * maps and uploads without decoding. BC1 has no usable alpha, so only the
+ * RGB channels are kept.
+ *
+ * With --tiles the image is instead resampled to a square and cut into a
+ * quadtree of BC1 tiles for the streaming tile cache.
+ */
+
+struct image
+{
+    uint32_t width;
+    uint32_t height;
+    uint8_t* rgb;
+};
+
+static uint16_t pack_565(const float* color)
+{
+    const uint32_t r = (uint32_t)(color[0] * 31.0f / 255.0f + 0.5f);
+    const uint32_t g = (uint32_t)(color[1] * 63.0f / 255.0f + 0.5f);
+    const uint32_t b = (uint32_t)(color[2] * 31.0f / 255.0f + 0.5f);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void unpack_565(uint16_t packed, float* color)
+{
+    const uint32_t r = (packed >> 11) & 31;
+    const uint32_t g = (packed >> 5) & 63;
+    const uint32_t b = packed & 31;
+    color[0] = (float)((r << 3) | (r >> 2));
+    color[1] = (float)((g << 2) | (g >> 4));
+    color[2] = (float)((b << 3) | (b >> 2));
+}
+
+static float distance2(const float* a, const float* b)
+{
+    const float dr = a[0] - b[0];
+    const float dg = a[1] - b[1];
+    const float db = a[2] - b[2];
+    return dr * dr + dg * dg + db * db;
+}
+
+static void encode_block(float pixels[16][3], uint8_t* block)
+{
+    float mean[3] = {0.0f, 0.0f, 0.0f};
+    for (uint32_t i = 0; i < 16; ++i) {
+        for (uint32_t c = 0; c < 3; ++c) {
+            mean[c] += pixels[i][c] / 16.0f;
+        }
+    }
+
+    /* Principal axis of the block's colours by power iteration on the covariance */
+    float covariance[6] = {0};
+    for (uint32_t i = 0; i < 16; ++i) {
+        const float r = pixels[i][0] - mean[0];
+        const float g = pixels[i][1] - mean[1];
+        const float b = pixels[i][2] - mean[2];
+        covariance[0] += r * r;
+        covariance[1] += r * g;
+        covariance[2] += r * b;
+        covariance[3] += g * g;
+        covariance[4] += g * b;
+        covariance[5] += b * b;
+    }
+    float axis[3] = {1.0f, 1.0f, 1.0f};
+    for (uint32_t iteration = 0; iteration < 8; ++iteration) {
+        const float x = covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2];
+        const float y = covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2];
+        const float z = covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2];
+        const float length = sqrtf(x * x + y * y + z * z);
+        if (length < 1e-6f) {
+            break;
+        }
+        axis[0] = x / length;
+        axis[1] = y / length;
+        axis[2] = z / length;
+    }
+
+    float lowest = 1e30f;
+    float highest = -1e30f;
+    uint32_t low = 0;
+    uint32_t high = 0;
+    for (uint32_t i = 0; i < 16; ++i) {
+        const float t = (pixels[i][0] - mean[0]) * axis[0] + (pixels[i][1] - mean[1]) * axis[1] + (pixels[i][2] - mean[2]) * axis[2];
+        if (t < lowest) {
+            lowest = t;
+            low = i;
+        }
+        if (t > highest) {
+            highest = t;
+            high = i;
+        }
+    }
+
+    uint16_t color0 = pack_565(pixels[high]);
+    uint16_t color1 = pack_565(pixels[low]);
+    /* color0 > color1 selects the four-colour mode */
+    if (color0 < color1) {
+        const uint16_t swap = color0;
+        color0 = color1;
+        color1 = swap;
+    }
+
+    uint32_t indices = 0;
+    if (color0 != color1) {
+        float palette[4][3];
+        unpack_565(color0, palette[0]);
+        unpack_565(color1, palette[1]);
+        for (uint32_t c = 0; c < 3; ++c) {
+            palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+            palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+        }
+        for (uint32_t i = 0; i < 16; ++i) {
+            uint32_t best = 0;
+            float best_distance = distance2(pixels[i], palette[0]);
+            for (uint32_t p = 1; p < 4; ++p) {
+                const float d = distance2(pixels[i], palette[p]);
+                if (d < best_distance) {
+                    best_distance = d;
+                    best = p;
+                }
+            }
+            indices |= best << (2 * i);
+        }
+    }
+
+    block[0] = (uint8_t)(color0 & 0xFF);
+    block[1] = (uint8_t)(color0 >> 8);
+    block[2] = (uint8_t)(color1 & 0xFF);
+    block[3] = (uint8_t)(color1 >> 8);
+    for (uint32_t i = 0; i < 4; ++i) {
+        block[4 + i] = (uint8_t)(indices >> (8 * i));
+    }
+}
+
+static void compress_level(const struct image* image, uint8_t* blocks)
+{
+    const uint32_t blocks_x = (image->width + 3) / 4;
+    const uint32_t blocks_y = (image->height + 3) / 4;
+    for (uint32_t by = 0; by < blocks_y; ++by)
+    {
+        for (uint32_t bx = 0; bx < blocks_x; ++bx)
+        {
+            /* Levels smaller than a block repeat their edge pixels */
+            float pixels[16][3];
+            for (uint32_t i = 0; i < 16; ++i) {
+                uint32_t x = bx * 4 + i % 4;
+                uint32_t y = by * 4 + i / 4;
+                x = x < image->width ? x : image->width - 1;
+                y = y < image->height ? y : image->height - 1;
+                const uint8_t* texel = &image->rgb[((size_t)y * image->width + x) * 3];
+                pixels[i][0] = texel[0];
+                pixels[i][1] = texel[1];
+                pixels[i][2] = texel[2];
+            }
+            encode_block(pixels, &blocks[((size_t)by * blocks_x + bx) * 8]);
+        }
+    }
+}
+
+static struct image downsample(const struct image* image)
+{
+    struct image result;
+    result.width = image->width > 1 ? image->width / 2 : 1;
+    result.height = image->height > 1 ? image->height / 2 : 1;
+    result.rgb = util_allocate((size_t)result.width * result.height * 3, "a mip level");
+
+    for (uint32_t y = 0; y < result.height; ++y)
+    {
+        const uint32_t y0 = y * 2 < image->height ? y * 2 : image->height - 1;
+        const uint32_t y1 = y0 + 1 < image->height ? y0 + 1 : y0;
+        for (uint32_t x = 0; x < result.width; ++x)
+        {
+            const uint32_t x0 = x * 2 < image->width ? x * 2 : image->width - 1;
+            const uint32_t x1 = x0 + 1 < image->width ? x0 + 1 : x0;
+            for (uint32_t c = 0; c < 3; ++c) {
+                const uint32_t sum = image->rgb[((size_t)y0 * image->width + x0) * 3 + c] +
+                                     image->rgb[((size_t)y0 * image->width + x1) * 3 + c] +
+                                     image->rgb[((size_t)y1 * image->width + x0) * 3 + c] +
+                                     image->rgb[((size_t)y1 * image->width + x1) * 3 + c];
+                result.rgb[((size_t)y * result.width + x) * 3 + c] = (uint8_t)((sum + 2) / 4);
+            }
+        }
+    }
+    return result;
+}
+
+static int write_ktx(const struct image* source, const char* output)
+{
+    uint32_t levels = 1;
+    for (uint32_t size = source->width > source->height ? source->width : source->height; size > 1; size /= 2) {
+        ++levels;
+    }
+
+    FILE* file = fopen(output, "wb");
+    if (!file) {
+        fprintf(stderr, "Failed to create '%s'!\n", output);
+        return EXIT_FAILURE;
+    }
+
+    struct ktx_header header = {
+        .identifier = KTX_IDENTIFIER,
+        .endianness = KTX_ENDIANNESS,
+        .gl_type_size = 1,
+        .gl_internal_format = KTX_FORMAT_BC1,
+        .gl_base_internal_format = KTX_FORMAT_RGB,
+        .pixel_width = source->width,
+        .pixel_height = source->height,
+        .faces = 1,
+        .mip_levels = levels
+    };
+    fwrite(&header, sizeof(header), 1, file);
+
+    struct image level = *source;
+    size_t total = 0;
+    for (uint32_t i = 0; i < levels; ++i)
+    {
+        const uint32_t size = (uint32_t)ktx_bc1_size(level.width, level.height);
+        uint8_t* blocks = util_allocate(size, "compressed blocks");
+        compress_level(&level, blocks);
+        /* BC1 levels are whole 8-byte blocks, so no mip padding is needed */
+        fwrite(&size, sizeof(size), 1, file);
+        fwrite(blocks, 1, size, file);
+        free(blocks);
+        total += size;
+
+        if (i + 1 < levels) {
+            struct image next = downsample(&level);
+            if (level.rgb != source->rgb) {
+                free(level.rgb);
+            }
+            level = next;
+        }
+    }
+    if (level.rgb != source->rgb) {
+        free(level.rgb);
+    }
+
+    if (fclose(file) != 0) {
+        fprintf(stderr, "Failed to write '%s'!\n", output);
+        return EXIT_FAILURE;
+    }
+
+    printf("%s: %" PRIu32 "x%" PRIu32 ", %" PRIu32 " levels, %zu bytes of BC1 (%.1f%% of RGBA8)\n", output,
+           source->width, source->height, levels, total,
+           100.0 * (double)total / ((double)source->width * source->height * 4.0 * 4.0 / 3.0));
+    return EXIT_SUCCESS;
+}
+
+static struct image resample(const struct image* image, uint32_t size)
+{
+    struct image result = {size, size, util_allocate((size_t)size * size * 3, "the tile level")};
+
+    /* Bilinear, sampling texel centres */
+    for (uint32_t y = 0; y < size; ++y)
+    {
+        float fy = ((float)y + 0.5f) * (float)image->height / (float)size - 0.5f;
+        fy = fy > 0.0f ? fy : 0.0f;
+        const uint32_t y0 = (uint32_t)fy < image->height - 1 ? (uint32_t)fy : image->height - 1;
+        const uint32_t y1 = y0 + 1 < image->height ? y0 + 1 : y0;
+        const float ty = fy - (float)y0 < 1.0f ? fy - (float)y0 : 1.0f;
+        for (uint32_t x = 0; x < size; ++x)
+        {
+            float fx = ((float)x + 0.5f) * (float)image->width / (float)size - 0.5f;
+            fx = fx > 0.0f ? fx : 0.0f;
+            const uint32_t x0 = (uint32_t)fx < image->width - 1 ? (uint32_t)fx : image->width - 1;
+            const uint32_t x1 = x0 + 1 < image->width ? x0 + 1 : x0;
+            const float tx = fx - (float)x0 < 1.0f ? fx - (float)x0 : 1.0f;
+            for (uint32_t c = 0; c < 3; ++c) {
+                const float top = image->rgb[((size_t)y0 * image->width + x0) * 3 + c] * (1.0f - tx) +
+                                  image->rgb[((size_t)y0 * image->width + x1) * 3 + c] * tx;
+                const float bottom = image->rgb[((size_t)y1 * image->width + x0) * 3 + c] * (1.0f - tx) +
+                                     image->rgb[((size_t)y1 * image->width + x1) * 3 + c] * tx;
+                result.rgb[((size_t)y * size + x) * 3 + c] = (uint8_t)(top * (1.0f - ty) + bottom * ty + 0.5f);
+            }
+        }
+    }
+    return result;
+}
+
+static int write_tiles(const struct image* source, uint32_t tile_size, const char* output)
+{
+    /* The finest level has roughly the source's resolution along its longer side */
+    uint32_t levels = 1;
+    const uint32_t longest = source->width > source->height ? source->width : source->height;
+    while ((tile_size << levels) <= longest && levels < 12) {
+        ++levels;
+    }
+
+    FILE* file = fopen(output, "wb");
+    if (!file) {
+        fprintf(stderr, "Failed to create '%s'!\n", output);
+        return EXIT_FAILURE;
+    }
+
+    const struct tiles_header header = {
+        .magic = TILES_MAGIC,
+        .version = TILES_VERSION,
+        .format = KTX_FORMAT_BC1,
+        .tile_size = tile_size,
+        .tile_bytes = (uint32_t)ktx_bc1_size(tile_size, tile_size),
+        .levels = levels,
+        .source_width = source->width,
+        .source_height = source->height
+    };
+    fwrite(&header, sizeof(header), 1, file);
+
+    struct image tile = {tile_size, tile_size, util_allocate((size_t)tile_size * tile_size * 3, "a tile")};
+    uint8_t* blocks = util_allocate(header.tile_bytes, "a tile");
+
+    /* Finest level first, each coarser one box-filtered from the last; tiles are placed by offset */
+    struct image level = resample(source, tile_size << (levels - 1));
+    uint64_t tiles = 0;
+    for (uint32_t l = levels; l-- > 0;)
+    {
+        const uint32_t count = 1u << l;
+        const uint64_t first = ((1ull << (2 * l)) - 1) / 3;
+        for (uint32_t ty = 0; ty < count; ++ty)
+        {
+            for (uint32_t tx = 0; tx < count; ++tx)
+            {
+                for (uint32_t row = 0; row < tile_size; ++row) {
+                    memcpy(&tile.rgb[(size_t)row * tile_size * 3],
+                           &level.rgb[(((size_t)ty * tile_size + row) * level.width + (size_t)tx * tile_size) * 3],
+                           (size_t)tile_size * 3);
+                }
+                compress_level(&tile, blocks);
+
+                const uint64_t index = first + (uint64_t)ty * count + tx;
+                fseek(file, (long)(sizeof(header) + index * header.tile_bytes), SEEK_SET);
+                fwrite(blocks, 1, header.tile_bytes, file);
+                ++tiles;
+            }
+        }
+
+        if (l > 0) {
+            struct image next = downsample(&level);
+            free(level.rgb);
+            level = next;
+        }
+    }
+    free(level.rgb);
+    free(tile.rgb);
+    free(blocks);
+
+    if (fclose(file) != 0) {
+        fprintf(stderr, "Failed to write '%s'!\n", output);
+        return EXIT_FAILURE;
+    }
+
+    printf("%s: %" PRIu32 " levels of %" PRIu32 "px tiles, %" PRIu64 " tiles, %" PRIu64 " bytes\n", output, levels,
+           tile_size, tiles, tiles * header.tile_bytes);
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv)
+{
+    bool tiled = false;
+    uint32_t tile_size = 256;
+    int arg = 1;
+    for (; arg < argc && strncmp(argv[arg], "--", 2) == 0; ++arg) {
+        if (strcmp(argv[arg], "--tiles") == 0) {
+            tiled = true;
+        } else if (strcmp(argv[arg], "--tile-size") == 0 && arg + 1 < argc) {
+            tile_size = (uint32_t)strtoul(argv[++arg], NULL, 10);
+        } else {
+            break;
+        }
+    }
+    if (argc - arg != 2 || tile_size < 4 || (tile_size & (tile_size - 1)) != 0) {
+        fprintf(stderr, "Usage: %s [--tiles [--tile-size N]] <input image> <output>\n", argv[0]);
+        fputs("  Writes a BC1 .ktx with a full mip chain, or with --tiles a quadtree of\n"
+              "  N x N BC1 tiles (N a power of two, default 256).\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    int width, height, channels;
+    uint8_t* rgb = stbi_load(argv[arg], &width, &height, &channels, 3);
+    if (!rgb) {
+        fprintf(stderr, "Failed to load '%s'!\n", argv[arg]);
+        return EXIT_FAILURE;
+    }
+
+    const struct image source = {(uint32_t)width, (uint32_t)height, rgb};
+    const int result = tiled ? write_tiles(&source, tile_size, argv[arg + 1]) : write_ktx(&source, argv[arg + 1]);
+    stbi_image_free(rgb);
+    return result;
+}
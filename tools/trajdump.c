@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+
+#include "../src/physics/trajectory.h"
+
+/*
+ * Trajectory reader: prints a summary of a file written by headless
+ * --trajectory, or streams one body's track between two times as CSV.
+ * Only that body's bytes in the chunks overlapping the range are decoded.
+ */
+
+int main(int argc, char** argv)
+{
+    int64_t body = -1;
+    double from = -INFINITY;
+    double to = INFINITY;
+
+    int arg = 1;
+    bool valid = true;
+    bool help = false;
+    for (; valid && arg < argc && strncmp(argv[arg], "--", 2) == 0; arg += 2) {
+        if (strcmp(argv[arg], "--help") == 0) {
+            help = true;
+            break;
+        }
+        if (arg + 1 == argc) {
+            valid = false;
+            break;
+        }
+        const char* value = argv[arg + 1];
+        if (strcmp(argv[arg], "--body") == 0) {
+            body = strtoll(value, NULL, 10);
+        } else if (strcmp(argv[arg], "--from") == 0) {
+            from = strtod(value, NULL);
+        } else if (strcmp(argv[arg], "--to") == 0) {
+            to = strtod(value, NULL);
+        } else {
+            valid = false;
+        }
+    }
+    /* An option name is never taken as the input path */
+    if (help || !valid || argc - arg != 1 || strncmp(argv[arg], "--", 2) == 0 || !(from <= to)) {
+        fprintf(stderr, "Usage: %s [options] <trajectory>\n", argv[0]);
+        fputs("  --body N              print body N's track as time,x,y,z instead of a summary\n"
+              "  --from DAYS           first time to print\n"
+              "  --to DAYS             last time to print\n", stderr);
+        return help ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    struct trajectory_reader reader;
+    if (!trajectory_reader_open(&reader, argv[arg])) {
+        return EXIT_FAILURE;
+    }
+
+    if (body < 0) {
+        uint64_t frames = 0;
+        for (uint32_t i = 0; i < reader.chunk_count; ++i) {
+            frames += reader.chunks[i].frame_count;
+        }
+        printf("Bodies: %" PRIu32 ", frames: %" PRIu64 " in %" PRIu32 " chunks, tolerance: %g AU\n", reader.header.body_count, frames,
+               reader.chunk_count, reader.header.quantum / 2.0);
+        if (reader.chunk_count > 0) {
+            printf("Time: %.3f to %.3f days\n", reader.chunks[0].first_time, reader.chunks[reader.chunk_count - 1].last_time);
+        }
+        if (reader.recovered) {
+            puts("The index is missing; chunks were recovered up to the first incomplete one");
+        }
+        trajectory_reader_close(&reader);
+        return EXIT_SUCCESS;
+    }
+    if (body >= reader.header.body_count) {
+        fprintf(stderr, "The trajectory has %" PRIu32 " bodies\n", reader.header.body_count);
+        trajectory_reader_close(&reader);
+        return EXIT_FAILURE;
+    }
+
+    struct trajectory_track track;
+    trajectory_track_begin(&track, &reader, (uint32_t)body, from);
+    double time;
+    double position[3];
+    puts("time,x,y,z");
+    while (trajectory_track_next(&track, &time, position) && time <= to) {
+        printf("%.9g,%.12g,%.12g,%.12g\n", time, position[0], position[1], position[2]);
+    }
+
+    trajectory_reader_close(&reader);
+    return EXIT_SUCCESS;
+}
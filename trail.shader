@@ -0,0 +1,55 @@
+#shader vertex
+#version 450 core
+
+layout (std430, binding = 1) readonly buffer TrailPoints
+{
+   vec4 u_TrailPoints[];
+};
+
+/* x: slot of the newest point, y: number of points */
+layout (std430, binding = 2) readonly buffer TrailHeads
+{
+   uvec2 u_TrailHeads[];
+};
+
+#include "camera.glsl"
+
+uniform int u_TrailLength;
+
+out float fAge;
+
+void main()
+{
+   const uvec2 head = u_TrailHeads[gl_InstanceID];
+   const int count = int(head.y);
+   if (count < 2) {
+      /* Outside the clip volume, so the whole strip is discarded */
+      gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+      fAge = 1.0;
+      return;
+   }
+
+   /* Vertices before the first point collapse onto it, leaving zero-length segments */
+   const int index = max(gl_VertexID - (u_TrailLength - count), 0);
+   const int slot = (int(head.x) - (count - 1) + index + u_TrailLength) % u_TrailLength;
+   const vec3 position = u_TrailPoints[gl_InstanceID * u_TrailLength + slot].xyz;
+
+   /* Points are already relative to the render origin, like the bodies */
+   gl_Position = u_ViewProjection * vec4(position, 1.0);
+   fAge = 1.0 - float(index) / float(count - 1);
+}
+
+#shader fragment
+#version 450 core
+out vec4 FragColor;
+
+in float fAge;
+
+uniform vec4 u_Color;
+
+void main()
+{
+   /* Squared so the tail fades out quickly and the head stays bright */
+   const float fade = (1.0 - fAge) * (1.0 - fAge);
+   FragColor = vec4(u_Color.rgb, u_Color.a * fade);
+}